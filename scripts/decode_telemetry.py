@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""
+Decodifica muestras CBOR publicadas en el tópico <...>/cbor (ver src/libtelemetry.cpp)
+y las imprime como JSON con los mismos nombres de campo que el tópico <...>/out.
+
+Uso:
+  python scripts/decode_telemetry.py 90010319019f0c00...   # uno o más payloads en hex
+  mosquitto_sub -t '+/+/+/+/+/cbor' -F '%x' | python scripts/decode_telemetry.py
+
+Vector de referencia (versión 1, ambos sensores válidos, co2=415, tvoc=12,
+campos PMS7003 = 0, 40, 80, ..., 440 en el orden de PMS7003Data):
+  90010319019f0c0018281850187818a018c818f01901181901401901681901901901b8
+"""
+import json
+import sys
+
+LAYOUT_VERSION = 1
+FLAG_CCS811 = 0x01
+FLAG_PMS7003 = 0x02
+
+# Orden de PMS7003Data en src/libsensordata.h y nombres usados en el JSON
+PMS_FIELDS = ["pm1_0_cf1", "pm2_5_cf1", "pm10_cf1", "pm1_0", "pm2_5", "pm10",
+              "n0_3", "n0_5", "n1_0", "n2_5", "n5_0", "n10"]
+
+
+def read_head(buf, pos):
+    """Lee la cabecera CBOR en pos y retorna (tipo mayor, valor, nueva posición)."""
+    if pos >= len(buf):
+        raise ValueError("payload truncado")
+    major, info = buf[pos] >> 5, buf[pos] & 0x1F
+    pos += 1
+    if info < 24:
+        return major, info, pos
+    size = {24: 1, 25: 2, 26: 4, 27: 8}.get(info)
+    if size is None or pos + size > len(buf):
+        raise ValueError("cabecera CBOR inválida")
+    return major, int.from_bytes(buf[pos:pos + size], "big"), pos + size
+
+
+def decode_sample(buf):
+    major, count, pos = read_head(buf, 0)
+    if major != 4 or count != 4 + len(PMS_FIELDS):
+        raise ValueError("se esperaba un arreglo de %d elementos" % (4 + len(PMS_FIELDS)))
+    values = []
+    for _ in range(count):
+        major, value, pos = read_head(buf, pos)
+        if major != 0:
+            raise ValueError("se esperaba un entero sin signo")
+        values.append(value)
+    if pos != len(buf):
+        raise ValueError("bytes sobrantes al final del payload")
+    version, flags, co2, tvoc = values[:4]
+    if version != LAYOUT_VERSION:
+        raise ValueError("versión de layout %d no soportada" % version)
+    sample = {"co2": co2, "tvoc": tvoc}
+    sample.update(zip(PMS_FIELDS, values[4:]))
+    sample["ccs811_valido"] = bool(flags & FLAG_CCS811)
+    sample["pms7003_valido"] = bool(flags & FLAG_PMS7003)
+    return sample
+
+
+def main():
+    payloads = sys.argv[1:] or (line.strip() for line in sys.stdin)
+    for text in payloads:
+        if not text:
+            continue
+        try:
+            print(json.dumps(decode_sample(bytes.fromhex(text))))
+        except ValueError as exc:
+            print("✗ %s: %s" % (text, exc), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
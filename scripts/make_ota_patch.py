@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""
+Genera imágenes OTA comprimidas y parches binarios para src/libotapatch.*.
+
+Formato: cabecera de 20 bytes "OTAP" | versión | banderas | reservado (2)
+| tamaño nuevo | tamaño base | CRC-32 de la base (little endian), seguida del
+cuerpo. Con --base el cuerpo es una serie de registros al estilo bsdiff
+(diffLen, extraLen, seek, bytes diff, bytes extra); los bytes diff son la
+resta byte a byte nueva - base, casi todos 0 cuando el código solo se
+desplazó, por eso comprimen muy bien con zlib.
+
+Uso:
+  python scripts/make_ota_patch.py firmware.bin -o firmware.bin.z            # imagen comprimida
+  python scripts/make_ota_patch.py firmware.bin --base anterior.bin -o p.bin  # parche comprimido
+  python scripts/make_ota_patch.py --apply p.bin --base anterior.bin -o out.bin  # verificación en el host
+"""
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b"OTAP"
+VERSION = 1
+FLAG_ZLIB = 0x01
+FLAG_DELTA = 0x02
+HEADER = struct.Struct("<4sBBHIII")
+
+KEY = 16            # Bytes de una coincidencia exacta para fijar una alineación
+STEP = 4            # Paso del índice de la base (las instrucciones están alineadas a 4)
+WINDOW = 32         # Ventana para medir la calidad de una alineación
+MAX_MISMATCH = 8    # Diferencias toleradas en la ventana antes de cortar la región
+
+
+def build_index(base):
+    index = {}
+    for pos in range(0, len(base) - KEY + 1, STEP):
+        index.setdefault(base[pos:pos + KEY], pos)
+    return index
+
+
+def extend(new, n, base, p):
+    """Largo de la región que empieza en new[n] alineada con base[p], tolerando
+    diferencias aisladas (punteros reubicados). Termina en el último byte igual."""
+    length = 0
+    last_equal = 0
+    recent = []
+    mismatches = 0
+    while n + length < len(new) and p + length < len(base):
+        equal = new[n + length] == base[p + length]
+        recent.append(equal)
+        if not equal:
+            mismatches += 1
+        if len(recent) > WINDOW and not recent.pop(0):
+            mismatches -= 1
+        if mismatches > MAX_MISMATCH:
+            break
+        length += 1
+        if equal:
+            last_equal = length
+    return last_equal
+
+
+def make_delta(base, new):
+    """Retorna la lista de registros (diff, extra, seek)."""
+    index = build_index(base)
+    records = []
+    diff_start_new, diff_start_old, diff_len = 0, 0, 0
+    n = 0
+    while n < len(new):
+        # Primero se intenta seguir con la alineación anterior
+        guess = diff_start_old + (n - diff_start_new)
+        if diff_len and 0 <= guess and base[guess:guess + KEY] == new[n:n + KEY] and len(new) - n >= KEY:
+            p = guess
+        else:
+            p = index.get(new[n:n + KEY])
+        if p is None:
+            n += 1
+            continue
+        length = extend(new, n, base, p)
+        if length < KEY:
+            n += 1
+            continue
+        records.append((diff_start_new, diff_start_old, diff_len, n, p))
+        diff_start_new, diff_start_old, diff_len = n, p, length
+        n += length
+    records.append((diff_start_new, diff_start_old, diff_len, len(new), None))
+
+    out = []
+    for start_new, start_old, length, extra_end, next_old in records:
+        diff = bytes((new[start_new + i] - base[start_old + i]) & 0xFF for i in range(length))
+        extra = new[start_new + length:extra_end]
+        seek = 0 if next_old is None else next_old - (start_old + length)
+        out.append((diff, extra, seek))
+    return out
+
+
+def encode_delta(records):
+    body = bytearray()
+    for diff, extra, seek in records:
+        body += struct.pack("<IIi", len(diff), len(extra), seek)
+        body += diff
+        body += extra
+    return bytes(body)
+
+
+def apply_delta(base, body, new_size):
+    """Aplicación de referencia, igual a otaDeltaFeed()."""
+    out = bytearray()
+    pos = 0
+    old = 0
+    while pos < len(body):
+        diff_len, extra_len, seek = struct.unpack_from("<IIi", body, pos)
+        pos += 12
+        for i in range(diff_len):
+            b = base[old + i] if 0 <= old + i < len(base) else 0
+            out.append((b + body[pos + i]) & 0xFF)
+        pos += diff_len
+        old += diff_len
+        out += body[pos:pos + extra_len]
+        pos += extra_len
+        old += seek
+    if len(out) != new_size:
+        raise ValueError("el parche produjo %d bytes, se esperaban %d" % (len(out), new_size))
+    return bytes(out)
+
+
+def make_patch(new, base=None, compress=True):
+    flags = FLAG_ZLIB if compress else 0
+    if base is not None:
+        flags |= FLAG_DELTA
+        body = encode_delta(make_delta(base, new))
+        header = HEADER.pack(MAGIC, VERSION, flags, 0, len(new), len(base), zlib.crc32(base))
+    else:
+        body = new
+        header = HEADER.pack(MAGIC, VERSION, flags, 0, len(new), 0, 0)
+    if compress:
+        body = zlib.compress(body, 9)
+    return header + body
+
+
+def apply_patch(patch, base=None):
+    magic, version, flags, _, new_size, old_size, old_crc = HEADER.unpack_from(patch)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("no es un parche OTAP v%d" % VERSION)
+    body = patch[HEADER.size:]
+    if flags & FLAG_ZLIB:
+        body = zlib.decompress(body)
+    if not flags & FLAG_DELTA:
+        return body
+    if base is None:
+        raise ValueError("el parche necesita --base")
+    if zlib.crc32(base[:old_size]) != old_crc:
+        raise ValueError("la imagen base no coincide (CRC-32)")
+    return apply_delta(base[:old_size], body, new_size)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("image", nargs="?", help="firmware nuevo (.bin)")
+    parser.add_argument("--base", help="firmware que corre en el dispositivo (genera un parche)")
+    parser.add_argument("--raw", action="store_true", help="no comprimir el cuerpo")
+    parser.add_argument("--apply", metavar="PATCH", help="aplica PATCH sobre --base y escribe el resultado")
+    parser.add_argument("-o", "--output", required=True)
+    args = parser.parse_args()
+
+    base = open(args.base, "rb").read() if args.base else None
+    if args.apply:
+        result = apply_patch(open(args.apply, "rb").read(), base)
+        open(args.output, "wb").write(result)
+        print("✓ %d bytes escritos en %s" % (len(result), args.output))
+        return
+    if not args.image:
+        parser.error("falta la imagen nueva")
+
+    new = open(args.image, "rb").read()
+    patch = make_patch(new, base, compress=not args.raw)
+    if apply_patch(patch, base) != new:
+        sys.exit("✗ el parche no reproduce la imagen")
+    open(args.output, "wb").write(patch)
+    print("✓ %s: %d bytes (imagen %d bytes, %.1fx)" % (args.output, len(patch), len(new), len(new) / len(patch)))
+
+
+if __name__ == "__main__":
+    main()
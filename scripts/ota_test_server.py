@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+Servidor HTTP de pruebas para las descargas OTA reanudables (ver src/libota.cpp).
+
+Sirve los archivos de un directorio con soporte de Range, If-Range y ETag, igual
+que S3, e inyecta fallas para ejercitar la reanudación:
+  --drop BYTES    cierra la conexión después de enviar BYTES en cada respuesta
+  --stall BYTES   deja de enviar después de BYTES y mantiene la conexión abierta
+  --rate KBPS     limita la velocidad de envío
+  --ignore-range  responde siempre 200 con el archivo completo
+
+Uso:
+  python scripts/ota_test_server.py .pio/build/esp32dev --drop 200000
+  mosquitto_pub -t dispositivo/device1/ota \\
+    -m '{"version":"v9.9.9","url":"http://<ip del host>:8000/firmware.bin"}'
+
+Cada respuesta se registra con su rango, de modo que una OTA cortada muestra
+una petición inicial 200 y luego peticiones 206 desde el byte donde quedó.
+"""
+import argparse
+import hashlib
+import os
+import re
+import time
+from http.server import SimpleHTTPRequestHandler, ThreadingHTTPServer
+
+CHUNK = 1024
+
+
+class FlakyHandler(SimpleHTTPRequestHandler):
+    options = None
+
+    def send_head(self):
+        path = self.translate_path(self.path)
+        if not os.path.isfile(path):
+            self.send_error(404)
+            return None
+        data = open(path, "rb").read()
+        etag = '"%s"' % hashlib.md5(data).hexdigest()
+        start = 0
+        status = 200
+        match = re.match(r"bytes=(\d+)-$", self.headers.get("Range", ""))
+        if_range = self.headers.get("If-Range")
+        if match and not self.options.ignore_range and (if_range is None or if_range == etag):
+            start = int(match.group(1))
+            if start >= len(data):
+                self.send_error(416)
+                return None
+            status = 206
+        self.send_response(status)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(data) - start))
+        self.send_header("ETag", etag)
+        self.send_header("Accept-Ranges", "bytes")
+        if status == 206:
+            self.send_header("Content-Range", "bytes %d-%d/%d" % (start, len(data) - 1, len(data)))
+        self.end_headers()
+        self.log_message("%d desde el byte %d de %d", status, start, len(data))
+        return data[start:]
+
+    def do_HEAD(self):
+        self.send_head()
+
+    def do_GET(self):
+        body = self.send_head()
+        if body is None:
+            return
+        opts = self.options
+        sent = 0
+        while sent < len(body):
+            if opts.drop and sent >= opts.drop:
+                self.log_message("corte de conexión tras %d bytes", sent)
+                self.close_connection = True
+                return
+            if opts.stall and sent >= opts.stall:
+                self.log_message("detenido tras %d bytes", sent)
+                time.sleep(opts.stall_seconds)
+                return
+            chunk = body[sent:sent + CHUNK]
+            try:
+                self.wfile.write(chunk)
+            except (BrokenPipeError, ConnectionResetError):
+                return
+            sent += len(chunk)
+            if opts.rate:
+                time.sleep(len(chunk) / (opts.rate * 1024.0))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("directory", help="directorio con las imágenes")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--drop", type=int, default=0, help="bytes por respuesta antes de cerrar la conexión")
+    parser.add_argument("--stall", type=int, default=0, help="bytes por respuesta antes de dejar de enviar")
+    parser.add_argument("--stall-seconds", type=float, default=60.0, help="duración de la detención")
+    parser.add_argument("--rate", type=float, default=0.0, help="límite de velocidad en KB/s")
+    parser.add_argument("--ignore-range", action="store_true", help="responder siempre el archivo completo")
+    args = parser.parse_args()
+
+    FlakyHandler.options = args
+    handler = lambda *a, **kw: FlakyHandler(*a, directory=args.directory, **kw)
+    server = ThreadingHTTPServer(("", args.port), handler)
+    print("Sirviendo %s en el puerto %d" % (os.path.abspath(args.directory), args.port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+Firma imágenes OTA para la verificación en el dispositivo (ver src/libota.cpp).
+
+La firma es ECDSA P-256 sobre SHA-256(sha256 de la imagen || versión): el
+dispositivo calcula el SHA-256 de la imagen mientras la escribe y, al terminar,
+verifica la firma con ota_public_key (secrets.cpp). Incluir la versión impide
+anunciar una imagen firmada con el nombre de otra versión. La imagen firmada es
+la que queda en flash (el .bin plano), así que la misma firma vale para la
+imagen comprimida y para los parches.
+
+Uso (requiere el comando openssl):
+  python scripts/sign_ota.py genkey ota_signing_key.pem     # crea la clave e imprime la pública para secrets.cpp
+  python scripts/sign_ota.py sign firmware.bin --version v1.2.0 --key ota_signing_key.pem
+  python scripts/sign_ota.py verify firmware.bin --version v1.2.0 --pubkey ota_public.pem --sig <base64>
+
+sign imprime {"sha256": "<hex>", "sig": "<base64 DER>"}, los campos que se
+agregan al mensaje OTA.
+"""
+import argparse
+import base64
+import hashlib
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+
+def openssl(*args, data=None):
+    return subprocess.run(["openssl"] + list(args), input=data, capture_output=True, check=True).stdout
+
+
+def signed_message(image, version):
+    return hashlib.sha256(image).digest() + version.encode()
+
+
+def genkey(path):
+    openssl("ecparam", "-name", "prime256v1", "-genkey", "-noout", "-out", path)
+    os.chmod(path, 0o600)
+    public = openssl("ec", "-in", path, "-pubout").decode().strip()
+    print("Clave privada en %s (guárdala como secreto OTA_SIGNING_KEY, no la subas al repositorio)" % path)
+    print("Clave pública para secrets.cpp:\n")
+    lines = public.splitlines()
+    print('#define OTA_PUBLIC_KEY ' + ' \\\n'.join('"%s\\n"' % line for line in lines))
+
+
+def sign(image, version, key):
+    signature = openssl("dgst", "-sha256", "-sign", key, data=signed_message(image, version))
+    return {"sha256": hashlib.sha256(image).hexdigest(), "sig": base64.b64encode(signature).decode()}
+
+
+def verify(image, version, pubkey, sig):
+    with tempfile.NamedTemporaryFile() as f:
+        f.write(base64.b64decode(sig))
+        f.flush()
+        try:
+            openssl("dgst", "-sha256", "-verify", pubkey, "-signature", f.name, data=signed_message(image, version))
+            return True
+        except subprocess.CalledProcessError:
+            return False
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("genkey")
+    p.add_argument("key")
+    p = sub.add_parser("sign")
+    p.add_argument("image")
+    p.add_argument("--version", required=True)
+    p.add_argument("--key", required=True)
+    p = sub.add_parser("verify")
+    p.add_argument("image")
+    p.add_argument("--version", required=True)
+    p.add_argument("--pubkey", required=True)
+    p.add_argument("--sig", required=True)
+    args = parser.parse_args()
+
+    if args.command == "genkey":
+        genkey(args.key)
+        return
+    image = open(args.image, "rb").read()
+    if args.command == "sign":
+        print(json.dumps(sign(image, args.version, args.key)))
+    elif verify(image, args.version, args.pubkey, args.sig):
+        print("✓ firma válida")
+    else:
+        sys.exit("✗ firma inválida")
+
+
+if __name__ == "__main__":
+    main()
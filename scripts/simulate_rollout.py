@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""
+Simula un despliegue OTA escalonado sobre una flota y reporta la carga pico del servidor.
+
+Reproduce src/librollout.cpp: cohorte = FNV-1a("<id>:<semilla>") % 100, retardo
+uniforme en la ventana derivado del mismo hash y límite de velocidad por
+dispositivo. Cada dispositivo descarga a min(límite, su enlace); los enlaces
+siguen una distribución log-normal alrededor de --link-kbps.
+
+Modelo (por defecto): simulación por segundos de toda la flota, comparada con
+la misma flota sin controles de despliegue (todos empiezan a la vez y sin límite).
+
+En vivo (--http URL): una muestra de --sample dispositivos descarga de verdad
+desde un servidor local (scripts/ota_test_server.py) con el tiempo comprimido
+--speedup veces; la carga medida se reescala a la flota completa.
+
+Uso:
+  python scripts/simulate_rollout.py --check
+  python scripts/simulate_rollout.py --devices 10000 --percent 25 --window 900 --rate-kbps 256
+  python scripts/ota_test_server.py .pio/build/esp32dev &
+  python scripts/simulate_rollout.py --percent 25 --window 900 --rate-kbps 256 \\
+      --http http://127.0.0.1:8000/firmware.bin --sample 200 --speedup 60
+"""
+import argparse
+import asyncio
+import math
+import random
+import time
+import urllib.parse
+
+BURST_BYTES = 16384   # ROLLOUT_BURST_BYTES
+MAX_WINDOW_S = 604800 # ROLLOUT_MAX_WINDOW_S
+
+# (id, semilla, window_s, hash, cohorte, retardo en ms); test/test_rollout
+# verifica los mismos valores contra src/librollout.cpp
+VECTORS = [
+    ("ESP32-AABBCCDDEEFF", "v1.2.0", 900, 0xCCDB8A5C, 68, 787831),
+    ("ESP32-000000000000", "v1.2.0", 900, 0xA44C520A, 62, 522407),
+    ("ESP32-246F28A1B2C3", "lote-7", 3600, 0x97DE562B, 67, 3585029),
+    ("ESP32-AABBCCDDEEFF", "v1.3.0", 604800, 0x33B7EF43, 55, 571960704),
+    ("ESP32-AABBCCDDEEFF", "v1.3.0", 10000000, 0x33B7EF43, 55, 571960704),
+]
+
+
+def rollout_hash(device_id, seed):
+    h = 2166136261
+    for b in (device_id + ":" + seed).encode():
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def rollout_cohort(h):
+    return h % 100
+
+
+def rollout_delay_ms(h, window_s):
+    window_s = min(window_s, MAX_WINDOW_S)
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & 0xFFFFFFFF
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & 0xFFFFFFFF
+    h ^= h >> 16
+    return (h * window_s * 1000) >> 32
+
+
+def check_vectors():
+    """Falla si las funciones dejaron de reproducir las de librollout.cpp."""
+    for device_id, seed, window_s, h, cohort, delay_ms in VECTORS:
+        got = rollout_hash(device_id, seed)
+        assert got == h, "hash de %s:%s: %08X != %08X" % (device_id, seed, got, h)
+        assert rollout_cohort(got) == cohort, "cohorte de %s:%s" % (device_id, seed)
+        assert rollout_delay_ms(got, window_s) == delay_ms, "retardo de %s:%s en %d s" % (device_id, seed, window_s)
+
+
+def make_fleet(n, link_kbps, rng):
+    """IDs con el formato de getDeviceId() y velocidad de enlace en bytes/s."""
+    fleet = []
+    for _ in range(n):
+        mac = "".join("%02X" % rng.randrange(256) for _ in range(6))
+        link = link_kbps * math.exp(rng.gauss(0, 0.6)) * 1000 / 8
+        fleet.append(("ESP32-" + mac, link))
+    return fleet
+
+
+def schedule(fleet, args):
+    """(inicio en s, velocidad en bytes/s) de los dispositivos que participan."""
+    seed = args.seed or args.version
+    rate = args.rate_kbps * 1000 / 8
+    plan = []
+    for device_id, link in fleet:
+        h = rollout_hash(device_id, seed)
+        if rollout_cohort(h) >= args.percent:
+            continue
+        speed = min(link, rate) if rate else link
+        plan.append((rollout_delay_ms(h, args.window) / 1000.0, speed))
+    return plan
+
+
+def simulate(plan, size, origin_bps):
+    """Avanza en pasos de 1 s; con capacidad de origen se reparte en proporción."""
+    pending = sorted(plan)
+    active = []            # [restante, velocidad, inicio]
+    finished = []
+    t = 0
+    peak_bps = peak_active = 0
+    i = 0
+    while i < len(pending) or active:
+        while i < len(pending) and pending[i][0] <= t:
+            active.append([float(size), pending[i][1], pending[i][0]])
+            i += 1
+        demand = sum(a[1] for a in active)
+        scale = min(1.0, origin_bps / demand) if origin_bps and demand else 1.0
+        served = 0.0
+        for a in active:
+            step = min(a[0], a[1] * scale)
+            a[0] -= step
+            served += step
+        peak_bps = max(peak_bps, served)
+        peak_active = max(peak_active, len(active))
+        t += 1
+        for a in [a for a in active if a[0] <= 0]:
+            finished.append(t - a[2])
+            active.remove(a)
+    return {"devices": len(plan), "peak_mbps": peak_bps * 8 / 1e6, "peak_active": peak_active,
+            "total_s": t, "finished": sorted(finished)}
+
+
+def report(title, result):
+    f = result["finished"]
+    pct = lambda p: f[min(len(f) - 1, int(p * len(f)))] if f else 0
+    print("%s: %d dispositivos, pico %.1f Mbit/s con %d descargas simultáneas, "
+          "fin en %d s (descarga p50 %d s, p95 %d s)"
+          % (title, result["devices"], result["peak_mbps"], result["peak_active"],
+             result["total_s"], pct(0.5), pct(0.95)))
+
+
+async def live_device(url, start, speed, speedup, t0, buckets):
+    """Descarga url empezando en start (tiempo real / speedup) y leyendo a speed·speedup."""
+    await asyncio.sleep(max(0.0, t0 + start / speedup - time.monotonic()))
+    parts = urllib.parse.urlsplit(url)
+    reader, writer = await asyncio.open_connection(parts.hostname, parts.port or 80)
+    writer.write(("GET %s HTTP/1.0\r\nHost: %s\r\n\r\n" % (parts.path or "/", parts.hostname)).encode())
+    await writer.drain()
+    await reader.readuntil(b"\r\n\r\n")
+    rate = speed * speedup
+    tokens, last = BURST_BYTES, time.monotonic()
+    while True:
+        chunk = await reader.read(4096)
+        if not chunk:
+            break
+        second = int((time.monotonic() - t0) * speedup)
+        buckets[second] = buckets.get(second, 0) + len(chunk)
+        now = time.monotonic()
+        tokens = min(BURST_BYTES, tokens + (now - last) * rate) - len(chunk)
+        last = now
+        if tokens < 0:
+            await asyncio.sleep(-tokens / rate)
+    writer.close()
+
+
+async def live(plan, args):
+    rng = random.Random(args.random_seed + 1)
+    sample = rng.sample(plan, min(args.sample, len(plan)))
+    buckets = {}
+    t0 = time.monotonic() + 0.5
+    await asyncio.gather(*(live_device(args.http, s, v, args.speedup, t0, buckets) for s, v in sample))
+    # Cada segundo simulado dura 1/speedup s reales; se reescala a la flota completa
+    factor = len(plan) / float(len(sample))
+    peak = max(buckets.values()) * factor if buckets else 0
+    print("En vivo (%d de %d dispositivos, x%d): pico %.1f Mbit/s estimado para la flota"
+          % (len(sample), len(plan), args.speedup, peak * 8 / 1e6))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--devices", type=int, default=10000)
+    parser.add_argument("--version", default="v1.2.0", help="versión anunciada (semilla por defecto)")
+    parser.add_argument("--seed", help="semilla de la cohorte (rollout.seed)")
+    parser.add_argument("--percent", type=int, default=100, help="rollout.percent")
+    parser.add_argument("--window", type=int, default=0, help="rollout.window_s")
+    parser.add_argument("--rate-kbps", type=int, default=0, help="rollout.rate_kbps")
+    parser.add_argument("--image-size", type=int, default=1300000, help="bytes a descargar por dispositivo")
+    parser.add_argument("--link-kbps", type=float, default=2000, help="mediana del enlace de cada sitio")
+    parser.add_argument("--origin-mbps", type=float, default=0, help="capacidad del servidor (0 = ilimitada)")
+    parser.add_argument("--random-seed", type=int, default=1)
+    parser.add_argument("--http", metavar="URL", help="ejecuta una muestra contra un servidor HTTP local")
+    parser.add_argument("--sample", type=int, default=200)
+    parser.add_argument("--speedup", type=int, default=60)
+    parser.add_argument("--check", action="store_true", help="solo verifica los vectores compartidos con test/test_rollout")
+    args = parser.parse_args()
+
+    check_vectors()
+    if args.check:
+        print("Vectores de librollout.cpp: OK")
+        return
+
+    fleet = make_fleet(args.devices, args.link_kbps, random.Random(args.random_seed))
+    origin = args.origin_mbps * 1e6 / 8
+    baseline = argparse.Namespace(**dict(vars(args), percent=100, window=0, rate_kbps=0))
+    report("Sin controles", simulate(schedule(fleet, baseline), args.image_size, origin))
+    plan = schedule(fleet, args)
+    report("Despliegue (%d%%, ventana %d s, %d kbit/s)" % (args.percent, args.window, args.rate_kbps),
+           simulate(plan, args.image_size, origin))
+    if args.http and plan:
+        asyncio.run(live(plan, args))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,140 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <libaggregate.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Bin del histograma: exacto hasta 7 y luego 4 sub-bins por potencia de dos.
+ */
+static inline uint8_t binOf(uint16_t v) {
+  if (v < 4) return v;
+  uint8_t b = 31 - __builtin_clz(v);          // floor(log2 v), 2..15
+  return 4 * (b - 1) + ((v >> (b - 2)) & 3);
+}
+
+// Límite inferior y ancho de un bin
+static inline void binRange(uint8_t bin, uint32_t * low, uint32_t * width) {
+  if (bin < 4) {
+    *low = bin;
+    *width = 1;
+    return;
+  }
+  uint8_t b = bin / 4 + 1;
+  *width = 1u << (b - 2);
+  *low = (1u << b) + (bin & 3) * *width;
+}
+
+void aggReset(AggWindow * w) {
+  memset(w, 0, sizeof(*w));
+  for (int c = 0; c < AGG_CHANNELS; c++) w->min[c] = UINT16_MAX;
+}
+
+void aggAdd(AggWindow * w, uint32_t ts, const SensorData * data) {
+  if (w->samples == UINT16_MAX) return;       // Ventana llena: los contadores no deben desbordar
+  if (w->samples == 0) w->startTs = ts;
+  w->endTs = ts;
+  w->samples++;
+
+  uint16_t v[AGG_CHANNELS];
+  sensorChannels(data, v);
+  int first = data->ccs811_valido ? 0 : SENSOR_CCS811_CHANNELS;
+  int last = data->pms7003_valido ? AGG_CHANNELS : SENSOR_CCS811_CHANNELS;
+  for (int c = first; c < last; c++) {
+    uint16_t x = v[c];
+    w->count[c]++;
+    if (x < w->min[c]) w->min[c] = x;
+    if (x > w->max[c]) w->max[c] = x;
+    w->sum[c] += x;
+    w->sumSq[c] += (uint32_t)x * x;
+    w->hist[c][binOf(x)]++;
+  }
+}
+
+uint16_t aggPercentile(const AggWindow * w, int ch, uint8_t pct) {
+  uint32_t n = w->count[ch];
+  if (n == 0) return 0;
+  // Rango (1..n) de la muestra buscada
+  uint32_t rank = (n * pct + 99) / 100;
+  if (rank == 0) rank = 1;
+  uint32_t seen = 0;
+  for (uint8_t bin = 0; bin < AGG_HIST_BINS; bin++) {
+    uint32_t h = w->hist[ch][bin];
+    if (seen + h >= rank) {
+      uint32_t low, width;
+      binRange(bin, &low, &width);
+      // Interpola suponiendo las muestras repartidas uniformemente en el bin
+      uint32_t est = low + (width * (2 * (rank - seen) - 1)) / (2 * h);
+      if (est < w->min[ch]) est = w->min[ch];
+      if (est > w->max[ch]) est = w->max[ch];
+      return (uint16_t)est;
+    }
+    seen += h;
+  }
+  return w->max[ch];
+}
+
+bool aggChannel(const AggWindow * w, int ch, AggStats * out) {
+  if (ch < 0 || ch >= AGG_CHANNELS || w->count[ch] == 0) return false;
+  uint32_t n = w->count[ch];
+  out->count = n;
+  out->min = w->min[ch];
+  out->max = w->max[ch];
+  out->mean = (float)w->sum[ch] / n;
+  // Varianza con enteros exactos: (n*Σx² - (Σx)²) / n²
+  uint64_t s = w->sum[ch];
+  uint64_t num = n * w->sumSq[ch] - s * s;
+  out->stddev = sqrtf((float)((double)num / ((double)n * n)));
+  out->p50 = aggPercentile(w, ch, 50);
+  out->p95 = aggPercentile(w, ch, 95);
+  return true;
+}
+
+/**
+ * {"ts":<inicio>,"dur":<s>,"n":<muestras>,"ch":{"co2":[min,max,media,sd,p50,p95,n],...}}
+ * Media y desviación con un decimal; los canales sin muestras se omiten.
+ */
+size_t aggEncodeJson(const AggWindow * w, char * out, size_t outSize) {
+  int n = snprintf(out, outSize, "{\"ts\":%lu,\"dur\":%lu,\"n\":%u,\"ch\":{",
+                   (unsigned long)w->startTs, (unsigned long)(w->endTs - w->startTs), (unsigned)w->samples);
+  if (n < 0 || (size_t)n >= outSize) return 0;
+  size_t pos = n;
+  bool first = true;
+  for (int c = 0; c < AGG_CHANNELS; c++) {
+    AggStats st;
+    if (!aggChannel(w, c, &st)) continue;
+    n = snprintf(out + pos, outSize - pos, "%s\"%s\":[%u,%u,%.1f,%.1f,%u,%u,%u]", first ? "" : ",",
+                 sensorChannelName(c), st.min, st.max, st.mean, st.stddev, st.p50, st.p95, st.count);
+    if (n < 0 || (size_t)n >= outSize - pos) return 0;
+    pos += n;
+    first = false;
+  }
+  if (pos + 3 > outSize) return 0;
+  out[pos++] = '}';
+  out[pos++] = '}';
+  out[pos] = '\0';
+  return pos;
+}
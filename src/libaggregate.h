@@ -0,0 +1,71 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBAGGREGATE_H
+#define LIBAGGREGATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libsensordata.h>
+
+// Agregación por ventanas de tiempo con memoria constante. Para cada canal
+// (CO2, TVOC y los 12 del PMS7003) guarda mínimo, máximo, suma, suma de
+// cuadrados y un histograma logarítmico del que se aproximan p50 y p95.
+// Los arreglos están organizados por campo (structure of arrays) para que
+// aggAdd() recorra los 14 canales con el mismo bucle.
+
+#define AGG_CHANNELS SENSOR_CHANNELS ///< CO2, TVOC y los 12 campos del PMS7003
+#define AGG_HIST_BINS 60            ///< 4 sub-bins por octava sobre 0..65535 (error de un percentil menor que el ancho de su bin: < 25 % relativo, exacto hasta 7)
+#define AGG_JSON_MAX (64 + AGG_CHANNELS * 72) ///< Tamaño máximo del resumen JSON
+
+struct AggWindow {
+  uint32_t startTs;                 ///< Marca de tiempo de la primera muestra
+  uint32_t endTs;                   ///< Marca de tiempo de la última muestra
+  uint16_t samples;                 ///< Muestras recibidas en la ventana
+  uint16_t count[AGG_CHANNELS];     ///< Muestras válidas por canal
+  uint16_t min[AGG_CHANNELS];
+  uint16_t max[AGG_CHANNELS];
+  uint32_t sum[AGG_CHANNELS];
+  uint64_t sumSq[AGG_CHANNELS];
+  uint16_t hist[AGG_CHANNELS][AGG_HIST_BINS];
+};
+
+// Resumen de un canal
+struct AggStats {
+  uint16_t count;
+  uint16_t min;
+  uint16_t max;
+  float mean;
+  float stddev;
+  uint16_t p50;
+  uint16_t p95;
+};
+
+void aggReset(AggWindow * w);       ///< Vacía la ventana
+void aggAdd(AggWindow * w, uint32_t ts, const SensorData * data); ///< Agrega una muestra; ignora los sensores no válidos
+bool aggChannel(const AggWindow * w, int ch, AggStats * out); ///< Calcula el resumen del canal ch; false si no tiene muestras
+uint16_t aggPercentile(const AggWindow * w, int ch, uint8_t pct); ///< Percentil aproximado (interpolado dentro del bin)
+size_t aggEncodeJson(const AggWindow * w, char * out, size_t outSize); ///< Escribe el resumen JSON; retorna 0 si no cabe
+
+#endif /* LIBAGGREGATE_H */
@@ -0,0 +1,52 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <libbackoff.h>
+
+void backoffInit(Backoff * b, uint32_t baseMs, uint32_t maxMs) {
+  b->baseMs = baseMs;
+  b->maxMs = maxMs < baseMs ? baseMs : maxMs;
+  b->attempt = 0;
+}
+
+/**
+ * Calcula la espera del siguiente reintento: el tramo crece como base * 2^intento
+ * hasta maxMs, y la espera se elige al azar entre la mitad y el total del tramo
+ * ("equal jitter"). Así los dispositivos que perdieron la conexión al mismo tiempo
+ * no reintentan todos en el mismo instante, pero ninguno reintenta demasiado pronto.
+ */
+uint32_t backoffNext(Backoff * b, uint32_t random) {
+  uint32_t window = b->maxMs;
+  if (b->attempt < 31 && (b->baseMs << b->attempt) >> b->attempt == b->baseMs) {
+    uint32_t exp = b->baseMs << b->attempt;
+    if (exp < window) window = exp;
+  }
+  if (b->attempt < 31) b->attempt++;
+  uint32_t half = window / 2;
+  return half + random % (window - half + 1);
+}
+
+void backoffReset(Backoff * b) {
+  b->attempt = 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBBACKOFF_H
+#define LIBBACKOFF_H
+
+#include <stdint.h>
+
+// Backoff exponencial con jitter para reintentos de conexión. No depende de
+// Arduino: el valor aleatorio se recibe como parámetro (esp_random() en el ESP32).
+
+struct Backoff {
+  uint32_t baseMs;                  ///< Espera del primer reintento
+  uint32_t maxMs;                   ///< Tope de la espera
+  uint32_t attempt;                 ///< Reintentos consecutivos fallidos
+};
+
+void backoffInit(Backoff * b, uint32_t baseMs, uint32_t maxMs); ///< Configura el backoff y lo deja en el primer intento
+uint32_t backoffNext(Backoff * b, uint32_t random); ///< Retorna la espera del siguiente reintento, entre la mitad y el total del tramo exponencial
+void backoffReset(Backoff * b);     ///< Vuelve al primer intento tras una conexión exitosa
+
+#endif /* LIBBACKOFF_H */
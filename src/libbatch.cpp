@@ -0,0 +1,116 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <libbatch.h>
+
+static TimedSample ring[BATCH_CAPACITY]; // Ring buffer de muestras pendientes
+static uint16_t head = 0;           // Índice de la muestra más antigua
+static uint16_t count = 0;          // Muestras pendientes
+static uint32_t arrivalMs[BATCH_CAPACITY]; // millis() en que llegó cada muestra
+static uint32_t dropped = 0;        // Muestras descartadas por desborde
+static uint16_t maxSamples = BATCH_MAX_SAMPLES;
+static uint32_t maxSeconds = BATCH_MAX_SECONDS;
+static bool retryPending = false;   // Hubo una publicación fallida y se espera hasta retryAtMs
+static uint32_t retryAtMs = 0;
+static uint32_t retryDelayMs = BATCH_RETRY_MS;
+
+/**
+ * Ajusta los límites del lote. Se publica al llegar a maxSamples muestras
+ * o cuando la más antigua cumple maxSeconds, lo que ocurra primero.
+ */
+void batchConfigure(uint16_t samples, uint32_t seconds) {
+  if (samples == 0) samples = 1;
+  if (samples > BATCH_CAPACITY) samples = BATCH_CAPACITY;
+  maxSamples = samples;
+  maxSeconds = seconds;
+}
+
+uint16_t batchMaxSamples() {
+  return maxSamples;
+}
+
+/**
+ * Agrega una muestra al final del ring buffer.
+ * Si está lleno (p.ej. sin conexión) se descarta la más antigua.
+ */
+bool batchAdd(uint32_t timestamp, const SensorData * data, uint32_t nowMs) {
+  bool kept = true;
+  if (count == BATCH_CAPACITY) {
+    head = (head + 1) % BATCH_CAPACITY;
+    count--;
+    dropped++;
+    kept = false;
+  }
+  uint16_t tail = (head + count) % BATCH_CAPACITY;
+  ring[tail].timestamp = timestamp;
+  ring[tail].data = *data;
+  arrivalMs[tail] = nowMs;
+  count++;
+  return kept;
+}
+
+bool batchShouldFlush(uint32_t nowMs) {
+  if (count == 0) return false;
+  if (retryPending && (int32_t)(nowMs - retryAtMs) < 0) return false;
+  if (count >= maxSamples) return true;
+  return (nowMs - arrivalMs[head]) >= maxSeconds * 1000UL;
+}
+
+uint16_t batchCount() {
+  return count;
+}
+
+const TimedSample * batchPeek(uint16_t index) {
+  if (index >= count) return nullptr;
+  return &ring[(head + index) % BATCH_CAPACITY];
+}
+
+/**
+ * Pospone el próximo envío después de una publicación fallida con la conexión
+ * aún arriba, para no reintentar en cada pasada de loop(). La espera se
+ * duplica con cada fallo seguido y vuelve a BATCH_RETRY_MS al publicar.
+ */
+void batchDefer(uint32_t nowMs) {
+  retryAtMs = nowMs + (retryPending ? retryDelayMs : BATCH_RETRY_MS);
+  retryDelayMs = retryPending ? retryDelayMs * 2 : BATCH_RETRY_MS * 2;
+  if (retryDelayMs > BATCH_RETRY_MAX_MS) retryDelayMs = BATCH_RETRY_MAX_MS;
+  retryPending = true;
+}
+
+/**
+ * Libera las muestras más antiguas una vez publicadas.
+ */
+void batchConsume(uint16_t n) {
+  if (n > count) n = count;
+  head = (head + n) % BATCH_CAPACITY;
+  count -= n;
+  if (n > 0) {
+    retryPending = false;
+    retryDelayMs = BATCH_RETRY_MS;
+  }
+}
+
+uint32_t batchDropped() {
+  return dropped;
+}
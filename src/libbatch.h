@@ -0,0 +1,54 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBBATCH_H
+#define LIBBATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libsensordata.h>
+
+// Este módulo no depende de Arduino: el tiempo se recibe como parámetro.
+
+#define BATCH_CAPACITY 16           ///< Muestras que caben en el ring buffer (memoria fija)
+#ifndef BATCH_MAX_SAMPLES
+#define BATCH_MAX_SAMPLES 1         ///< Muestras por mensaje; 1 publica cada muestra sola en TOPIC_PUB
+#endif
+#ifndef BATCH_MAX_SECONDS
+#define BATCH_MAX_SECONDS 30        ///< Segundos máximos que una muestra espera antes de publicar el lote
+#endif
+#define BATCH_RETRY_MS 2000         ///< Espera tras una publicación fallida; se duplica en cada fallo seguido
+#define BATCH_RETRY_MAX_MS 60000    ///< Espera máxima entre reintentos de publicación
+
+void batchConfigure(uint16_t maxSamples, uint32_t maxSeconds); ///< Ajusta los límites N muestras / T segundos (lo que ocurra primero)
+uint16_t batchMaxSamples();         ///< Retorna el límite actual de muestras por lote
+bool batchAdd(uint32_t timestamp, const SensorData * data, uint32_t nowMs); ///< Agrega una muestra. Retorna false si tuvo que descartar la más antigua
+bool batchShouldFlush(uint32_t nowMs); ///< Retorna true si el lote alcanzó N muestras o T segundos y no hay un reintento pendiente
+void batchDefer(uint32_t nowMs);    ///< Pospone el próximo envío tras una publicación fallida (espera creciente hasta BATCH_RETRY_MAX_MS)
+uint16_t batchCount();              ///< Número de muestras pendientes
+const TimedSample * batchPeek(uint16_t index); ///< Muestra pendiente en la posición index (0 = la más antigua)
+void batchConsume(uint16_t count);  ///< Libera las count muestras más antiguas tras publicarlas
+uint32_t batchDropped();            ///< Muestras descartadas por desborde desde el arranque
+
+#endif /* LIBBATCH_H */
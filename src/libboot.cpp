@@ -0,0 +1,95 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <libboot.h>
+#include <libprofiler.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+static inline uint32_t bootMicros() { return micros(); }
+static inline uint32_t bootMillis() { return millis(); }
+static inline void bootYield() { delay(1); }   // Deja correr las tareas de WiFi y lwIP
+#else
+#include <chrono>
+static inline uint32_t bootMicros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static inline uint32_t bootMillis() { return bootMicros() / 1000; }
+static inline void bootYield() {}
+#endif
+
+enum BootJobState : uint8_t {
+  BOOT_JOB_PENDING,                 // Esperando dependencias
+  BOOT_JOB_RUNNING,                 // Iniciada, aún no termina
+  BOOT_JOB_DONE
+};
+
+struct BootJob {
+  const char * name;
+  BootStep step;
+  uint32_t deps;
+  uint32_t startUs;
+  BootJobState state;
+};
+
+static BootJob jobs[BOOT_MAX_JOBS];
+static int jobCount = 0;
+static uint32_t doneMask = 0;
+
+int bootAddJob(const char * name, BootStep step, uint32_t deps) {
+  if (jobCount >= BOOT_MAX_JOBS || step == nullptr) return -1;
+  jobs[jobCount] = { name, step, deps, 0, BOOT_JOB_PENDING };
+  return jobCount++;
+}
+
+bool bootRunOnce() {
+  for (int i = 0; i < jobCount; i++) {
+    BootJob & job = jobs[i];
+    if (job.state == BOOT_JOB_DONE || (job.deps & ~doneMask) != 0) continue;
+    if (job.state == BOOT_JOB_PENDING) {
+      job.startUs = bootMicros();
+      job.state = BOOT_JOB_RUNNING;
+    }
+    if (job.step()) {
+      job.state = BOOT_JOB_DONE;
+      doneMask |= BOOT_DEP(i);
+      profilerRecord(job.name, job.startUs, bootMicros() - job.startUs);
+    }
+  }
+  return doneMask == (jobCount ? (uint32_t)((1ull << jobCount) - 1) : 0);
+}
+
+bool bootRun(uint32_t timeoutMs) {
+  uint32_t start = bootMillis();
+  while (!bootRunOnce()) {
+    if (bootMillis() - start >= timeoutMs) return false;
+    bootYield();
+  }
+  return true;
+}
+
+bool bootJobDone(int id) {
+  return id >= 0 && id < jobCount && (doneMask & BOOT_DEP(id)) != 0;
+}
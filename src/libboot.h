@@ -0,0 +1,45 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBBOOT_H
+#define LIBBOOT_H
+
+#include <stdint.h>
+
+// Orquestador cooperativo del arranque. Cada tarea es una función que se llama
+// repetidamente hasta que retorna true; una tarea solo empieza cuando terminaron
+// todas sus dependencias. Así la asociación WiFi, el calentamiento del CCS811 y
+// la sincronización SNTP avanzan a la vez en lugar de uno tras otro.
+
+#define BOOT_MAX_JOBS 8             ///< Tareas que se pueden registrar
+#define BOOT_DEP(id) ((id) >= 0 && (id) < 32 ? 1u << (id) : 0u) ///< Máscara de dependencia sobre la tarea id (0 si id es -1)
+
+typedef bool (*BootStep)();         ///< Avanza la tarea sin bloquear; retorna true al terminar
+
+int bootAddJob(const char * name, BootStep step, uint32_t deps = 0); ///< Registra una tarea; retorna su id o -1 si no hay espacio
+bool bootRunOnce();                 ///< Da una pasada a las tareas listas; retorna true si todas terminaron
+bool bootRun(uint32_t timeoutMs);   ///< Repite pasadas hasta terminar o vencer timeoutMs; retorna true si todas terminaron
+bool bootJobDone(int id);           ///< Retorna true si la tarea id terminó
+
+#endif /* LIBBOOT_H */
@@ -0,0 +1,106 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <libdeadband.h>
+#include <stdio.h>
+#include <string.h>
+
+void deadbandDefaults(DeadbandConfig * config) {
+  memset(config, 0, sizeof(*config));
+  config->absolute[0] = 25;             // CO2: 25 ppm
+  config->relative[0] = 50;             // o 5 %
+  config->absolute[1] = 10;             // TVOC: 10 ppb
+  config->relative[1] = 100;
+  for (int c = SENSOR_CCS811_CHANNELS; c < SENSOR_CHANNELS; c++) {
+    config->absolute[c] = c < 8 ? 2 : 50;  // Masas: 2 µg/m³; conteos: 50 partículas/0.1 L
+    config->relative[c] = 100;             // o 10 %
+  }
+  config->heartbeatS = 900;
+}
+
+void deadbandInit(Deadband * d, const DeadbandConfig * config) {
+  memset(d, 0, sizeof(*d));
+  d->config = *config;
+}
+
+uint16_t deadbandCheck(const Deadband * d, uint32_t ts, const SensorData * data) {
+  uint16_t v[SENSOR_CHANNELS];
+  sensorChannels(data, v);
+  uint16_t mask = 0;
+  for (int c = 0; c < SENSOR_CHANNELS; c++) {
+    if (!sensorChannelValid(data, c)) continue;
+    uint16_t bit = 1u << c;
+    if (!(d->hasLast & bit)) {
+      mask |= bit;                      // Primer valor (o el sensor volvió): siempre se reporta
+      continue;
+    }
+    uint32_t last = d->last[c];
+    uint32_t delta = v[c] > last ? v[c] - last : last - v[c];
+    uint32_t threshold = (last * d->config.relative[c]) / 1000;
+    if (d->config.absolute[c] > threshold) threshold = d->config.absolute[c];
+    bool moved = threshold == 0 ? delta > 0 : delta >= threshold;
+    bool silent = d->config.heartbeatS > 0 && ts - d->lastTs[c] >= d->config.heartbeatS;
+    if (moved || silent) mask |= bit;
+  }
+  return mask;
+}
+
+void deadbandCommit(Deadband * d, uint32_t ts, const SensorData * data, uint16_t mask) {
+  uint16_t v[SENSOR_CHANNELS];
+  sensorChannels(data, v);
+  for (int c = 0; c < SENSOR_CHANNELS; c++) {
+    uint16_t bit = 1u << c;
+    if (!sensorChannelValid(data, c)) {
+      // El PMS7003 envía cada ~2.3 s y algunas muestras llegan sin trama nueva:
+      // el último valor se conserva hasta DEADBAND_STALE_S sin datos, y solo
+      // entonces se olvida para reportar de inmediato cuando el sensor vuelva
+      if (ts - d->seenTs[c] >= DEADBAND_STALE_S) d->hasLast &= ~bit;
+      continue;
+    }
+    d->seenTs[c] = ts;
+    if (mask & bit) {
+      d->last[c] = v[c];
+      d->lastTs[c] = ts;
+      d->hasLast |= bit;
+    }
+  }
+}
+
+size_t deadbandEncodeJson(uint32_t ts, const SensorData * data, uint16_t mask, char * out, size_t outSize) {
+  uint16_t v[SENSOR_CHANNELS];
+  sensorChannels(data, v);
+  int n = snprintf(out, outSize, "{\"ts\":%lu", (unsigned long)ts);
+  if (n < 0 || (size_t)n >= outSize) return 0;
+  size_t pos = n;
+  for (int c = 0; c < SENSOR_CHANNELS; c++) {
+    if (!(mask & (1u << c))) continue;
+    n = snprintf(out + pos, outSize - pos, ",\"%s\":%u", sensorChannelName(c), (unsigned)v[c]);
+    if (n < 0 || (size_t)n >= outSize - pos) return 0;
+    pos += n;
+  }
+  if (pos + 2 > outSize) return 0;
+  out[pos++] = '}';
+  out[pos] = '\0';
+  return pos;
+}
@@ -0,0 +1,63 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBDEADBAND_H
+#define LIBDEADBAND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libsensordata.h>
+
+// Envío por excepción (deadband). Un canal se reporta solo cuando se aleja de
+// su último valor enviado más que su umbral, o cuando lleva heartbeat segundos
+// sin enviarse. El umbral de cada canal es el mayor entre uno absoluto y uno
+// relativo (en milésimas del último valor enviado); con ambos en 0 se reporta
+// cualquier cambio.
+
+#define DEADBAND_JSON_MAX (32 + SENSOR_CHANNELS * 18) ///< Tamaño máximo del mensaje parcial
+#ifndef DEADBAND_STALE_S
+#define DEADBAND_STALE_S 10         ///< Segundos sin datos válidos de un canal antes de olvidar su último valor
+#endif
+
+struct DeadbandConfig {
+  uint16_t absolute[SENSOR_CHANNELS];   ///< Umbral absoluto por canal, en las unidades del sensor
+  uint16_t relative[SENSOR_CHANNELS];   ///< Umbral relativo por canal, en milésimas (50 = 5 %)
+  uint32_t heartbeatS;                  ///< Máximo silencio por canal, en segundos (0 = sin heartbeat)
+};
+
+struct Deadband {
+  DeadbandConfig config;
+  uint16_t last[SENSOR_CHANNELS];       ///< Último valor enviado
+  uint32_t lastTs[SENSOR_CHANNELS];     ///< Marca de tiempo del último envío
+  uint32_t seenTs[SENSOR_CHANNELS];     ///< Marca de tiempo del último dato válido
+  uint16_t hasLast;                     ///< Máscara de canales con valor enviado
+};
+
+void deadbandInit(Deadband * d, const DeadbandConfig * config); ///< Configura y olvida los últimos valores enviados
+void deadbandDefaults(DeadbandConfig * config); ///< Umbrales por defecto para interiores
+uint16_t deadbandCheck(const Deadband * d, uint32_t ts, const SensorData * data); ///< Máscara de canales que se deben reportar
+void deadbandCommit(Deadband * d, uint32_t ts, const SensorData * data, uint16_t mask); ///< Registra como enviados los canales de mask
+size_t deadbandEncodeJson(uint32_t ts, const SensorData * data, uint16_t mask, char * out, size_t outSize); ///< {"ts":..,"co2":..} solo con los canales de mask
+
+#endif /* LIBDEADBAND_H */
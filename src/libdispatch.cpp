@@ -0,0 +1,107 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <libdispatch.h>
+
+typedef struct {
+  const char * topic;
+  uint32_t hash;
+  TopicHandler handler;
+} DispatchEntry;
+
+static DispatchEntry entries[DISPATCH_MAX_TOPICS];
+static int entryCount = 0;
+static int8_t slots[DISPATCH_TABLE_SIZE];   // Índice en entries o -1 (vacía)
+static bool slotsReady = false;
+static DispatchStats stats;
+
+static uint32_t topicHash(const char * topic) {
+  uint32_t hash = 2166136261u;
+  for (const char * p = topic; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619u;
+  return hash;
+}
+
+/**
+ * Ranura del tópico o la ranura vacía donde iría. Sondeo lineal: con la
+ * tabla a lo sumo a medio llenar la búsqueda termina en una o dos ranuras.
+ */
+static int findSlot(const char * topic, uint32_t hash) {
+  if (!slotsReady) {
+    memset(slots, -1, sizeof(slots));
+    slotsReady = true;
+  }
+  for (uint32_t i = 0; i < DISPATCH_TABLE_SIZE; i++) {
+    int slot = (hash + i) & (DISPATCH_TABLE_SIZE - 1);
+    int index = slots[slot];
+    if (index < 0) return slot;
+    if (entries[index].hash == hash) {
+      if (strcmp(entries[index].topic, topic) == 0) return slot;
+      stats.collisions++;
+    }
+  }
+  return -1;
+}
+
+int dispatchRegister(const char * topic, TopicHandler handler) {
+  uint32_t hash = topicHash(topic);
+  int slot = findSlot(topic, hash);
+  if (slot < 0) return -1;
+  int index = slots[slot];
+  if (index < 0) {
+    if (entryCount >= DISPATCH_MAX_TOPICS) return -1;
+    index = entryCount++;
+    entries[index].topic = topic;
+    entries[index].hash = hash;
+    slots[slot] = index;
+  }
+  entries[index].handler = handler;
+  return index;
+}
+
+int dispatchLookup(const char * topic) {
+  int slot = findSlot(topic, topicHash(topic));
+  return slot < 0 ? -1 : slots[slot];
+}
+
+bool dispatchMessage(const char * topic, uint8_t * payload, size_t length) {
+  int index = dispatchLookup(topic);
+  if (index < 0 || !entries[index].handler) {
+    stats.unmatched++;
+    return false;
+  }
+  stats.messages++;
+  entries[index].handler(topic, payload, length);
+  return true;
+}
+
+const DispatchStats & dispatchGetStats() {
+  return stats;
+}
+
+void dispatchReset() {
+  memset(slots, -1, sizeof(slots));
+  slotsReady = true;
+  entryCount = 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBDISPATCH_H
+#define LIBDISPATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Despacho de los mensajes MQTT recibidos por tópico. Cada tópico se registra
+// una vez con su handler; al llegar un mensaje se calcula el hash FNV-1a del
+// tópico (una pasada) y se busca en una tabla abierta, así que el costo no
+// crece con la cantidad de tópicos: solo se compara el texto del tópico que
+// coincide en hash. El payload se entrega tal como está en el buffer de
+// PubSubClient (puntero y longitud, sin terminador y sin copia); el handler
+// no debe guardarlo después de retornar. Este módulo no depende de Arduino.
+
+#define DISPATCH_MAX_TOPICS 16      ///< Tópicos registrables
+#define DISPATCH_TABLE_SIZE 32      ///< Ranuras de la tabla (potencia de 2, el doble de los tópicos)
+
+/**
+ * Handler de un tópico. payload apunta al buffer de recepción y es válido
+ * solo durante la llamada; es modificable (ArduinoJson lo usa para leer sin copiar).
+ */
+typedef void (*TopicHandler)(const char * topic, uint8_t * payload, size_t length);
+
+typedef struct {
+  uint32_t messages;                ///< Mensajes despachados a algún handler
+  uint32_t unmatched;               ///< Mensajes sin handler para su tópico
+  uint32_t collisions;              ///< Comparaciones de texto que no coincidieron (hash repetido)
+} DispatchStats;
+
+int dispatchRegister(const char * topic, TopicHandler handler); ///< Registra o reemplaza el handler; retorna el ID del tópico o -1 si no cabe. topic debe seguir existiendo
+int dispatchLookup(const char * topic);     ///< ID del tópico registrado o -1
+bool dispatchMessage(const char * topic, uint8_t * payload, size_t length); ///< Llama al handler del tópico; false si no hay
+const DispatchStats & dispatchGetStats();
+void dispatchReset();                       ///< Elimina todos los tópicos registrados
+
+#endif /* LIBDISPATCH_H */
@@ -26,15 +26,53 @@
 
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1); // Pantalla OLED vinculada al dispositivo
 
+// Pantalla en modo retenido: cada campo recuerda el texto que muestra y solo se
+// redibuja si cambió; al refrescar se envían solo las columnas modificadas de
+// cada página (8 filas) del SSD1306, no el framebuffer completo de 1 KB.
+//
+//  página 0    "IOT Sensors  " + reloj hh:mm:ss (x = 78)
+//  página 2    "Co2:  <ppm>"
+//  página 3    "TVOC: <ppb>"
+//  página 4    "Msg:"
+//  páginas 5-7 mensaje ("OK" en tamaño 2, alertas en tamaño 1)
+#define PAGES (SCREEN_HEIGHT / 8)
+#define CLOCK_X 78
+
+static bool layoutValid = false;          // false tras una vista de pantalla completa (conectando, sin señal)
+static unsigned long lastRefresh = 0;
+static uint8_t dirtyMin[PAGES];           // Rango de columnas modificadas por página (min > max: limpia)
+static uint8_t dirtyMax[PAGES];
+static char shownClock[9];
+static char shownCo2[16];
+static char shownTvoc[16];
+static char shownMessage[64];
+static bool pending = false;              // Hay datos que no se mostraron por DISPLAY_MIN_REFRESH_MS
+static char pendingMessage[sizeof(shownMessage)];
+static time_t pendingNow;
+static float pendingTemp;
+static float pendingHumi;
+static DisplayStats stats;
+static int displayDevice = -1;            // Id de la pantalla en el administrador del bus I2C
+
+// Transacciones que corren en la tarea del bus I2C (ver libi2cbus.h)
+static bool beginJob(void *) {
+  return display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS, true, false);
+}
+
+static bool fullFrameJob(void *) {
+  display.display();
+  return true;
+}
+
 /**
  * Vincula la pantalla al dispositivo y asigna el color de texto blanco como predeterminado.
  * Si no es exitosa la vinculación, se muestra un mensaje en consola.
  * NOTA: I2C debe estar inicializado antes de llamar a esta función.
  */
 void startDisplay() {
-  // I2C debe estar inicializado antes (se hace en setupSensors() o manualmente)
-  // Si no está inicializado, Wire.begin() se llamará automáticamente con pines por defecto
-  if(!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) { // Dirección 0x3C para 128x64
+  // I2C lo inicia i2cBusBegin() en main.cpp; la pantalla no vuelve a llamar Wire.begin()
+  displayDevice = i2cBusAddDevice("ssd1306", SCREEN_ADDRESS, I2C_BUS_FAST_HZ);
+  if(!i2cBusRun(displayDevice, I2C_PRIORITY_DISPLAY, beginJob, nullptr)) { // Dirección 0x3C para 128x64
     Serial.println(F("SSD1306 allocation failed"));
     Serial.println(F("Verifica la conexión I2C de la pantalla OLED"));
     for(;;); // No continúa si no se puede vincular la pantalla
@@ -46,77 +84,190 @@ void startDisplay() {
  * Imprime en la pantalla un mensaje de "No hay señal".
  */
 void displayNoSignal() {
+  layoutValid = false;    // displayLoop() vuelve a dibujar todo
   display.clearDisplay(); // Limpia la pantalla
   display.setTextSize(2); // Tamaño de texto 2
   display.setCursor(10, 10); // Posición del cursor
   display.println("No hay señal"); 
-  display.display();
+  i2cBusRun(displayDevice, I2C_PRIORITY_DISPLAY, fullFrameJob, nullptr);
 }
 
 /**
- * Agrega a la pantalla el header con mensaje "IOT Sensors" y en seguida la hora actual
+ * Muestra en la pantalla el mensaje de "Connecting to:" 
+ * y luego el nombre de la red a la que se conecta.
  */
-void displayHeader(time_t now) {  // Se recibe el tiempo actual como parámetro
-  display.setTextSize(1);         // Tamaño de texto 1
-  long int milli = now + millis() / 1000; // Se obtiene el tiempo en milisegundos 
-  struct tm* tinfo;               // Estructura para almacenar la información de la hora
-  tinfo = localtime(&milli);      // Se obtiene la hora actual
-  String hour = String(asctime(tinfo)).substring(11, 19); // Se obtiene la hora en formato hh:mm:ss
-  String title = "IOT Sensors  " + hour;  // Se crea el título con la hora
-  display.println(title);         // Se imprime el título en la pantalla
+void displayConnecting(String ssid) {
+  layoutValid = false;         // displayLoop() vuelve a dibujar todo
+  display.clearDisplay();      // Limpia la pantalla
+  display.setTextSize(1);      // Tamaño de texto 1
+  display.println("Conectando a:\n"); 
+  display.println(ssid);      // Se imprime el nombre de la red
+  i2cBusRun(displayDevice, I2C_PRIORITY_DISPLAY, fullFrameJob, nullptr); // Se muestra el contenido en la pantalla
+}
+
+static void markDirty(int16_t x0, int16_t x1, uint8_t page0, uint8_t page1) {
+  if (x0 < 0) x0 = 0;
+  if (x1 > SCREEN_WIDTH - 1) x1 = SCREEN_WIDTH - 1;
+  for (uint8_t p = page0; p <= page1 && p < PAGES; p++) {
+    if (x0 < dirtyMin[p]) dirtyMin[p] = x0;
+    if (x1 > dirtyMax[p]) dirtyMax[p] = x1;
+  }
+}
+
+static void clearDirty() {
+  memset(dirtyMin, 0xFF, sizeof(dirtyMin));
+  memset(dirtyMax, 0, sizeof(dirtyMax));
 }
 
 /**
- * Agrega los valores medidos de temperatura y humedad a la pantalla.
+ * Redibuja un campo si su texto cambió: borra su rectángulo, escribe el texto
+ * y marca sus páginas como sucias. Retorna false si no hubo cambios. Solo se
+ * comparan los size - 1 caracteres que caben en shown, que son los que se ven.
  */
-void displayMeasures(float temp, float humi) {
-  display.println("");
-  display.print("Co2: ");
-  display.print(temp);  // Se imprime la temperatura
-  display.print("    ");
-  display.print("tvoc: ");
-  display.print(humi);  // Se imprime la humedad
-  display.println("");
+static bool drawField(char *shown, size_t size, const char *text, int16_t x, uint8_t page,
+                      uint8_t pages, uint8_t textSize) {
+  if (strncmp(shown, text, size - 1) == 0) return false;
+  strncpy(shown, text, size - 1);
+  shown[size - 1] = '\0';
+  display.fillRect(x, page * 8, SCREEN_WIDTH - x, pages * 8, SSD1306_BLACK);
+  display.setTextSize(textSize);
+  display.setCursor(x, page * 8);
+  display.print(shown);
+  markDirty(x, SCREEN_WIDTH - 1, page, page + pages - 1);
+  return true;
 }
 
 /**
- * Agrega el mensaje indicado a la pantalla.
- * Si el mensaje es OK, se busca mostrarlo centrado.
+ * Columnas [first, last] de una página del framebuffer que hay que enviar.
  */
-void displayMessage(String message) {
-  display.setTextSize(1);     // Tamaño de texto 1
-  display.println("\nMsg:");  // Se imprime el mensaje
-  display.setTextSize(2);     // Tamaño de texto 2
-  if (message.equals("OK")) { // Si el mensaje es OK
-    display.println("    " + message);  // Se imprime centrado
-  } else {
-    display.println("");      // Se imprime un salto de línea
-    display.setTextSize(1);   // Tamaño de texto 1
-    display.println(message); // Se imprime el mensaje en la pantalla
+struct PageWrite {
+  const uint8_t *row;
+  uint8_t page;
+  uint8_t first;
+  uint8_t last;
+  uint32_t busUs;
+};
+
+/**
+ * Envía una página sucia. Usa el modo de direccionamiento horizontal que deja
+ * begin(): PAGEADDR/COLUMNADDR acotan la ventana y los datos avanzan solos
+ * dentro de ella.
+ */
+static bool pageJob(void *context) {
+  PageWrite *w = (PageWrite *)context;
+  uint32_t start = micros();
+  const uint8_t window[] = { SSD1306_PAGEADDR, w->page, w->page, SSD1306_COLUMNADDR, w->first, w->last };
+  Wire.beginTransmission(SCREEN_ADDRESS);
+  Wire.write((uint8_t)0x00);              // Co = 0, D/C = 0: comandos
+  Wire.write(window, sizeof(window));
+  bool ok = Wire.endTransmission() == 0;
+  for (uint16_t c = w->first; ok && c <= w->last; c += DISPLAY_I2C_CHUNK) {
+    uint16_t n = w->last + 1 - c;
+    if (n > DISPLAY_I2C_CHUNK) n = DISPLAY_I2C_CHUNK;
+    Wire.beginTransmission(SCREEN_ADDRESS);
+    Wire.write((uint8_t)0x40);            // Co = 0, D/C = 1: datos
+    Wire.write(w->row + c, n);
+    ok = Wire.endTransmission() == 0;
   }
+  w->busUs = micros() - start;
+  return ok;
 }
 
 /**
- * Muestra en la pantalla el mensaje de "Connecting to:" 
- * y luego el nombre de la red a la que se conecta.
+ * Envía al SSD1306 solo las columnas sucias de cada página, una transacción
+ * por página: entre página y página el bus puede atender una lectura de sensor.
  */
-void displayConnecting(String ssid) {
-  display.clearDisplay();      // Limpia la pantalla
-  display.setTextSize(1);      // Tamaño de texto 1
-  display.println("Conectando a:\n"); 
-  display.println(ssid);      // Se imprime el nombre de la red
-  display.display();          // Se muestra el contenido en la pantalla
+static void flushDirty() {
+  uint8_t *buffer = display.getBuffer();
+  uint32_t bytes = 0;
+  uint32_t busUs = 0;
+  for (uint8_t p = 0; p < PAGES; p++) {
+    if (dirtyMin[p] > dirtyMax[p]) continue;
+    PageWrite w = { buffer + p * SCREEN_WIDTH, p, dirtyMin[p], dirtyMax[p], 0 };
+    i2cBusRun(displayDevice, I2C_PRIORITY_DISPLAY, pageJob, &w);
+    bytes += w.last + 1 - w.first;
+    busUs += w.busUs;
+  }
+  clearDirty();
+  stats.refreshes++;
+  stats.bytes += bytes;
+  stats.busUs += busUs;
+  stats.lastBusUs = busUs;
+  if (busUs > stats.maxBusUs) stats.maxBusUs = busUs;
+}
+
+/**
+ * Dibuja los últimos datos recibidos y envía al bus solo los campos que
+ * cambiaron desde el refresco anterior.
+ */
+static void render() {
+  lastRefresh = millis();
+  if (!layoutValid) {                     // Primer dibujo: fondo fijo y todos los campos
+    display.clearDisplay();
+    display.setTextSize(1);
+    display.setCursor(0, 0);
+    display.print("IOT Sensors");
+    display.setCursor(0, 4 * 8);
+    display.print("Msg:");
+    shownClock[0] = shownCo2[0] = shownTvoc[0] = shownMessage[0] = '\0';
+    clearDirty();
+    markDirty(0, SCREEN_WIDTH - 1, 0, PAGES - 1);
+    layoutValid = true;
+  }
+
+  char text[sizeof(shownMessage)];
+  time_t clock = pendingNow + millis() / 1000;
+  struct tm tinfo;
+  localtime_r(&clock, &tinfo);
+  strftime(text, sizeof(text), "%H:%M:%S", &tinfo);
+  drawField(shownClock, sizeof(shownClock), text, CLOCK_X, 0, 1, 1);
+  snprintf(text, sizeof(text), "Co2:  %.0f ppm", pendingTemp);
+  drawField(shownCo2, sizeof(shownCo2), text, 0, 2, 1, 1);
+  snprintf(text, sizeof(text), "TVOC: %.0f ppb", pendingHumi);
+  drawField(shownTvoc, sizeof(shownTvoc), text, 0, 3, 1, 1);
+  if (strcmp(pendingMessage, "OK") == 0) { // OK centrado en tamaño 2
+    drawField(shownMessage, sizeof(shownMessage), "    OK", 0, 5, 3, 2);
+  } else {
+    drawField(shownMessage, sizeof(shownMessage), pendingMessage, 0, 5, 3, 1);
+  }
+
+  bool dirty = false;
+  for (uint8_t p = 0; p < PAGES; p++) dirty |= dirtyMin[p] <= dirtyMax[p];
+  if (dirty) {
+    flushDirty();
+  } else {
+    stats.unchanged++;
+  }
 }
 
 /**
  * Muestra en la pantalla el mensaje recibido.
- * Se recibe el mensaje, la hora actual, la temperatura y la humedad.
+ * Se recibe el mensaje, la hora actual y las medidas de CO2 y TVOC.
+ * Como máximo un refresco cada DISPLAY_MIN_REFRESH_MS: si llega antes, los
+ * datos quedan pendientes y displayTick() los muestra al vencer el intervalo.
  */
-void displayLoop(String message, time_t now, float temp, float humi) {
-  display.clearDisplay();
-  display.setCursor(0,0); 
-  displayHeader(now);
-  displayMeasures(temp, humi);
-  displayMessage(message);
-  display.display();
-}
\ No newline at end of file
+void displayLoop(const String &message, time_t now, float temp, float humi) {
+  strncpy(pendingMessage, message.c_str(), sizeof(pendingMessage) - 1);
+  pendingMessage[sizeof(pendingMessage) - 1] = '\0';
+  pendingNow = now;
+  pendingTemp = temp;
+  pendingHumi = humi;
+  pending = true;
+  displayTick();
+  if (pending) stats.rateLimited++;
+}
+
+/**
+ * Muestra los datos pendientes en cuanto vence DISPLAY_MIN_REFRESH_MS. Se
+ * llama en cada pasada de loop(); sin datos pendientes no hace nada.
+ */
+void displayTick() {
+  if (!pending) return;
+  if (layoutValid && millis() - lastRefresh < DISPLAY_MIN_REFRESH_MS) return;
+  pending = false;
+  render();
+}
+
+const DisplayStats &getDisplayStats() {
+  return stats;
+}
@@ -29,18 +29,36 @@
 #include <Adafruit_SSD1306.h>
 #include <Wire.h>
 #include <time.h>
+#include <libi2cbus.h>
 
 #define SCREEN_WIDTH 128    ///< Ancho de la pantalla (en pixeles)
 #define SCREEN_HEIGHT 64    ///< Alto de la pantalla (en pixeles)
+#define SCREEN_ADDRESS 0x3C ///< Dirección I2C del SSD1306
+#ifndef DISPLAY_MIN_REFRESH_MS
+#define DISPLAY_MIN_REFRESH_MS 1000 ///< Tiempo mínimo entre refrescos de displayLoop() (el reloj muestra segundos)
+#endif
+#define DISPLAY_I2C_CHUNK 64        ///< Bytes de datos por escritura I2C al enviar páginas sucias
+
+/**
+ * Contadores del uso del bus I2C por la pantalla.
+ */
+struct DisplayStats {
+  uint32_t refreshes;       ///< Refrescos que enviaron algo a la pantalla
+  uint32_t unchanged;       ///< Refrescos sin cambios (no tocaron el bus)
+  uint32_t rateLimited;     ///< Llamadas aplazadas por DISPLAY_MIN_REFRESH_MS (se muestran en displayTick())
+  uint32_t bytes;           ///< Bytes de imagen enviados
+  uint32_t busUs;           ///< Tiempo total de bus en microsegundos
+  uint32_t lastBusUs;       ///< Tiempo de bus del último refresco
+  uint32_t maxBusUs;        ///< Peor tiempo de bus de un refresco
+};
 
 extern Adafruit_SSD1306 display; ///< Pantalla OLED vinculada al dispositivo
 
 void startDisplay();                    ///< Vincula la pantalla al dispositivo y asigna el color de texto blanco como predeterminado. 
 void displayNoSignal();                 ///< Imprime en la pantalla un mensaje de "No hay señal".
-void displayHeader(time_t now);         ///< Agrega a la pantalla el header con mensaje "IOT Sensors" y en seguida la hora actual
-void displayMeasures(float temp, float humi);  ///< Agrega los valores medidos de temperatura y humedad a la pantalla
-void displayMessage(String message);    ///< Agrega el mensaje indicado a la pantalla. Si el mensaje es OK, se busca mostrarlo centrado.
 void displayConnecting(String ssid);    ///< Muestra en la pantalla el mensaje de "Connecting to:" y luego el nombre de la red a la que se conecta.
-void displayLoop(String message, time_t now, float temp, float humi); ///< Muestra en la pantalla el mensaje recibido, las medidas de temperatura y humedad.
+void displayLoop(const String &message, time_t now, float temp, float humi); ///< Muestra el mensaje y las medidas; solo redibuja y envía los campos que cambiaron
+void displayTick();                     ///< Muestra los datos que displayLoop() dejó pendientes al vencer DISPLAY_MIN_REFRESH_MS
+const DisplayStats &getDisplayStats();  ///< Contadores de uso del bus I2C por la pantalla
 
 #endif /* LIBDISPLAY_H */
\ No newline at end of file
@@ -0,0 +1,97 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <libdutycycle.h>
+
+#define DUTY_MAGIC 0x44435931u      // "DCY1"; cambia si cambia DutyCycleState
+
+/**
+ * Tras un despertar de deep sleep se conserva el buffer; en un arranque en
+ * frío (o si la memoria RTC no tiene el formato esperado) se empieza de cero.
+ */
+void dutyInit(DutyCycleState * state, bool resume) {
+  if (resume && state->magic == DUTY_MAGIC && state->count <= DUTY_BUFFER_CAPACITY &&
+      state->head < DUTY_BUFFER_CAPACITY) {
+    return;
+  }
+  memset(state, 0, sizeof(*state));
+  state->magic = DUTY_MAGIC;
+}
+
+bool dutyAdd(DutyCycleState * state, const TimedSample * sample) {
+  bool kept = true;
+  if (state->count == DUTY_BUFFER_CAPACITY) {
+    state->head = (state->head + 1) % DUTY_BUFFER_CAPACITY;
+    state->count--;
+    state->dropped++;
+    kept = false;
+  }
+  state->samples[(state->head + state->count) % DUTY_BUFFER_CAPACITY] = *sample;
+  state->count++;
+  return kept;
+}
+
+/**
+ * Decide si este despertar debe conectarse. Se conecta cuando pasaron
+ * flushEvery·2^fallos despertares desde el último intento. Si el último envío
+ * no falló, además se conecta antes cuando no hay hora válida (hace falta SNTP
+ * para marcar las muestras) o el buffer está lleno. Con fallos pendientes manda
+ * el backoff: sin hora válida tampoco se conecta antes de tiempo, para no gastar
+ * la batería intentando en cada despertar una red que no responde.
+ */
+bool dutyOnWake(DutyCycleState * state, uint16_t flushEvery, bool timeValid) {
+  state->wakes++;
+  if (state->wakesSinceFlush < UINT16_MAX) state->wakesSinceFlush++;
+  if (flushEvery == 0) flushEvery = 1;
+  uint8_t shift = state->failures < DUTY_BACKOFF_MAX_SHIFT ? state->failures : DUTY_BACKOFF_MAX_SHIFT;
+  uint32_t interval = (uint32_t)flushEvery << shift;
+  if (state->wakesSinceFlush >= interval) return true;
+  if (state->failures > 0) return false;
+  return !timeValid || state->count >= DUTY_BUFFER_CAPACITY;
+}
+
+const TimedSample * dutyPeek(const DutyCycleState * state, uint16_t index) {
+  if (index >= state->count) return nullptr;
+  return &state->samples[(state->head + index) % DUTY_BUFFER_CAPACITY];
+}
+
+void dutyFlushDone(DutyCycleState * state, uint16_t published, bool ok) {
+  if (published > state->count) published = state->count;
+  state->head = (state->head + published) % DUTY_BUFFER_CAPACITY;
+  state->count -= published;
+  state->wakesSinceFlush = 0;
+  if (ok) {
+    state->flushes++;
+    state->failures = 0;
+  } else {
+    state->flushFailures++;
+    if (state->failures < UINT8_MAX) state->failures++;
+  }
+}
+
+uint32_t dutySleepMs(uint32_t periodMs, uint32_t awakeMs) {
+  if (awakeMs + DUTY_MIN_SLEEP_MS >= periodMs) return DUTY_MIN_SLEEP_MS;
+  return periodMs - awakeMs;
+}
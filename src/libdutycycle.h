@@ -0,0 +1,83 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBDUTYCYCLE_H
+#define LIBDUTYCYCLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libsensordata.h>
+
+// Planificador del modo de bajo consumo. El dispositivo despierta por timer,
+// mide, guarda la muestra en un buffer que sobrevive al deep sleep (memoria
+// RTC) y vuelve a dormir; solo cada N despertares levanta WiFi/TLS/MQTT para
+// vaciar el buffer. Si el envío falla, el intervalo entre intentos se duplica
+// (hasta 2^DUTY_BACKOFF_MAX_SHIFT) para no agotar la batería sin red.
+// Este módulo no depende de Arduino: el estado lo guarda quien lo llama.
+
+#ifndef DUTY_CYCLE_ENABLED
+#define DUTY_CYCLE_ENABLED 0        ///< 1: mide y duerme en deep sleep entre muestras (operación con batería)
+#endif
+#ifndef DUTY_CYCLE_PERIOD_S
+#define DUTY_CYCLE_PERIOD_S 60      ///< Segundos entre despertares (una muestra por despertar)
+#endif
+#ifndef DUTY_CYCLE_FLUSH_EVERY
+#define DUTY_CYCLE_FLUSH_EVERY 15   ///< Despertares entre envíos del buffer por MQTT
+#endif
+#ifndef DUTY_CYCLE_MEASURE_TIMEOUT_MS
+#define DUTY_CYCLE_MEASURE_TIMEOUT_MS 5000 ///< Tiempo máximo despierto esperando lecturas de CCS811 y PMS7003
+#endif
+#ifndef DUTY_CYCLE_CONNECT_TIMEOUT_MS
+#define DUTY_CYCLE_CONNECT_TIMEOUT_MS 20000 ///< Tiempo máximo para WiFi + SNTP + MQTT en un despertar de envío
+#endif
+#define DUTY_BUFFER_CAPACITY 64     ///< Muestras en memoria RTC (~2.3 kB de los 8 kB disponibles)
+#define DUTY_BACKOFF_MAX_SHIFT 4    ///< Tras fallos seguidos se reintenta cada N·2^k despertares, k ≤ 4
+#define DUTY_MIN_SLEEP_MS 1000      ///< Sueño mínimo aunque el despertar haya excedido el periodo
+
+/**
+ * Estado que persiste entre despertares. Debe vivir en memoria RTC
+ * (RTC_DATA_ATTR): se conserva en deep sleep y se pierde al cortar la energía.
+ */
+typedef struct {
+  uint32_t magic;                   ///< DUTY_MAGIC si el contenido es válido
+  uint16_t head;                    ///< Índice de la muestra más antigua
+  uint16_t count;                   ///< Muestras guardadas
+  uint16_t wakesSinceFlush;         ///< Despertares desde el último intento de envío
+  uint8_t failures;                 ///< Envíos fallidos seguidos
+  uint32_t wakes;                   ///< Despertares desde el último arranque en frío
+  uint32_t flushes;                 ///< Envíos exitosos
+  uint32_t flushFailures;           ///< Envíos fallidos
+  uint32_t dropped;                 ///< Muestras descartadas por buffer lleno
+  uint32_t lastAwakeMs;             ///< Duración del despertar anterior
+  TimedSample samples[DUTY_BUFFER_CAPACITY];
+} DutyCycleState;
+
+void dutyInit(DutyCycleState * state, bool resume); ///< Conserva el estado si resume y es válido; si no lo borra
+bool dutyAdd(DutyCycleState * state, const TimedSample * sample); ///< Guarda una muestra; false si tuvo que descartar la más antigua
+bool dutyOnWake(DutyCycleState * state, uint16_t flushEvery, bool timeValid); ///< Cuenta el despertar y retorna true si toca conectarse
+const TimedSample * dutyPeek(const DutyCycleState * state, uint16_t index); ///< Muestra en la posición index (0 = la más antigua)
+void dutyFlushDone(DutyCycleState * state, uint16_t published, bool ok); ///< Libera las muestras publicadas y registra el resultado del envío
+uint32_t dutySleepMs(uint32_t periodMs, uint32_t awakeMs); ///< Tiempo a dormir para mantener el periodo pese a lo que duró el despertar
+
+#endif /* LIBDUTYCYCLE_H */
@@ -0,0 +1,203 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <Wire.h>
+#include <libi2cbus.h>
+
+/**
+ * Transacción pendiente. Vive en la pila de quien la pide, que espera
+ * bloqueado (notificación de tarea) hasta que la tarea del bus la ejecuta.
+ */
+struct I2cRequest {
+  I2cJob job;
+  void *context;
+  uint8_t device;
+  uint8_t priority;
+  uint32_t sequence;                // Orden de llegada dentro de la misma prioridad
+  uint32_t submitUs;
+  TaskHandle_t waiter;
+  bool result;
+};
+
+static int busSda = -1;
+static int busScl = -1;
+static TaskHandle_t busTaskHandle = nullptr;
+static portMUX_TYPE busMux = portMUX_INITIALIZER_UNLOCKED;
+static I2cRequest *pending[I2C_BUS_QUEUE];
+static uint8_t pendingCount = 0;
+static uint32_t nextSequence = 0;
+static I2cDeviceStats devices[I2C_BUS_MAX_DEVICES];
+static uint8_t deviceCount = 0;
+static uint8_t consecutiveErrors = 0;
+static uint32_t recoveries = 0;
+
+/**
+ * Saca de la cola la transacción de mayor prioridad (la más antigua si empatan).
+ */
+static I2cRequest *takeNext() {
+  portENTER_CRITICAL(&busMux);
+  int best = -1;
+  for (int i = 0; i < pendingCount; i++) {
+    if (best < 0 || pending[i]->priority < pending[best]->priority ||
+        (pending[i]->priority == pending[best]->priority &&
+         (int32_t)(pending[i]->sequence - pending[best]->sequence) < 0)) {
+      best = i;
+    }
+  }
+  I2cRequest *request = nullptr;
+  if (best >= 0) {
+    request = pending[best];
+    pending[best] = pending[--pendingCount];
+  }
+  portEXIT_CRITICAL(&busMux);
+  return request;
+}
+
+/**
+ * Ejecuta una transacción con el reloj del dispositivo y actualiza sus
+ * estadísticas. Tras I2C_BUS_RECOVER_ERRORS errores seguidos reinicia el
+ * controlador, que libera el bus si un esclavo quedó sosteniendo SDA.
+ */
+static bool execute(I2cRequest *request) {
+  I2cDeviceStats &dev = devices[request->device];
+  if (Wire.getClock() != dev.clockHz) Wire.setClock(dev.clockHz);
+  uint32_t start = micros();
+  bool ok = request->job(request->context);
+  uint32_t busUs = micros() - start;
+  uint32_t waitUs = start - request->submitUs;
+  dev.jobs++;
+  dev.busUs += busUs;
+  if (busUs > dev.maxBusUs) dev.maxBusUs = busUs;
+  if (waitUs > dev.maxWaitUs) dev.maxWaitUs = waitUs;
+  if (ok) {
+    consecutiveErrors = 0;
+  } else {
+    dev.errors++;
+    if (++consecutiveErrors >= I2C_BUS_RECOVER_ERRORS) {
+      Wire.end();
+      Wire.begin(busSda, busScl, I2C_BUS_STANDARD_HZ);
+      consecutiveErrors = 0;
+      recoveries++;
+    }
+  }
+  return ok;
+}
+
+static void busTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    I2cRequest *request;
+    while ((request = takeNext()) != nullptr) {
+      request->result = execute(request);
+      xTaskNotifyGive(request->waiter);
+    }
+  }
+}
+
+void i2cBusBegin(int sda, int scl) {
+  busSda = sda;
+  busScl = scl;
+  Wire.begin(sda, scl, I2C_BUS_STANDARD_HZ);
+  if (!busTaskHandle) {
+    xTaskCreatePinnedToCore(busTask, "i2c", I2C_BUS_TASK_STACK, nullptr,
+                            I2C_BUS_TASK_PRIORITY, &busTaskHandle, I2C_BUS_TASK_CORE);
+  }
+}
+
+/**
+ * Pide una transacción y espera a que la tarea del bus la ejecute. Sin tarea
+ * (antes de i2cBusBegin) o desde la propia tarea del bus se ejecuta en línea.
+ */
+bool i2cBusRun(int device, I2cPriority priority, I2cJob job, void *context) {
+  if (device < 0 || device >= deviceCount) return false;
+  I2cRequest request = { job, context, (uint8_t)device, (uint8_t)priority, 0, (uint32_t)micros(),
+                         xTaskGetCurrentTaskHandle(), false };
+  if (!busTaskHandle || request.waiter == busTaskHandle) return execute(&request);
+
+  portENTER_CRITICAL(&busMux);
+  bool queued = pendingCount < I2C_BUS_QUEUE;
+  if (queued) {
+    request.sequence = nextSequence++;
+    pending[pendingCount++] = &request;
+  }
+  portEXIT_CRITICAL(&busMux);
+  if (!queued) return false;
+  xTaskNotifyGive(busTaskHandle);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  return request.result;
+}
+
+struct ProbeContext {
+  uint8_t address;
+  uint32_t hz;
+};
+
+static bool probe(void *context) {
+  ProbeContext *p = (ProbeContext *)context;
+  Wire.setClock(p->hz);
+  for (int i = 0; i < 3; i++) {
+    Wire.beginTransmission(p->address);
+    if (Wire.endTransmission(true) != 0) return false;
+  }
+  return true;
+}
+
+/**
+ * Registra un dispositivo y negocia su reloj: si responde (ACK) tres veces
+ * seguidas a maxHz se usa ese reloj; si no, I2C_BUS_STANDARD_HZ.
+ */
+int i2cBusAddDevice(const char *name, uint8_t address, uint32_t maxHz) {
+  for (int i = 0; i < deviceCount; i++) {
+    if (devices[i].address == address) return i;
+  }
+  if (deviceCount >= I2C_BUS_MAX_DEVICES) return -1;
+  int id = deviceCount++;
+  I2cDeviceStats &dev = devices[id];
+  dev.name = name;
+  dev.address = address;
+  dev.clockHz = I2C_BUS_STANDARD_HZ;
+  ProbeContext context = { address, maxHz };
+  if (maxHz > I2C_BUS_STANDARD_HZ && i2cBusRun(id, I2C_PRIORITY_BACKGROUND, probe, &context)) {
+    dev.clockHz = maxHz;
+  }
+  context.hz = dev.clockHz;
+  dev.present = dev.clockHz == maxHz || i2cBusRun(id, I2C_PRIORITY_BACKGROUND, probe, &context);
+  dev.jobs = dev.errors = dev.busUs = dev.maxBusUs = dev.maxWaitUs = 0;
+  Serial.printf("I2C: %s (0x%02X) %s a %lu kHz\n", name, address,
+                dev.present ? "responde" : "no responde", (unsigned long)(dev.clockHz / 1000));
+  return id;
+}
+
+uint8_t i2cBusDeviceCount() {
+  return deviceCount;
+}
+
+const I2cDeviceStats *i2cBusStats(int device) {
+  if (device < 0 || device >= deviceCount) return nullptr;
+  return &devices[device];
+}
+
+uint32_t i2cBusRecoveries() {
+  return recoveries;
+}
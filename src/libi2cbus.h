@@ -0,0 +1,84 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBI2CBUS_H
+#define LIBI2CBUS_H
+
+#include <Arduino.h>
+
+// Administrador del bus I2C compartido (CCS811 y pantalla SSD1306). Una tarea
+// es dueña de Wire y ejecuta las transacciones de los demás módulos en orden
+// de prioridad: una lectura de sensor espera como máximo a que termine la
+// transacción en curso, nunca a una cola de páginas de la pantalla. Cada
+// dispositivo se prueba a 400 kHz al registrarse y el reloj del bus se ajusta
+// al de cada dispositivo antes de cada transacción.
+
+#define I2C_BUS_STANDARD_HZ 100000  ///< Reloj para dispositivos que no responden a 400 kHz
+#define I2C_BUS_FAST_HZ 400000      ///< Reloj que se negocia si el dispositivo responde
+#define I2C_BUS_MAX_DEVICES 4       ///< Dispositivos registrables
+#define I2C_BUS_QUEUE 8             ///< Transacciones pendientes (una por tarea cliente basta)
+#define I2C_BUS_RECOVER_ERRORS 3    ///< Errores seguidos tras los que se reinicia el controlador I2C
+#define I2C_BUS_TASK_STACK 4096     ///< Pila de la tarea del bus (corre los drivers de Adafruit)
+#define I2C_BUS_TASK_PRIORITY 4     ///< Sobre la tarea de adquisición para no retrasar sus lecturas
+#define I2C_BUS_TASK_CORE 1         ///< Mismo núcleo que la tarea de adquisición
+
+/**
+ * Prioridad de una transacción (menor valor = se atiende antes).
+ */
+enum I2cPriority {
+  I2C_PRIORITY_SENSOR = 0,          ///< Lecturas de sensores con periodo fijo
+  I2C_PRIORITY_DISPLAY = 1,         ///< Páginas de la pantalla
+  I2C_PRIORITY_BACKGROUND = 2       ///< Escaneos y diagnósticos
+};
+
+/**
+ * Transacción: corre en la tarea del bus con el reloj del dispositivo ya
+ * ajustado. Retorna false si hubo un error de bus (NACK, timeout).
+ */
+typedef bool (*I2cJob)(void *context);
+
+/**
+ * Estadísticas por dispositivo. Los tiempos están en microsegundos; la espera
+ * es desde que se pide la transacción hasta que empieza.
+ */
+struct I2cDeviceStats {
+  const char *name;                 ///< Nombre para los reportes
+  uint8_t address;                  ///< Dirección de 7 bits
+  bool present;                     ///< Respondió al registrarse
+  uint32_t clockHz;                 ///< Reloj negociado
+  uint32_t jobs;                    ///< Transacciones ejecutadas
+  uint32_t errors;                  ///< Transacciones con error de bus
+  uint32_t busUs;                   ///< Tiempo total ocupando el bus
+  uint32_t maxBusUs;                ///< Transacción más larga
+  uint32_t maxWaitUs;               ///< Mayor espera en la cola
+};
+
+void i2cBusBegin(int sda, int scl);  ///< Inicia Wire a 100 kHz y la tarea dueña del bus
+int i2cBusAddDevice(const char *name, uint8_t address, uint32_t maxHz); ///< Registra y prueba un dispositivo; retorna su id o -1
+bool i2cBusRun(int device, I2cPriority priority, I2cJob job, void *context); ///< Ejecuta job en la tarea del bus y espera su resultado
+uint8_t i2cBusDeviceCount();         ///< Dispositivos registrados
+const I2cDeviceStats *i2cBusStats(int device); ///< Estadísticas del dispositivo (nullptr si el id no existe)
+uint32_t i2cBusRecoveries();         ///< Veces que se reinició el controlador por errores seguidos
+
+#endif /* LIBI2CBUS_H */
@@ -26,178 +26,326 @@
 #include <Wire.h>
 #include "Adafruit_CCS811.h"
 #include <libota.h>
+#include <libdisplay.h>
+#include <libi2cbus.h>
 #include <libstorage.h>
+#include <libtelemetry.h>
+#include <libbatch.h>
+#include <libspool.h>
+#include <libreconnect.h>
+#include <libspsc.h>
+#include <libpms7003.h>
+#include <libaggregate.h>
+#include <libdeadband.h>
+#include <libdutycycle.h>
+#include <libdispatch.h>
+#include <libtopics.h>
+#include <liblog.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
 
 // Versión del firmware (debe coincidir con main.cpp)
 #ifndef FIRMWARE_VERSION
 #define FIRMWARE_VERSION "v1.1.1"
 #endif
 
-//#define PRINT
-#ifdef PRINT
-#define PRINTD(x, y) Serial.println(x, y)
-#define PRINTLN(x) Serial.println(x)
-#define PRINT(x) Serial.print(x)
-#else
-#define PRINTD(x, y)
-#define PRINTLN(x)
-#define PRINT(x)
-#endif
 
 Adafruit_CCS811 ccs;     //Sensor CCS811
 String alert = ""; //Mensaje de alerta
-extern const char * client_id;  //ID del cliente MQTT
 
 // Pines I2C para CCS811
 #define SDA_PIN 8
 #define SCL_PIN 7
 
-// Buffer para lectura del PMS7003
-uint8_t pmsBuffer[32];
+// Parser de tramas del PMS7003, alimentado desde el callback de la UART
+static Pms7003Parser pmsParser;
+static portMUX_TYPE pmsMux = portMUX_INITIALIZER_UNLOCKED;
 
 // Variable para rastrear si el CCS811 está inicializado correctamente
 bool ccs811_initialized = false;
+static int ccs811Device = -1;              // Id del CCS811 en el administrador del bus I2C
+static bool ccs811_detected = false;       // ccs.begin() respondió; falta el calentamiento
+static unsigned long ccs811WarmupStart = 0;
+
+// Muestras de la tarea de adquisición hacia la tarea de red (loop())
+static SpscRing<TimedSample, SAMPLE_QUEUE_CAPACITY> sampleQueue;
+static TaskHandle_t sensorTaskHandle = nullptr;
+static volatile uint32_t sensorMaxLateMs = 0;  // Peor retraso de un ciclo respecto al periodo
+
+// Codificación con la que se publican las muestras
+static TelemetryFormat telemetryFormat = TELEMETRY_FORMAT;
+
+// Ventana de agregación en curso
+static uint32_t aggregateWindow = AGGREGATE_WINDOW_SECONDS;
+static AggWindow aggregate;
+
+// Envío por excepción
+static bool deadbandEnabled = DEADBAND_ENABLED;
+static Deadband deadband;
+static uint32_t deadbandSuppressed = 0;    // Muestras sin canales por reportar
+static uint32_t deadbandReported = 0;      // Mensajes parciales publicados
+
+// Modo de bajo consumo: sobrevive al deep sleep, se borra al cortar la energía
+RTC_DATA_ATTR static DutyCycleState dutyState;
 
 
 /**
- * Consulta y guarda el tiempo actual con servidores SNTP.
+ * Lanza la sincronización con los servidores SNTP sin esperar el resultado.
+ * lwIP reintenta por su cuenta; timeSynced() indica cuándo hay hora válida.
  */
-time_t setTime() {
-  //Sincroniza la hora del dispositivo con el servidor SNTP (Simple Network Time Protocol)
-  Serial.print("Ajustando el tiempo usando SNTP");
+void startTimeSync() {
+  Serial.println("Ajustando el tiempo usando SNTP");
   configTime(-5 * 3600, 0, "pool.ntp.org", "time.nist.gov"); //Configura la zona horaria y los servidores SNTP
+}
+
+/**
+ * Retorna true cuando el reloj ya fue ajustado por SNTP (posterior a noviembre de 2023).
+ * La primera vez imprime la hora obtenida.
+ */
+bool timeSynced() {
+  static bool synced = false;
+  if (synced) return true;
   now = time(nullptr);              //Obtiene la hora actual
-  while (now < 1700000000) {        //Espera a que el tiempo sea mayor a 1700000000 (1 de enero de 2024)
-    delay(500);                     //Espera 500ms antes de volver a intentar obtener la hora
-    Serial.print(".");
-    now = time(nullptr);            //Obtiene la hora actual
-  }
-  Serial.println(" hecho!");
+  if (now < TIME_VALID_EPOCH) return false;
+  synced = true;
   struct tm timeinfo;               //Estructura que almacena la información de la hora
   gmtime_r(&now, &timeinfo);        //Obtiene la hora actual
   Serial.print("Tiempo actual: ");  //Una vez obtiene la hora, imprime en el monitor el tiempo actual
   Serial.print(asctime(&timeinfo));
-  return now;
+  return true;
 }
 
 // Variable para debugging periódico
 static unsigned long lastMQTTDebug = 0;
 static const unsigned long MQTT_DEBUG_INTERVAL = 30000; // 30 segundos
 
+static Reconnect mqttReconnect;            // Máquina de reconexión, se inicia en setupIoT()
+static unsigned long mqttMaxStepUs = 0;    // Peor duración de un paso mientras no hay conexión
+
+/**
+ * Publica una sola vez, como mensaje retenido, el perfil de arranque junto con
+ * la versión de firmware y la causa del último reinicio.
+ */
+static void publishStartupReport() {
+  static bool reported = false;
+  if (reported) return;
+  reported = true;
+  profilerEvent("mqtt_ready");
+  static char report[PROFILER_REPORT_MAX + 64];
+  int n = snprintf(report, sizeof(report), "{\"fw\":\"%s\",\"reset\":%d,\"profile\":",
+                   getFirmwareVersion().c_str(), (int)esp_reset_reason());
+  size_t len = n > 0 && (size_t)n < sizeof(report) - 1 ? n : 0;
+  size_t plen = len ? profilerReportJson(report + len, sizeof(report) - len - 1) : 0;
+  if (plen == 0) {
+    LOG_E(LOG_MQTT, "Reporte de arranque demasiado grande");
+    return;
+  }
+  len += plen;
+  report[len++] = '}';
+  report[len] = '\0';
+  if (client.publish(getTopic(TOPIC_PUB_BOOT), (const uint8_t *)report, len, true)) {
+    LOG_I(LOG_MQTT, "Reporte de arranque publicado (%u bytes)", (unsigned)len);
+  } else {
+    LOG_E(LOG_MQTT, "No se pudo publicar el reporte de arranque");
+  }
+}
+
+static uint32_t mqttNow() {
+  return millis();
+}
+
+static bool mqttConnected() {
+  return client.connected();
+}
+
+static bool wifiLinkUp() {
+  return WiFi.status() == WL_CONNECTED;
+}
+
+/**
+ * Intenta abrir la sesión con el bróker. Si las credenciales son rechazadas no
+ * tiene sentido reintentar: el dispositivo se duerme hasta que lo reconfiguren.
+ */
+static bool mqttConnect() {
+  LOG_I(LOG_MQTT, "Conectando a %s:%d como %s", mqtt_server, mqtt_port, getDeviceId());
+  if (client.connect(getDeviceId(), mqtt_user, mqtt_password)) { //Intenta conectarse al servidor MQTT
+    LOG_I(LOG_MQTT, "Conectado");
+    // CRÍTICO: Reconfigurar el callback después de reconectar
+    client.setCallback(receivedCallback);
+    return true;
+  }
+  int state = client.state();
+  LOG_E(LOG_MQTT, "Conexión fallida, código de error %d", state);
+  alert = "MQTT error: " + String(state);
+  if (state == MQTT_CONNECT_UNAUTHORIZED) {
+    logFlush(LOG_FLUSH_TIMEOUT_MS);
+    ESP.deepSleep(0);
+  }
+  return false;
+}
+
+static void mqttSubscribe() {
+  // Se suscribe al tópico de suscripción con QoS 1
+  if (client.subscribe(getTopic(TOPIC_SUB), 1)) {
+    LOG_I(LOG_MQTT, "Suscrito a %s", getTopic(TOPIC_SUB));
+  } else {
+    LOG_E(LOG_MQTT, "Error al suscribirse a %s", getTopic(TOPIC_SUB));
+  }
+}
+
+static void mqttOnReady() {
+  setupOTA(client); //Configura la funcionalidad OTA
+  LOG_I(LOG_MQTT, "Listo para recibir mensajes (firmware %s)", getFirmwareVersion().c_str());
+  publishStartupReport();
+}
+
+static void mqttOnRetry(uint32_t waitMs, uint32_t attempt) {
+  LOG_I(LOG_MQTT, "Siguiente intento en %lu ms (intento %lu)", (unsigned long)waitMs, (unsigned long)attempt);
+}
+
+static const ReconnectOps mqttOps = {
+  mqttNow, mqttConnected, wifiLinkUp, timeSynced, mqttConnect, mqttSubscribe, mqttOnReady, mqttOnRetry
+};
+
+/**
+ * Avanza un paso la máquina de reconexión con el bróker MQTT (ver libreconnect.h).
+ * El único paso que puede tardar es client.connect() (conexión TCP y handshake
+ * TLS), acotado por MQTT_CONNECT_TIMEOUT_S.
+ */
+void reconnect() {
+  if (mqttReconnect.state == RECONNECT_READY && !client.connected()) {
+    LOG_W(LOG_MQTT, "Conexión perdida");
+  }
+  reconnectStep(&mqttReconnect, esp_random());
+}
+
 /**
- * Conecta el dispositivo con el bróker MQTT usando
- * las credenciales establecidas.
- * Si ocurre un error lo imprime en la consola.
+ * Atiende la conexión con el bróker MQTT sin bloquear: avanza un paso la
+ * reconexión si hace falta y procesa los mensajes entrantes.
  */
 void checkMQTT() {
-  if (!client.connected()) {
+  if (!reconnectReady(&mqttReconnect)) {
+    unsigned long start = micros();
     reconnect();
+    unsigned long elapsed = micros() - start;
+    if (elapsed > mqttMaxStepUs) mqttMaxStepUs = elapsed;
   }
   // Procesa mensajes MQTT entrantes (esto es crítico para recibir mensajes)
   // IMPORTANTE: client.loop() debe llamarse frecuentemente para recibir mensajes
-  bool loopResult = client.loop();
-  if (!loopResult && client.connected()) {
-    // Si loop() retorna false pero estamos conectados, podría haber un problema
-    Serial.println("⚠ client.loop() retornó false (podría indicar problema de conexión)");
+  if (client.connected()) {
+    client.loop();
   }
   
-  // Debug periódico cada 30 segundos
+  // Healthcheck periódico cada 30 segundos; sin el nivel activo no se leen las estadísticas
   unsigned long now = millis();
-  if (now - lastMQTTDebug > MQTT_DEBUG_INTERVAL) {
-    lastMQTTDebug = now;
-    Serial.println("=== Healthcheck MQTT (cada 30s) ===");
-    Serial.print("Conectado: ");
-    Serial.println(client.connected() ? "✅UP" : "❌DOWN");
+  if (now - lastMQTTDebug <= MQTT_DEBUG_INTERVAL) return;
+  lastMQTTDebug = now;
+  if (!LOG_ENABLED(LOG_HEALTH, LOG_LEVEL_INFO)) return;
+  LOG_I(LOG_HEALTH, "MQTT %s, peor paso de reconexión %lu us", client.connected() ? "UP" : "DOWN", mqttMaxStepUs);
+  LOG_I(LOG_HEALTH, "Cola de muestras: %lu en cola, máx %lu, %lu descartadas; peor retraso de medición %lu ms",
+        (unsigned long)sampleQueue.size(), (unsigned long)sampleQueue.highWater(),
+        (unsigned long)sampleQueue.overruns(), (unsigned long)sensorMaxLateMs);
+  if (deadbandEnabled) {
+    LOG_I(LOG_HEALTH, "Envío por excepción: %lu mensajes, %lu muestras sin cambios",
+          (unsigned long)deadbandReported, (unsigned long)deadbandSuppressed);
+  }
+  Pms7003Stats pms = getPMS7003Stats();
+  LOG_I(LOG_HEALTH, "PMS7003: %lu tramas, %lu errores de suma, %lu de longitud, %lu resincronizaciones, %lu desbordes",
+        (unsigned long)pms.frames, (unsigned long)pms.checksumErrors, (unsigned long)pms.lengthErrors,
+        (unsigned long)pms.resyncs, (unsigned long)pms.overruns);
+  const DispatchStats &dispatch = dispatchGetStats();
+  LOG_I(LOG_HEALTH, "Mensajes recibidos: %lu despachados, %lu sin handler",
+        (unsigned long)dispatch.messages, (unsigned long)dispatch.unmatched);
+  const TlsStats &tls = espClient.getStats();
+  LOG_I(LOG_HEALTH, "Handshakes TLS: %lu completos, %lu reanudados, %lu fallidos (último %lu ms)",
+        (unsigned long)tls.full, (unsigned long)tls.resumed,
+        (unsigned long)tls.failed, (unsigned long)tls.lastHandshakeMs);
+  for (int d = 0; d < i2cBusDeviceCount(); d++) {
+    const I2cDeviceStats *bus = i2cBusStats(d);
+    LOG_I(LOG_HEALTH, "I2C %s @%lu kHz: %lu transacciones, %lu errores, bus %lu ms (peor %lu us), espera máx %lu us",
+          bus->name, (unsigned long)(bus->clockHz / 1000), (unsigned long)bus->jobs,
+          (unsigned long)bus->errors, (unsigned long)(bus->busUs / 1000),
+          (unsigned long)bus->maxBusUs, (unsigned long)bus->maxWaitUs);
   }
+  const DisplayStats &lcd = getDisplayStats();
+  LOG_I(LOG_HEALTH, "Pantalla: %lu refrescos, %lu sin cambios, %lu aplazados, %lu bytes, bus %lu ms (último %lu us, peor %lu us)",
+        (unsigned long)lcd.refreshes, (unsigned long)lcd.unchanged, (unsigned long)lcd.rateLimited,
+        (unsigned long)lcd.bytes, (unsigned long)(lcd.busUs / 1000), (unsigned long)lcd.lastBusUs,
+        (unsigned long)lcd.maxBusUs);
+  LogStats log = logGetStats();
+  LOG_I(LOG_HEALTH, "Log: %lu líneas, %lu descartadas, ocupación máx %lu de %u bytes",
+        (unsigned long)log.lines, (unsigned long)log.dropped, (unsigned long)log.highWater,
+        (unsigned)LOG_BUFFER_SIZE);
 }
 
 /**
- * Adquiere la dirección MAC del dispositivo y la retorna en formato de cadena.
+ * Retorna true si la conexión MQTT está lista para publicar (conectado y suscrito).
  */
-String getMacAddress() {
-  uint8_t mac[6];
-  char macStr[18];
-  WiFi.macAddress(mac);
-  snprintf(macStr, sizeof(macStr), "ESP32-%02X%02X%02X%02X%02X%02X", 
-           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-  return String(macStr);
+bool mqttReady() {
+  return reconnectReady(&mqttReconnect);
 }
 
-
 /**
- * Función que se ejecuta cuando se establece conexión con el servidor MQTT
+ * Busca el texto needle dentro de un payload sin terminador.
  */
-void reconnect() {
-  while (!client.connected()) { //Mientras no esté conectado al servidor MQTT
-    Serial.println("=== Intentando conectar a MQTT ===");
-    Serial.print("Servidor: ");
-    Serial.println(mqtt_server);
-    Serial.print("Puerto: ");
-    Serial.println(mqtt_port);
-    Serial.print("Usuario: ");
-    Serial.println(mqtt_user);
-    Serial.print("Client ID: ");
-    Serial.println(client_id);
-    Serial.print("Conectando...");
-    if (client.connect(client_id, mqtt_user, mqtt_password)) { //Intenta conectarse al servidor MQTT
-      Serial.println(" ✓ CONECTADO");
-      
-      // CRÍTICO: Reconfigurar el callback después de reconectar
-      client.setCallback(receivedCallback);
-      Serial.println("✓ Callback reconfigurado después de reconexión");
-      
-      // Imprimir versión del firmware al conectar (usar versión guardada)
-      String firmwareVersion = getFirmwareVersion();
-      Serial.print("Firmware: ");
-      Serial.println(firmwareVersion);
-      
-      Serial.println("=== Suscripciones MQTT ===");
-      // Se suscribe al tópico de suscripción con QoS 1
-      bool subResult = client.subscribe(MQTT_TOPIC_SUB, 1);
-      if (subResult) {
-        Serial.println("✓ Suscrito exitosamente a " + String(MQTT_TOPIC_SUB));
-      } else {
-        Serial.println("✗ Error al suscribirse a " + String(MQTT_TOPIC_SUB));
-      }
-      
-      // Procesar mensajes para confirmar suscripciones
-      client.loop();
-      delay(100); // Dar tiempo para procesar
-      
-      setupOTA(client); //Configura la funcionalidad OTA
-      
-      // Procesar mensajes nuevamente después de suscribirse a OTA
-      client.loop();
-      delay(100);
-      
-      Serial.println("==========================");
-      Serial.println("Listo para recibir mensajes MQTT");
-    } else {
-      Serial.println(" ✗ FALLÓ");
-      Serial.println("Problema con la conexión, revise los valores de las constantes MQTT");
-      int state = client.state();
-      Serial.print("Código de error = ");
-      alert = "MQTT error: " + String(state);
-      Serial.println(state);
-      if ( client.state() == MQTT_CONNECT_UNAUTHORIZED ) ESP.deepSleep(0);
-      delay(5000); // Espera 5 segundos antes de volver a intentar
-    }
+static bool payloadContains(const uint8_t * payload, size_t length, const char * needle) {
+  size_t n = strlen(needle);
+  for (size_t i = 0; i + n <= length; i++) {
+    if (memcmp(payload + i, needle, n) == 0) return true;
   }
+  return false;
 }
 
+/**
+ * Handler del tópico de suscripción: una configuración {"deadband":{...}} o
+ * un mensaje que contiene ALERT, que se asigna a la variable alert que es la
+ * que se lee para mostrar los mensajes. Solo las alertas se copian.
+ */
+static void commandHandler(const char * topic, uint8_t * payload, size_t length) {
+  // Configuración del envío por excepción
+  if (length > 0 && payload[0] == '{') {
+    if (applyDeadbandConfig((const char *)payload, length)) return;
+    // Niveles de registro por módulo
+    if (applyLogConfig((const char *)payload, length)) return;
+  }
+  // Verifica si el mensaje contiene una alerta
+  if (payloadContains(payload, length, "ALERT")) {
+    alert = "";
+    alert.concat((const char *)payload, length);
+    LOG_I(LOG_MQTT, "Alerta recibida");
+  } else {
+    LOG_W(LOG_MQTT, "Mensaje no reconocido en %s (%u bytes)", topic, (unsigned)length);
+  }
+}
 
 /**
- * Función setupIoT que configura el certificado raíz, el servidor MQTT y el puerto
+ * Función setupIoT que arma los tópicos y configura el certificado raíz, el servidor MQTT y el puerto
  */
 void setupIoT() {
+  reconnectInit(&mqttReconnect, &mqttOps, MQTT_BACKOFF_BASE_MS, MQTT_BACKOFF_MAX_MS);
+  // ID y tópicos del dispositivo: se arman una vez en buffers estáticos (ver libtopics.h)
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  if (!topicsBegin(topic_location, mqtt_user, mac)) {
+    Serial.printf("⚠ Algún tópico supera %d caracteres y quedó truncado\n", TOPIC_MAX_LENGTH - 1);
+  }
+  aggReset(&aggregate);
+  DeadbandConfig deadbandConfig;
+  if (!loadDeadbandConfig(deadbandConfig, deadbandEnabled)) {
+    deadbandDefaults(&deadbandConfig);
+  }
+  deadbandInit(&deadband, &deadbandConfig);
   // I2C se inicializa en setupSensors() con los pines específicos
   espClient.setCACert(root_ca); //Configura el certificado raíz de la autoridad de certificación
+  espClient.setHandshakeTimeout(MQTT_CONNECT_TIMEOUT_S); //Acota el tiempo que puede bloquear un intento de conexión
   client.setServer(mqtt_server, mqtt_port);   //Configura el servidor MQTT y el puerto seguro
   
   // Configurar buffer más grande para mensajes grandes (por defecto es 256 bytes)
-  client.setBufferSize(1024);
+  // Debe alcanzar para un lote completo de muestras más el tópico y la cabecera MQTT
+  client.setBufferSize(MQTT_BUFFER_SIZE);
   
   client.setCallback(receivedCallback);       //Configura la función que se ejecutará cuando lleguen mensajes a la suscripción
+  dispatchRegister(getTopic(TOPIC_SUB), commandHandler); //El handler de OTA_TOPIC lo registra setupOTA()
   Serial.println("=== Configuración MQTT ===");
   Serial.print("Servidor MQTT: ");
   Serial.println(mqtt_server);
@@ -206,27 +354,29 @@ void setupIoT() {
   Serial.print("Usuario MQTT: ");
   Serial.println(mqtt_user);
   Serial.print("Client ID: ");
-  Serial.println(client_id);
+  Serial.println(getDeviceId());
   Serial.print("Buffer size: ");
   Serial.println(client.getBufferSize());
   Serial.println("Callback MQTT configurado: receivedCallback");
   Serial.println("==========================");
-  setTime();                    //Ajusta el tiempo del dispositivo con servidores SNTP
-  setupSensors();               //Configura los sensores CCS811 y PMS7003
+  // Cola persistente para las muestras que no se puedan enviar por falta de conexión
+  profilerBegin("storage");
+  bool spoolReady = LittleFS.begin(true) && spoolBegin(SPOOL_PATH);
+  profilerEnd();
+  if (spoolReady) {
+    Serial.printf("Cola offline lista: %u segmentos pendientes\n", (unsigned)spoolSegments());
+  } else {
+    Serial.println("⚠ No se pudo montar LittleFS: las muestras sin conexión se perderán");
+  }
+  // SNTP y sensores los lanza el orquestador de arranque (main.cpp) en paralelo con el WiFi
 }
 
 
-/**
- * Escanea el bus I2C y muestra los dispositivos encontrados
- */
-void scanI2C() {
+static bool scanJob(void *) {
   Serial.println("\n=== Escaneo I2C ===");
   byte error, address;
   int nDevices = 0;
 
-  // Limpiar cualquier error previo del bus
-  Wire.clearWriteError();
-  
   for(address = 1; address < 127; address++ ) {
     // Usar endTransmission con true para liberar el bus
     Wire.beginTransmission(address);
@@ -254,9 +404,6 @@ void scanI2C() {
     }
   }
   
-  // Limpiar errores al finalizar el escaneo
-  Wire.clearWriteError();
-  
   if (nDevices == 0) {
     Serial.println("No se encontraron dispositivos I2C");
     Serial.println("Verifica las conexiones I2C");
@@ -265,6 +412,78 @@ void scanI2C() {
     Serial.println(nDevices);
   }
   Serial.println("==================\n");
+  return true;
+}
+
+/**
+ * Escanea el bus I2C y muestra los dispositivos encontrados.
+ * Corre como transacción de baja prioridad en la tarea del bus.
+ */
+void scanI2C() {
+  i2cBusRun(ccs811Device, I2C_PRIORITY_BACKGROUND, scanJob, nullptr);
+}
+
+/**
+ * Callback de la UART del PMS7003 (tarea de eventos de la UART): pasa los bytes
+ * recibidos al parser incremental, que valida cada trama al completarse.
+ */
+static void onPMS7003Receive() {
+  uint8_t chunk[PMS7003_FRAME_SIZE];
+  size_t n;
+  while ((n = Serial2.read(chunk, sizeof(chunk))) > 0) {
+    portENTER_CRITICAL(&pmsMux);
+    pmsParserFeed(&pmsParser, chunk, n);
+    portEXIT_CRITICAL(&pmsMux);
+  }
+}
+
+static void onPMS7003Error(hardwareSerial_error_t error) {
+  if (error == UART_BUFFER_FULL_ERROR || error == UART_FIFO_OVF_ERROR) {
+    portENTER_CRITICAL(&pmsMux);
+    pmsParser.stats.overruns++;
+    portEXIT_CRITICAL(&pmsMux);
+  }
+}
+
+/**
+ * Retorna la última trama válida del PMS7003 si llegó una nueva desde la
+ * lectura anterior. No bloquea ni toca la UART.
+ */
+bool readPMS7003(PMS7003Data * data) {
+  portENTER_CRITICAL(&pmsMux);
+  bool fresh = pmsParserTake(&pmsParser, data);
+  portEXIT_CRITICAL(&pmsMux);
+  return fresh;
+}
+
+Pms7003Stats getPMS7003Stats() {
+  portENTER_CRITICAL(&pmsMux);
+  Pms7003Stats stats = pmsParser.stats;
+  portEXIT_CRITICAL(&pmsMux);
+  return stats;
+}
+
+// Transacciones del CCS811 (corren en la tarea del bus I2C, ver libi2cbus.h)
+static bool ccs811BeginJob(void *) {
+  if (!ccs.begin(CCS811_ADDRESS)) return false;
+  ccs.setDriveMode(CCS811_DRIVE_MODE_1SEC);
+  return true;
+}
+
+/**
+ * Lee CO2 y TVOC si el sensor tiene un dato nuevo. Retorna false solo ante un
+ * error de lectura; que no haya dato nuevo no es un error del bus.
+ */
+static bool ccs811ReadJob(void *context) {
+  SensorData *data = (SensorData *)context;
+  if (!ccs.available()) return true;
+  if (ccs.readData() != 0) return false;
+  data->co2 = ccs.geteCO2();
+  data->tvoc = ccs.getTVOC();
+  if (data->co2 != 0xFFFF && data->tvoc != 0xFFFF && data->co2 > 0) {
+    data->ccs811_valido = true;
+  }
+  return true;
 }
 
 /**
@@ -277,175 +496,131 @@ void setupSensors() {
   Serial.print(", SCL: ");
   Serial.println(SCL_PIN);
   
-  // I2C ya debería estar inicializado en main.cpp antes de startDisplay()
-  // Solo configurar el clock si es necesario (evitar re-inicializar)
-  Wire.setClock(100000);
-  delay(200); // Dar más tiempo para estabilización
+  // El bus lo inicia i2cBusBegin() en main.cpp; aquí se registra el CCS811 y
+  // se negocia su reloj (admite 400 kHz con clock stretching)
+  ccs811Device = i2cBusAddDevice("ccs811", CCS811_ADDRESS, I2C_BUS_FAST_HZ);
 
   // Escanear bus I2C para diagnóstico
+  profilerBegin("i2c_scan");
   scanI2C();
+  profilerEnd();
 
   Serial.println("Intentando inicializar CCS811...");
   ccs811_initialized = false;
+  ccs811_detected = false;
+  profilerBegin("ccs811");
   
   // Intentar inicializar el CCS811 con manejo de errores
-  if (!ccs.begin()) {
+  if (!i2cBusRun(ccs811Device, I2C_PRIORITY_SENSOR, ccs811BeginJob, nullptr)) {
     Serial.println("ERROR: CCS811 no detectado");
     Serial.println("Verifica:");
     Serial.println("  1. Conexiones I2C (SDA y SCL)");
     Serial.println("  2. Alimentación del sensor");
     Serial.println("  3. Dirección I2C del sensor (0x5A o 0x5B)");
     Serial.println("Continuando sin CCS811...");
-    ccs811_initialized = false;
   } else {
     Serial.println("CCS811 init(): Exitoso");
-    ccs.setDriveMode(CCS811_DRIVE_MODE_1SEC);
-    delay(2000); // Esperar a que el sensor se estabilice
-    ccs811_initialized = true;
+    ccs811WarmupStart = millis(); // El sensor se estabiliza mientras avanza el resto del arranque
+    ccs811_detected = true;
   }
+  profilerEnd();
 
   // Inicializar Serial2 para PMS7003 (RX=17, TX=18)
   Serial.println("Inicializando PMS7003...");
+  profilerBegin("pms7003");
+  pmsParserInit(&pmsParser);
+  Serial2.onReceive(onPMS7003Receive);      // Se procesa cada bloque que llega, no cada 2 s
+  Serial2.onReceiveError(onPMS7003Error);
   Serial2.begin(9600, SERIAL_8N1, 17, 18);
-  delay(100);
+  profilerEnd();
   Serial.println("PMS7003 init(): Exitoso");
   Serial.println("=============================\n");
 }
 
-
 /**
- * Lee datos del sensor PMS7003
+ * Retorna true cuando el CCS811 terminó su calentamiento (o no está presente).
+ * Hasta entonces measure() no lo lee.
  */
-bool readPMS7003(PMS7003Data * data) {
-  if (Serial2.available() < 32) return false;
-
-  // Buscar cabecera 0x42 0x4D
-  while (Serial2.available() && Serial2.peek() != 0x42) {
-    Serial2.read();
-  }
-
-  if (Serial2.available() < 32) return false;
-
-  for (int i = 0; i < 32; i++) {
-    pmsBuffer[i] = Serial2.read();
+bool sensorsReady() {
+  if (ccs811_detected && !ccs811_initialized) {
+    if (millis() - ccs811WarmupStart < CCS811_WARMUP_MS) return false;
+    ccs811_initialized = true;
+    Serial.println("CCS811 listo");
   }
-
-  // Validar encabezado
-  if (pmsBuffer[0] != 0x42 || pmsBuffer[1] != 0x4D) return false;
-
-  // Checksum
-  uint16_t checksum = 0;
-  for (int i = 0; i < 30; i++) checksum += pmsBuffer[i];
-  uint16_t check_code = (pmsBuffer[30] << 8) | pmsBuffer[31];
-
-  if (checksum != check_code) return false;
-
-  // Parsear datos
-  data->pm1_0_cf1  = (pmsBuffer[4] << 8) | pmsBuffer[5];
-  data->pm2_5_cf1  = (pmsBuffer[6] << 8) | pmsBuffer[7];
-  data->pm10_cf1   = (pmsBuffer[8] << 8) | pmsBuffer[9];
-  data->pm1_0_atm  = (pmsBuffer[10] << 8) | pmsBuffer[11];
-  data->pm2_5_atm  = (pmsBuffer[12] << 8) | pmsBuffer[13];
-  data->pm10_atm   = (pmsBuffer[14] << 8) | pmsBuffer[15];
-  data->num_part_03 = (pmsBuffer[16] << 8) | pmsBuffer[17];
-  data->num_part_05 = (pmsBuffer[18] << 8) | pmsBuffer[19];
-  data->num_part_1  = (pmsBuffer[20] << 8) | pmsBuffer[21];
-  data->num_part_25 = (pmsBuffer[22] << 8) | pmsBuffer[23];
-  data->num_part_5  = (pmsBuffer[24] << 8) | pmsBuffer[25];
-  data->num_part_10 = (pmsBuffer[26] << 8) | pmsBuffer[27];
-
   return true;
 }
 
 /**
- * Verifica si ya es momento de hacer las mediciones de las variables.
- * si ya es tiempo, mide y envía las mediciones.
+ * Lee los sensores CCS811 y PMS7003 y registra las mediciones (nivel debug).
+ * La llama la tarea de adquisición cada MEASURE_INTERVAL segundos.
  */
 bool measure(SensorData * data) {
-  if ((millis() - measureTime) >= MEASURE_INTERVAL * 1000 ) {
-    PRINTLN("\nMidiendo variables...");
-    measureTime = millis();
-    
-    // Inicializar valores
-    data->ccs811_valido = false;
-    data->pms7003_valido = false;
-    data->co2 = 0;
-    data->tvoc = 0;
-    
-    // Leer datos del CCS811 (solo si está inicializado)
-    if (ccs811_initialized) {
-      // Limpiar cualquier error previo del bus I2C
-      Wire.clearWriteError();
-      delay(10); // Pequeño delay para estabilizar el bus
-      
-      // Verificar si hay datos disponibles antes de leer
-      if (ccs.available()) {
-        // Intentar leer datos con manejo de errores
-        uint8_t error = ccs.readData();
-        if (error == 0) {
-          // Lectura exitosa
-          data->co2 = ccs.geteCO2();
-          data->tvoc = ccs.getTVOC();
-          
-          if (data->co2 != 0xFFFF && data->tvoc != 0xFFFF && data->co2 > 0 && data->tvoc >= 0) {
-            data->ccs811_valido = true;
-          }
-        } else {
-          // Error en la lectura - limpiar el bus y continuar
-          Wire.clearWriteError();
-          delay(10);
-        }
-      }
-    } else {
-      // CCS811 no está inicializado, mantener valores en 0
-    }
-    
-    // Leer datos del PMS7003
-    if (readPMS7003(&data->pms7003)) {
-      data->pms7003_valido = true;
-    }
-    
-    // Imprimir datos organizados
-    Serial.println("\n========================================");
-    Serial.println("      LECTURA DE SENSORES");
-    Serial.println("========================================");
-    
-    // Datos del CCS811
-    Serial.println("--- CCS811 (Calidad del Aire) ---");
-    if (data->ccs811_valido) {
-      Serial.println("  Estado:  disponible");
-    } else {
-      Serial.println("  Estado: No disponible");
-    }
-    Serial.print("  CO2 : ");
-    Serial.print(data->co2);
-    Serial.println(" ppm");
-    Serial.print("  TVOC: ");
-    Serial.print(data->tvoc);
-    Serial.println(" ppb");
-    
-    // Datos del PMS7003
-    Serial.println("--- PMS7003 (Partículas) ---");
-    if (data->pms7003_valido) {
-      Serial.print("  PM1.0: ");
-      Serial.print(data->pms7003.pm1_0_atm);
-      Serial.println(" µg/m³");
-      Serial.print("  PM2.5: ");
-      Serial.print(data->pms7003.pm2_5_atm);
-      Serial.println(" µg/m³");
-      Serial.print("  PM10 : ");
-      Serial.print(data->pms7003.pm10_atm);
-      Serial.println(" µg/m³");
-    } else {
-      Serial.println("  Estado: No disponible");
+  LOG_V(LOG_SENSORS, "Midiendo variables");
+  
+  // Inicializar valores
+  data->ccs811_valido = false;
+  data->pms7003_valido = false;
+  data->co2 = 0;
+  data->tvoc = 0;
+  
+  // Leer datos del CCS811 (solo si está inicializado)
+  if (ccs811_initialized) {
+    i2cBusRun(ccs811Device, I2C_PRIORITY_SENSOR, ccs811ReadJob, data);
+  } else {
+    // CCS811 no está inicializado, mantener valores en 0
+  }
+  
+  // Leer datos del PMS7003
+  if (readPMS7003(&data->pms7003)) {
+    data->pms7003_valido = true;
+  }
+  
+  if (data->ccs811_valido) {
+    LOG_D(LOG_SENSORS, "CCS811: CO2 %u ppm, TVOC %u ppb", data->co2, data->tvoc);
+  } else {
+    LOG_D(LOG_SENSORS, "CCS811: no disponible");
+  }
+  if (data->pms7003_valido) {
+    LOG_D(LOG_SENSORS, "PMS7003: PM1.0 %u, PM2.5 %u, PM10 %u µg/m³", data->pms7003.pm1_0_atm,
+          data->pms7003.pm2_5_atm, data->pms7003.pm10_atm);
+  } else {
+    LOG_D(LOG_SENSORS, "PMS7003: no disponible");
+  }
+  
+  // Retornar true si al menos uno de los sensores tiene datos válidos
+  return (data->ccs811_valido || data->pms7003_valido);
+}
+
+/**
+ * Tarea de adquisición: mide con periodo fijo (vTaskDelayUntil), independiente
+ * de lo que tarden WiFi, TLS o el bróker, y entrega las muestras por la cola SPSC.
+ */
+static void sensorTask(void *) {
+  const TickType_t period = pdMS_TO_TICKS(MEASURE_INTERVAL * 1000);
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    vTaskDelayUntil(&lastWake, period);
+    uint32_t lateMs = (xTaskGetTickCount() - lastWake) * portTICK_PERIOD_MS;
+    if (lateMs > sensorMaxLateMs) sensorMaxLateMs = lateMs;
+    TimedSample sample;
+    sample.timestamp = (uint32_t)time(nullptr);
+    if (measure(&sample.data)) {
+      sampleQueue.push(sample);     // Si la red no consume, se cuenta el desborde y se sigue midiendo
     }
-    
-    Serial.println("========================================\n");
-    
-    // Retornar true si al menos uno de los sensores tiene datos válidos
-    return (data->ccs811_valido || data->pms7003_valido);
   }
-  return false;
+}
+
+/**
+ * Inicia la tarea de adquisición. Llamar después de setupSensors().
+ */
+void startSensorTask() {
+  if (sensorTaskHandle) return;
+  xTaskCreatePinnedToCore(sensorTask, "sensors", SENSOR_TASK_STACK, nullptr,
+                          SENSOR_TASK_PRIORITY, &sensorTaskHandle, SENSOR_TASK_CORE);
+}
+
+bool nextSample(TimedSample * sample) {
+  return sampleQueue.pop(sample);
 }
 
 /**
@@ -463,134 +638,401 @@ String checkAlert() {
   } else return "OK";
 }
 
+/**
+ * Selecciona la codificación de las muestras publicadas.
+ * JSON se publica en TOPIC_PUB y CBOR en el tópico hermano TOPIC_PUB_CBOR.
+ */
+void setTelemetryFormat(TelemetryFormat format) {
+  telemetryFormat = format;
+}
+
+TelemetryFormat getTelemetryFormat() {
+  return telemetryFormat;
+}
+
+/**
+ * Publica en TOPIC_PUB_DELTA solo los canales que se movieron más que su
+ * umbral o cuyo heartbeat venció. Si no se puede publicar retorna false y la
+ * muestra sigue el camino normal (lote o cola offline); los canales quedan
+ * pendientes para la siguiente muestra.
+ */
+bool reportByException(const TimedSample * sample) {
+  if (!deadbandEnabled) return false;
+  uint16_t mask = deadbandCheck(&deadband, sample->timestamp, &sample->data);
+  if (mask == 0) {
+    deadbandSuppressed++;
+    deadbandCommit(&deadband, sample->timestamp, &sample->data, 0);
+    return true;
+  }
+  if (!client.connected()) return false;
+  static char payload[DEADBAND_JSON_MAX];
+  size_t len = deadbandEncodeJson(sample->timestamp, &sample->data, mask, payload, sizeof(payload));
+  if (len == 0 || !client.publish(getTopic(TOPIC_PUB_DELTA), (const uint8_t *)payload, len)) return false;
+  deadbandCommit(&deadband, sample->timestamp, &sample->data, mask);
+  deadbandReported++;
+  return true;
+}
+
+/**
+ * Configuración recibida por MQTT, p. ej.:
+ * {"deadband":{"enabled":true,"heartbeat":900,"co2":[25,50],"pm2_5":[2,100]}}
+ * Cada canal lleva [umbral absoluto, umbral relativo en milésimas]; los canales
+ * omitidos conservan su valor. Se guarda en NVS para el próximo arranque.
+ */
+bool applyDeadbandConfig(const char * json, size_t length) {
+  StaticJsonDocument<768> doc;
+  if (deserializeJson(doc, json, length)) return false;
+  JsonObject cfg = doc["deadband"];
+  if (cfg.isNull()) return false;
+  DeadbandConfig config = deadband.config;
+  bool enabled = deadbandEnabled;
+  if (cfg.containsKey("enabled")) enabled = cfg["enabled"].as<bool>();
+  if (cfg.containsKey("heartbeat")) config.heartbeatS = cfg["heartbeat"].as<uint32_t>();
+  for (int c = 0; c < SENSOR_CHANNELS; c++) {
+    JsonArray th = cfg[sensorChannelName(c)];
+    if (th.isNull() || th.size() != 2) continue;
+    config.absolute[c] = th[0].as<uint16_t>();
+    config.relative[c] = th[1].as<uint16_t>();
+  }
+  deadbandEnabled = enabled;
+  deadbandInit(&deadband, &config);         // Tras un cambio se reportan todos los canales
+  saveDeadbandConfig(config, enabled);
+  LOG_I(LOG_MQTT, "Envío por excepción %s (heartbeat %lu s)", enabled ? "activado" : "desactivado",
+        (unsigned long)config.heartbeatS);
+  return true;
+}
+
+/**
+ * Aplica niveles de registro recibidos por MQTT, por módulo o para todos:
+ * {"log":{"mqtt":"debug","publish":"warn"}} o {"log":{"*":"error"}}.
+ * Solo duran hasta el próximo reinicio.
+ */
+bool applyLogConfig(const char * json, size_t length) {
+  StaticJsonDocument<256> doc;
+  if (deserializeJson(doc, json, length)) return false;
+  JsonObject cfg = doc["log"];
+  if (cfg.isNull()) return false;
+  for (JsonPair kv : cfg) {
+    const char * level = kv.value() | "";
+    if (logSetLevel(kv.key().c_str(), level)) {
+      LOG_I(LOG_MQTT, "Nivel de registro de %s: %s", kv.key().c_str(), level);
+    } else {
+      LOG_W(LOG_MQTT, "Nivel de registro inválido: %s=%s", kv.key().c_str(), level);
+    }
+  }
+  return true;
+}
+
+void setAggregateWindow(uint32_t seconds) {
+  aggregateWindow = seconds;
+  aggReset(&aggregate);
+}
+
+uint32_t getAggregateWindow() {
+  return aggregateWindow;
+}
+
+/**
+ * Agrega la muestra a la ventana en curso y, cuando la ventana cumple
+ * aggregateWindow segundos, publica su resumen en TOPIC_PUB_SUMMARY.
+ * Sin conexión la ventana sigue abierta y se publica más larga al reconectar.
+ */
+bool aggregateSample(const TimedSample * sample) {
+  if (aggregateWindow == 0) return false;
+  aggAdd(&aggregate, sample->timestamp, &sample->data);
+  if (aggregate.endTs - aggregate.startTs < aggregateWindow || !client.connected()) return true;
+  static char payload[AGG_JSON_MAX];
+  size_t len = aggEncodeJson(&aggregate, payload, sizeof(payload));
+  if (len > 0 && client.publish(getTopic(TOPIC_PUB_SUMMARY), (const uint8_t *)payload, len)) {
+    aggReset(&aggregate);
+  }
+  return true;
+}
+
 /**
  * Publica los datos de los sensores al tópico configurado usando el cliente MQTT.
  */
-void sendSensorData(SensorData * data) {
-  // Verificar que el cliente MQTT esté conectado antes de publicar
+bool sendSensorData(const SensorData * data) {
+  // Verificar que el cliente MQTT esté conectado antes de publicar.
+  // La reconexión la atiende checkMQTT(); aquí no se bloquea esperándola.
   if (!client.connected()) {
-    Serial.println("⚠ ERROR: Cliente MQTT no conectado. No se puede publicar.");
-    Serial.println("Intentando reconectar...");
-    reconnect();
-    // Si aún no está conectado después de intentar reconectar, salir
-    if (!client.connected()) {
-      Serial.println("✗ No se pudo reconectar. Datos no enviados.");
-      return;
-    }
+    LOG_W(LOG_PUBLISH, "Cliente MQTT no conectado, muestra pendiente de envío");
+    return false;
   }
   
-  String json = "{";
-  
-  // Datos del CCS811
-  if (data->ccs811_valido) {
-    json += "\"co2\": " + String(data->co2) + ", ";
-    json += "\"tvoc\": " + String(data->tvoc) + ", ";
+  // Codificar directamente en un buffer estático: sin String, sin heap y sin segunda copia
+  static uint8_t payload[TELEMETRY_JSON_MAX];
+  const char * topic;
+  size_t length;
+  if (telemetryFormat == TELEMETRY_FORMAT_CBOR) {
+    topic = getTopic(TOPIC_PUB_CBOR);
+    length = encodeSensorDataCbor(data, payload, sizeof(payload));
   } else {
-    json += "\"co2\": 0, ";
-    json += "\"tvoc\": 0, ";
+    topic = getTopic(TOPIC_PUB);
+    length = encodeSensorDataJson(data, (char *)payload, sizeof(payload));
   }
-  
-  // Datos del PMS7003
-  if (data->pms7003_valido) {
-    json += "\"pm1_0\": " + String(data->pms7003.pm1_0_atm) + ", ";
-    json += "\"pm2_5\": " + String(data->pms7003.pm2_5_atm) + ", ";
-    json += "\"pm10\": " + String(data->pms7003.pm10_atm);
-  } else {
-    json += "\"pm1_0\": 0, ";
-    json += "\"pm2_5\": 0, ";
-    json += "\"pm10\": 0";
+  if (length == 0) {
+    LOG_E(LOG_PUBLISH, "El payload no cabe en el buffer de telemetría");
+    return false;
   }
-  
-  json += "}";
-  char payload[json.length()+1];
-  json.toCharArray(payload, json.length()+1);
-  
-  Serial.println("\n=== Publicando datos MQTT ===");
-  Serial.print("Client ID: ");
-  Serial.println(client_id);
-  Serial.print("Topic: ");
-  Serial.println(MQTT_TOPIC_PUB);
-  Serial.print("Payload: ");
-  Serial.println(json);
+  const TelemetryStats & stats = getTelemetryStats();
   
   // Publicar con QoS 1 para garantizar entrega
-  bool publishResult = client.publish(MQTT_TOPIC_PUB, payload, false);
+  bool publishResult = client.publish(topic, payload, length, false);
   
   if (publishResult) {
-    Serial.println("✓ Mensaje publicado exitosamente");
+    LOG_D(LOG_PUBLISH, "Publicado en %s: %u bytes, %u ciclos (%u us)", topic,
+          (unsigned)stats.lastBytes, (unsigned)stats.lastCycles, (unsigned)stats.lastMicros);
+    if (LOG_ENABLED(LOG_PUBLISH, LOG_LEVEL_VERBOSE)) {
+      if (telemetryFormat == TELEMETRY_FORMAT_CBOR) {
+        logHex(LOG_PUBLISH, LOG_LEVEL_VERBOSE, "Payload: ", payload, length);
+      } else {
+        LOG_V(LOG_PUBLISH, "Payload: %.*s", (int)length, (const char *)payload);
+      }
+    }
     // Procesar mensajes para asegurar que se envíe
     client.loop();
   } else {
-    Serial.println("✗ ERROR: Fallo al publicar mensaje MQTT");
-    Serial.print("Estado del cliente: ");
-    Serial.println(client.state());
-    Serial.println("Verificando conexión...");
-    if (!client.connected()) {
-      Serial.println("Cliente desconectado. Intentando reconectar...");
-      reconnect();
-    }
+    LOG_E(LOG_PUBLISH, "Fallo al publicar en %s, estado del cliente %d", topic, client.state());
   }
-  Serial.println("============================\n");
+  return publishResult;
 }
 
+/**
+ * Codifica varias muestras como un lote (JSON o CBOR según la codificación
+ * seleccionada) y las publica en un único mensaje a TOPIC_PUB_BATCH.
+ */
+static bool publishSamples(const TimedSample * const * samples, uint16_t count) {
+  static uint8_t payload[TELEMETRY_BATCH_MAX(BATCH_CAPACITY)];
+  size_t length;
+  if (telemetryFormat == TELEMETRY_FORMAT_CBOR) {
+    length = encodeBatchCbor(samples, count, payload, sizeof(payload));
+  } else {
+    length = encodeBatchJson(samples, count, (char *)payload, sizeof(payload));
+  }
+  if (length == 0) {
+    LOG_E(LOG_PUBLISH, "El lote no cabe en el buffer de telemetría");
+    return false;
+  }
+  const TelemetryStats & stats = getTelemetryStats();
+  LOG_D(LOG_PUBLISH, "Publicando lote de %u muestras en %s: %u bytes, %u ciclos",
+        (unsigned)count, getTopic(TOPIC_PUB_BATCH), (unsigned)length, (unsigned)stats.lastCycles);
+
+  if (!client.publish(getTopic(TOPIC_PUB_BATCH), payload, length, false)) {
+    LOG_E(LOG_PUBLISH, "Fallo al publicar el lote, estado del cliente %d", client.state());
+    return false;
+  }
+  return true;
+}
 
 /**
- * Función que se ejecuta cuando llega un mensaje a la suscripción MQTT.
- * Construye el mensaje que llegó y si contiene ALERT lo asgina a la variable 
- * alert que es la que se lee para mostrar los mensajes.
- * También verifica si el mensaje es para actualización OTA.
+ * Guarda una muestra en la cola persistente como [timestamp LE (4 bytes)][muestra CBOR].
  */
-void receivedCallback(char* topic, byte* payload, unsigned int length) {
-  Serial.println("\n*** CALLBACK MQTT DISPARADO ***");
-  Serial.print("Topic recibido: [");
-  Serial.print(topic);
-  Serial.print("] (longitud payload: ");
-  Serial.print(length);
-  Serial.println(")");
-  
-  // Crear buffer para el payload (agregar null terminator)
-  // Usar String para evitar problemas con VLA
-  String data = "";
-  for (unsigned int i = 0; i < length; i++) {
-    data += (char)payload[i];
+static bool spoolSample(const TimedSample * sample) {
+  uint8_t record[SPOOL_RECORD_MAX];
+  record[0] = (uint8_t)sample->timestamp;
+  record[1] = (uint8_t)(sample->timestamp >> 8);
+  record[2] = (uint8_t)(sample->timestamp >> 16);
+  record[3] = (uint8_t)(sample->timestamp >> 24);
+  size_t length = encodeSensorDataCbor(&sample->data, record + 4, sizeof(record) - 4);
+  return length > 0 && spoolAppend(record, length + 4);
+}
+
+/**
+ * Mueve las muestras pendientes del ring buffer a la cola persistente para que no
+ * se pierdan mientras no hay conexión. Se envían luego con drainSpool().
+ */
+static void spoolPendingSamples() {
+  uint16_t count = batchCount();
+  uint16_t stored = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    if (spoolSample(batchPeek(i))) stored++;
   }
-  
-  Serial.print("Payload: ");
-  Serial.println(data);
-  
-  // Compara el topic recibido con el topic OTA
-  String topicStr = String(topic);
-  String otaTopicStr = String(OTA_TOPIC);
-  
-  Serial.println("--- Comparación de topics ---");
-  Serial.print("Topic recibido: '");
-  Serial.print(topicStr);
-  Serial.print("' (longitud: ");
-  Serial.print(topicStr.length());
-  Serial.println(")");
-  Serial.print("OTA_TOPIC esperado: '");
-  Serial.print(otaTopicStr);
-  Serial.print("' (longitud: ");
-  Serial.print(otaTopicStr.length());
-  Serial.println(")");
-  Serial.print("¿Coinciden? ");
-  Serial.println(topicStr == otaTopicStr ? "SÍ" : "NO");
-  
-  // Verifica si el mensaje es para actualización OTA
-  if (topicStr == otaTopicStr) {
-    Serial.println("✓✓✓ Mensaje OTA detectado, procesando...");
-    checkOTAUpdate(data.c_str());
-    return;
+  batchConsume(count);
+  LOG_W(LOG_PUBLISH, "Sin conexión MQTT: %u de %u muestras guardadas en flash (%u segmentos)",
+        (unsigned)stored, (unsigned)count, (unsigned)spoolSegments());
+}
+
+/**
+ * Publica las muestras pendientes del ring buffer (ver libbatch).
+ * Con BATCH_MAX_SAMPLES = 1 cada muestra sale sola por sendSensorData();
+ * con lotes, todas salen en un único mensaje a TOPIC_PUB_BATCH, en JSON o CBOR
+ * según la codificación seleccionada. Las muestras solo se liberan si la publicación
+ * tuvo éxito; si no hay conexión pasan a la cola persistente en flash.
+ */
+bool sendSensorBatch() {
+  uint16_t count = batchCount();
+  if (count == 0) return true;
+  if (batchMaxSamples() == 1) {
+    while (batchCount() > 0 && sendSensorData(&batchPeek(0)->data)) {
+      batchConsume(1);
+    }
+    if (batchCount() > 0 && !client.connected()) spoolPendingSamples();
+    return batchCount() == 0;
   }
-  
-  // Verifica si el mensaje contiene una alerta
-  if (data.indexOf("ALERT") >= 0) {
-    Serial.println("✓ Mensaje ALERT detectado");
-    alert = data; // Si el mensaje contiene la palabra ALERT, se asigna a la variable alert
+  if (!client.connected()) {
+    spoolPendingSamples();
+    return false;
+  }
+
+  const TimedSample * samples[BATCH_CAPACITY];
+  for (uint16_t i = 0; i < count; i++) samples[i] = batchPeek(i);
+  if (!publishSamples(samples, count)) return false;
+  batchConsume(count);
+  return true;
+}
+
+/**
+ * Reenvía las muestras guardadas en flash durante una desconexión.
+ * Publica como máximo SPOOL_DRAIN_BATCH muestras por lote y un lote cada
+ * SPOOL_DRAIN_INTERVAL_MS, para no saturar el enlace ni el bróker al reconectar.
+ */
+void drainSpool() {
+  static unsigned long lastDrain = 0;
+  if (!client.connected() || spoolEmpty()) return;
+  if (millis() - lastDrain < SPOOL_DRAIN_INTERVAL_MS) return;
+  lastDrain = millis();
+
+  TimedSample samples[SPOOL_DRAIN_BATCH];
+  const TimedSample * pending[SPOOL_DRAIN_BATCH];
+  uint8_t record[SPOOL_RECORD_MAX];
+  uint16_t count = 0;
+  size_t length;
+  while (count < SPOOL_DRAIN_BATCH && (length = spoolRead(record, sizeof(record))) > 0) {
+    if (length <= 4 || !decodeSensorDataCbor(record + 4, length - 4, &samples[count].data)) continue;
+    samples[count].timestamp = (uint32_t)record[0] | ((uint32_t)record[1] << 8) |
+                               ((uint32_t)record[2] << 16) | ((uint32_t)record[3] << 24);
+    pending[count] = &samples[count];
+    count++;
+  }
+  if (count == 0 || publishSamples(pending, count)) {
+    spoolCommit();
   } else {
-    Serial.println("⚠ Mensaje recibido pero no es OTA ni ALERT");
+    spoolRewind();
+  }
+}
+
+/**
+ * Publica el estado de la OTA. La descarga corre en otra tarea y PubSubClient
+ * no admite publicar desde varias, así que aquí solo se lee una copia del
+ * progreso (getOTAStats) desde loop().
+ */
+void reportOTAStatus() {
+  static uint32_t lastSequence = 0;
+  static unsigned long lastPublish = 0;
+  if (!client.connected()) return;
+  OtaStats stats = getOTAStats();
+  bool changed = stats.sequence != lastSequence;
+  bool periodic = stats.state == OTA_STATE_DOWNLOADING && millis() - lastPublish >= OTA_STATUS_INTERVAL_MS;
+  if (!changed && !periodic) return;
+  char payload[512];
+  size_t length = otaStatusJson(stats, payload, sizeof(payload));
+  if (length == 0) return;
+  if (client.publish(getTopic(TOPIC_PUB_OTA), (const uint8_t *)payload, length, true)) {
+    lastSequence = stats.sequence;
+    lastPublish = millis();
+  }
+}
+
+/**
+ * Despertar del modo de bajo consumo: espera a que el CCS811 y el PMS7003
+ * entreguen datos (como máximo DUTY_CYCLE_MEASURE_TIMEOUT_MS), guarda la
+ * muestra en memoria RTC y decide si este despertar debe conectarse.
+ * El reloj del sistema sigue corriendo en deep sleep, así que basta un SNTP
+ * al conectar; sin hora válida la muestra se descarta y se fuerza la conexión.
+ */
+bool dutyCycleMeasure() {
+  dutyInit(&dutyState, esp_reset_reason() == ESP_RST_DEEPSLEEP);
+  TimedSample sample;
+  memset(&sample, 0, sizeof(sample));
+  unsigned long start = millis();
+  while (millis() - start < DUTY_CYCLE_MEASURE_TIMEOUT_MS) {
+    SensorData reading;
+    if (sensorsReady() && measure(&reading)) {
+      if (reading.ccs811_valido) {
+        sample.data.co2 = reading.co2;
+        sample.data.tvoc = reading.tvoc;
+        sample.data.ccs811_valido = true;
+      }
+      if (reading.pms7003_valido) {
+        sample.data.pms7003 = reading.pms7003;
+        sample.data.pms7003_valido = true;
+      }
+    }
+    if (sample.data.pms7003_valido && (sample.data.ccs811_valido || !ccs811_detected)) break;
+    delay(500);
+  }
+  sample.timestamp = (uint32_t)time(nullptr);
+  bool timeValid = sample.timestamp >= TIME_VALID_EPOCH;
+  if (timeValid && (sample.data.ccs811_valido || sample.data.pms7003_valido)) {
+    dutyAdd(&dutyState, &sample);
+  }
+  bool flush = dutyOnWake(&dutyState, DUTY_CYCLE_FLUSH_EVERY, timeValid);
+  Serial.printf("Bajo consumo: despertar %lu, %u muestras en RTC, anterior despierto %lu ms%s\n",
+                (unsigned long)dutyState.wakes, (unsigned)dutyState.count,
+                (unsigned long)dutyState.lastAwakeMs, flush ? ", toca enviar" : "");
+  return flush;
+}
+
+/**
+ * Publica las muestras de la memoria RTC en lotes de hasta BATCH_CAPACITY.
+ * Las que alcanzaron a salir se liberan aunque un lote posterior falle.
+ * Luego atiende el cliente un momento para recibir comandos pendientes (OTA,
+ * configuración) que el bróker entrega al suscribirse.
+ */
+bool dutyCycleFlush() {
+  uint16_t published = 0;
+  bool ok = client.connected();
+  while (ok && published < dutyState.count) {
+    const TimedSample * samples[BATCH_CAPACITY];
+    uint16_t count = 0;
+    while (count < BATCH_CAPACITY && published + count < dutyState.count) {
+      samples[count] = dutyPeek(&dutyState, published + count);
+      count++;
+    }
+    ok = publishSamples(samples, count);
+    if (ok) published += count;
+  }
+  dutyFlushDone(&dutyState, published, ok);
+  Serial.printf("Bajo consumo: %u muestras enviadas, %u pendientes%s\n", (unsigned)published,
+                (unsigned)dutyState.count, ok ? "" : " (envío fallido, se reintenta más tarde)");
+  if (ok) {
+    unsigned long start = millis();
+    while (millis() - start < 500) {
+      client.loop();
+      delay(10);
+    }
+  }
+  return ok;
+}
+
+/**
+ * Cierra MQTT, apaga el WiFi y la UART del PMS7003 y entra en deep sleep por
+ * lo que falte del periodo DUTY_CYCLE_PERIOD_S. Al despertar se ejecuta setup().
+ */
+void dutyCycleSleep() {
+  dutyState.lastAwakeMs = millis();
+  if (client.connected()) client.disconnect();
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+  Serial2.end();
+  uint32_t sleepMs = dutySleepMs(DUTY_CYCLE_PERIOD_S * 1000UL, dutyState.lastAwakeMs);
+  logFlush(LOG_FLUSH_TIMEOUT_MS);            // Lo que quede en el ring se pierde en deep sleep
+  Serial.printf("Bajo consumo: durmiendo %lu ms\n", (unsigned long)sleepMs);
+  Serial.flush();
+  esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000ULL);
+  esp_deep_sleep_start();
+}
+
+/**
+ * Función que se ejecuta cuando llega un mensaje a la suscripción MQTT.
+ * Entrega el tópico y el payload, sin copiarlos, al handler registrado para
+ * ese tópico (ver libdispatch.h).
+ */
+void receivedCallback(char* topic, byte* payload, unsigned int length) {
+  if (!dispatchMessage(topic, payload, length)) {
+    LOG_W(LOG_MQTT, "Mensaje en tópico sin handler: %s (%u bytes)", topic, length);
   }
-  Serial.println("*** FIN CALLBACK ***\n");
 }
 
 /**
@@ -608,14 +1050,14 @@ void testMQTTCallback() {
   Serial.println("Publicando mensaje de prueba...");
   
   // Publicar un mensaje de prueba al topic de entrada (para que el dispositivo lo reciba)
-  String testTopic = String(MQTT_TOPIC_SUB);
+  String testTopic = String(getTopic(TOPIC_SUB));
   String testMessage = "TEST_MESSAGE_FROM_SELF";
   
   bool pubResult = client.publish(testTopic.c_str(), testMessage.c_str());
   if (pubResult) {
     Serial.println("✓ Mensaje de prueba publicado");
     Serial.println("Esperando recibirlo en el callback...");
-    Serial.println("(Si el callback funciona, deberías ver '*** CALLBACK MQTT DISPARADO ***' arriba)");
+    Serial.println("(Si el callback funciona, deberías ver 'Mensaje no reconocido en <tópico>' arriba)");
   } else {
     Serial.println("✗ Error al publicar mensaje de prueba");
   }
@@ -33,62 +33,88 @@
 #include <PubSubClient.h>
 #include <Wire.h>
 #include "Adafruit_CCS811.h"
+#include <libsensordata.h>
+#include <libtelemetry.h>
+#include <libbatch.h>
+#include <libtls.h>
+#include <libprofiler.h>
+#include <libboot.h>
+#include <libpms7003.h>
+#include <libaggregate.h>
+#include <libdeadband.h>
+#include <libdutycycle.h>
 
+#define CCS811_ADDRESS 0x5A        ///< Dirección I2C del CCS811 (ADDR a GND)
+#define CCS811_WARMUP_MS 2000       ///< Calentamiento del CCS811 tras configurar el modo de medición
 #define MEASURE_INTERVAL 2          ///< Intervalo en segundos de las mediciones
+#define SAMPLE_QUEUE_CAPACITY 32    ///< Muestras que caben entre la tarea de adquisición y loop() (potencia de dos)
+#define SENSOR_TASK_STACK 4096      ///< Pila de la tarea de adquisición
+#define SENSOR_TASK_PRIORITY 3      ///< Prioridad de la tarea de adquisición (loop() corre en 1)
+#define SENSOR_TASK_CORE 1          ///< Núcleo de la tarea de adquisición (el WiFi corre en el 0)
+#define TIME_VALID_EPOCH 1700000000 ///< Marca de tiempo mínima de un reloj ya sincronizado (noviembre de 2023)
 #define ALERT_DURATION 60           ///< Duración aproximada en la pantalla de las alertas que se reciban
+#define MQTT_BUFFER_SIZE (TELEMETRY_BATCH_MAX(BATCH_CAPACITY) + 256) ///< Buffer de PubSubClient: un lote completo más tópico y cabecera
+#define SPOOL_PATH "/littlefs/spool"  ///< Directorio de la cola persistente en LittleFS
+#define SPOOL_DRAIN_BATCH 8         ///< Muestras de la cola persistente reenviadas por lote
+#define SPOOL_DRAIN_INTERVAL_MS 1000 ///< Tiempo mínimo entre lotes al vaciar la cola persistente
+#define MQTT_BACKOFF_BASE_MS 1000   ///< Espera inicial entre intentos de conexión MQTT
+#define MQTT_BACKOFF_MAX_MS 60000   ///< Espera máxima entre intentos de conexión MQTT
+#define MQTT_CONNECT_TIMEOUT_S 10   ///< Tiempo máximo del handshake TLS en cada intento
+#ifndef AGGREGATE_WINDOW_SECONDS
+#define AGGREGATE_WINDOW_SECONDS 0  ///< Si es > 0 se publica un resumen por ventana en lugar de cada muestra
+#endif
+#ifndef DEADBAND_ENABLED
+#define DEADBAND_ENABLED 0          ///< 1: publica cada canal solo cuando cambia más que su umbral o vence el heartbeat
+#endif
+#ifndef TELEMETRY_FORMAT
+#define TELEMETRY_FORMAT TELEMETRY_FORMAT_JSON ///< Codificación por defecto de las muestras (TELEMETRY_FORMAT_JSON o TELEMETRY_FORMAT_CBOR)
+#endif
 
-extern const char* MQTT_TOPIC_PUB; ///< El tópico de publicación debe tener estructura: <país>/<estado>/<ciudad>/<usuario>/out
-extern const char* MQTT_TOPIC_SUB; ///< El tópico de publicación debe tener estructura: <país>/<estado>/<ciudad>/<usuario>/out
+extern const char* topic_location; ///< <país>/<estado>/<ciudad> de los tópicos (ver libtopics.h)
 extern const char* mqtt_server;     ///< Cambia por la dirección de tu servidor MQTT
 extern const int mqtt_port;         ///< Puerto seguro (TLS)
 extern const char* mqtt_user;       ///< Cambia por tu usuario MQTT
 extern const char* mqtt_password;   ///< Cambia por tu contraseña MQTT
 extern const char* root_ca;         ///< Certificado raíz de la autoridad de certificación en formato PEM
-extern WiFiClientSecure espClient;  ///< Conexión TLS/SSL
+extern const char* ota_public_key;  ///< Clave pública ECDSA P-256 (PEM) de las imágenes OTA; vacía desactiva la firma
+extern ResumableClientSecure espClient; ///< Conexión TLS/SSL con reanudación de sesión
 extern PubSubClient client;         ///< Cliente MQTT
 
 extern time_t now;                  ///< Timestamp de la fecha actual.
-extern long long int measureTime;   ///< Tiempo de la última medición
 extern long long int alertTime;     ///< Tiempo en que inició la última alerta
 extern String alert;                ///< Mensaje para mostrar en la pantalla
 extern Adafruit_CCS811 ccs;         ///< Sensor CCS811
 
-// Estructura para datos del PMS7003
-struct PMS7003Data {
-  uint16_t pm1_0_cf1;
-  uint16_t pm2_5_cf1;
-  uint16_t pm10_cf1;
-  uint16_t pm1_0_atm;
-  uint16_t pm2_5_atm;
-  uint16_t pm10_atm;
-  uint16_t num_part_03;
-  uint16_t num_part_05;
-  uint16_t num_part_1;
-  uint16_t num_part_25;
-  uint16_t num_part_5;
-  uint16_t num_part_10;
-};
-
-typedef struct {
-  // Datos del CCS811
-  uint16_t co2;
-  uint16_t tvoc;
-  bool ccs811_valido;
-  // Datos del PMS7003
-  PMS7003Data pms7003;
-  bool pms7003_valido;
-} SensorData;
-
-time_t setTime();                   ///< Función setTime que ajusta el tiempo del dispositivo con servidores SNTP
-bool measure(SensorData * data);    ///< Función measure que verifica si ya es momento de hacer las mediciones de las variables
-void reconnect();                   ///< Función que se ejecuta cuando se establece conexión con el servidor MQTT
+void startTimeSync();               ///< Lanza la sincronización SNTP sin bloquear
+bool timeSynced();                  ///< Retorna true cuando SNTP ya ajustó el reloj
+bool measure(SensorData * data);    ///< Función measure que lee los sensores; retorna true si alguno dio datos válidos
+void startSensorTask();             ///< Inicia la tarea de adquisición con periodo fijo MEASURE_INTERVAL
+bool nextSample(TimedSample * sample); ///< Saca la siguiente muestra de la tarea de adquisición; false si no hay
+void reconnect();                   ///< Función que avanza un paso la máquina de reconexión MQTT (con backoff exponencial y jitter)
+bool mqttReady();                   ///< Función mqttReady que retorna true si la conexión MQTT está establecida y suscrita
 void setupIoT();                    ///< Función setupIoT que configura el certificado raíz, el servidor MQTT y el puerto
-void setupSensors();                ///< Función setupSensors que configura los sensores CCS811 y PMS7003
+void setupSensors();                ///< Función setupSensors que configura los sensores CCS811 y PMS7003 (no espera el calentamiento)
+bool sensorsReady();                ///< Retorna true cuando el CCS811 terminó su calentamiento
+bool readPMS7003(PMS7003Data * data); ///< Retorna la última trama válida del PMS7003 si llegó una nueva
+Pms7003Stats getPMS7003Stats();     ///< Contadores del parser del PMS7003
 void scanI2C();                     ///< Función scanI2C que escanea el bus I2C y muestra los dispositivos encontrados
 void checkMQTT();                   ///< Función checkMQTT que verifica si el dispositivo está conectado al broker MQTT y si no lo está, intenta reconectar
 String checkAlert();                ///< Función checkAlert que verifica si ha llegado alguna alerta al dispositivo
 void receivedCallback(char* topic, byte* payload, unsigned int length); ///< Función receivedCallback que se ejecuta cuando llega un mensaje a la suscripción MQTT
-void sendSensorData(SensorData * data); ///< Función sendSensorData que publica los datos de los sensores al tópico configurado usando el cliente MQTT
-String getMacAddress();             ///< Función getMacAddress que adquiere la dirección MAC del dispositivo y la retorna en formato de cadena  
+bool sendSensorData(const SensorData * data); ///< Función sendSensorData que publica los datos de los sensores al tópico configurado usando el cliente MQTT
+bool sendSensorBatch();             ///< Función sendSensorBatch que publica en un solo mensaje las muestras pendientes del ring buffer
+void drainSpool();                  ///< Función drainSpool que reenvía, a ritmo controlado, las muestras guardadas en flash durante una desconexión
+void reportOTAStatus();             ///< Publica el progreso de la OTA en TOPIC_PUB_OTA al cambiar de estado y cada OTA_STATUS_INTERVAL_MS durante la descarga
+void setTelemetryFormat(TelemetryFormat format); ///< Selecciona la codificación (JSON o CBOR) de las muestras publicadas
+TelemetryFormat getTelemetryFormat(); ///< Retorna la codificación actual de las muestras publicadas
+void setAggregateWindow(uint32_t seconds); ///< Ventana de agregación en segundos (0 publica cada muestra)
+uint32_t getAggregateWindow();      ///< Retorna la ventana de agregación actual
+bool reportByException(const TimedSample * sample); ///< Publica solo los canales que superaron su umbral; false si el modo está apagado o no se pudo publicar
+bool applyDeadbandConfig(const char * json, size_t length); ///< Aplica y guarda en NVS una configuración {"deadband":{...}} recibida por MQTT
+bool applyLogConfig(const char * json, size_t length); ///< Aplica niveles de registro {"log":{"<módulo>":"<nivel>"}} recibidos por MQTT (hasta el reinicio)
+bool aggregateSample(const TimedSample * sample); ///< Agrega la muestra y publica el resumen al cerrar la ventana; false si la agregación está apagada
+bool dutyCycleMeasure();            ///< Modo de bajo consumo: mide una vez, guarda la muestra en memoria RTC y retorna true si toca conectarse
+bool dutyCycleFlush();              ///< Modo de bajo consumo: publica las muestras de la memoria RTC y registra el resultado
+void dutyCycleSleep();              ///< Modo de bajo consumo: apaga radio y UART y duerme hasta el siguiente periodo (no retorna)
 
 #endif /* LIBIOT_H */
@@ -0,0 +1,215 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <liblog.h>
+#include <Arduino.h>
+#include <stdarg.h>
+#include <string.h>
+
+static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0, "LOG_BUFFER_SIZE debe ser potencia de 2");
+static_assert(LOG_MODULE_COUNT == 4, "Actualizar moduleNames y logLevels");
+
+static const char * const moduleNames[LOG_MODULE_COUNT] = { "mqtt", "sensors", "publish", "health" };
+static const char * const levelNames[] = { "none", "error", "warn", "info", "debug", "verbose" };
+static const char levelTags[] = "-EWIDV";
+
+uint8_t logLevels[LOG_MODULE_COUNT] = {
+  LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL, LOG_DEFAULT_LEVEL
+};
+
+// Ring de bytes: head y tail solo crecen (desbordan juntos porque el tamaño es
+// potencia de 2). Quienes escriben copian bajo logMux; la única que lee es la
+// tarea de log (o logFlush antes de que exista), que envía [tail, head) sin lock.
+static char ring[LOG_BUFFER_SIZE];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+static LogStats stats;
+static uint32_t droppedReported = 0;
+static portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t logTask = nullptr;
+
+/**
+ * Copia una línea completa al ring o la descarta si no cabe. Nunca bloquea.
+ */
+static void enqueue(const char * line, size_t length) {
+  portENTER_CRITICAL(&logMux);
+  uint32_t used = head - tail;
+  if (used + length > LOG_BUFFER_SIZE) {
+    stats.dropped++;
+  } else {
+    uint32_t pos = head & (LOG_BUFFER_SIZE - 1);
+    size_t first = length < LOG_BUFFER_SIZE - pos ? length : LOG_BUFFER_SIZE - pos;
+    memcpy(ring + pos, line, first);
+    memcpy(ring, line + first, length - first);
+    head += length;
+    used += length;
+    stats.lines++;
+    if (used > stats.highWater) stats.highWater = used;
+  }
+  portEXIT_CRITICAL(&logMux);
+  if (logTask) xTaskNotifyGive(logTask);
+}
+
+/**
+ * Envía por Serial todo lo que hay en el ring. Aquí es donde se espera al UART.
+ */
+static void drain() {
+  for (;;) {
+    portENTER_CRITICAL(&logMux);
+    uint32_t available = head - tail;
+    uint32_t dropped = stats.dropped;
+    portEXIT_CRITICAL(&logMux);
+    if (dropped != droppedReported) {
+      Serial.printf("[log] %lu líneas descartadas (ring lleno)\n", (unsigned long)(dropped - droppedReported));
+      droppedReported = dropped;
+    }
+    if (available == 0) return;
+    uint32_t pos = tail & (LOG_BUFFER_SIZE - 1);
+    size_t chunk = available < LOG_BUFFER_SIZE - pos ? available : LOG_BUFFER_SIZE - pos;
+    Serial.write((const uint8_t *)ring + pos, chunk);
+    portENTER_CRITICAL(&logMux);
+    tail += chunk;
+    portEXIT_CRITICAL(&logMux);
+  }
+}
+
+static void logTaskMain(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_FLUSH_INTERVAL_MS));
+    drain();
+  }
+}
+
+void logBegin() {
+  if (logTask) return;
+  xTaskCreatePinnedToCore(logTaskMain, "log", LOG_TASK_STACK, nullptr,
+                          LOG_TASK_PRIORITY, &logTask, LOG_TASK_CORE);
+}
+
+/**
+ * Escribe el encabezado [ms][nivel][módulo] y devuelve su longitud.
+ */
+static size_t formatHeader(char * line, LogModule module, uint8_t level) {
+  int n = snprintf(line, LOG_LINE_MAX, "[%lu][%c][%s] ", (unsigned long)millis(),
+                   levelTags[level <= LOG_LEVEL_VERBOSE ? level : 0], moduleNames[module]);
+  return n > 0 && n < LOG_LINE_MAX ? n : 0;
+}
+
+/**
+ * Formatea la línea en la pila de quien llama y la encola con su salto de línea.
+ * Los textos que no caben en LOG_LINE_MAX se truncan.
+ */
+void logPrintf(LogModule module, uint8_t level, const char * format, ...) {
+  char line[LOG_LINE_MAX];
+  size_t length = formatHeader(line, module, level);
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(line + length, LOG_LINE_MAX - length, format, args);
+  va_end(args);
+  if (n > 0) length += n;
+  if (length > LOG_LINE_MAX - 2) length = LOG_LINE_MAX - 2;
+  line[length++] = '\n';
+  enqueue(line, length);
+}
+
+/**
+ * Como logPrintf(module, level, "%s<hex>", prefix); los bytes que no caben se
+ * reemplazan por "...".
+ */
+void logHex(LogModule module, uint8_t level, const char * prefix, const uint8_t * data, size_t length) {
+  static const char digits[] = "0123456789abcdef";
+  char line[LOG_LINE_MAX];
+  size_t n = formatHeader(line, module, level);
+  size_t p = strlen(prefix);
+  if (p > LOG_LINE_MAX - 6 - n) p = LOG_LINE_MAX - 6 - n;
+  memcpy(line + n, prefix, p);
+  n += p;
+  for (size_t i = 0; i < length; i++) {
+    if (n + 2 > LOG_LINE_MAX - 5) {
+      memcpy(line + n, "...", 3);
+      n += 3;
+      break;
+    }
+    line[n++] = digits[data[i] >> 4];
+    line[n++] = digits[data[i] & 0x0F];
+  }
+  line[n++] = '\n';
+  enqueue(line, n);
+}
+
+/**
+ * Espera hasta timeoutMs a que se envíe lo encolado. Sin tarea (antes de
+ * logBegin) drena desde quien llama.
+ */
+void logFlush(uint32_t timeoutMs) {
+  unsigned long start = millis();
+  while (head != tail && millis() - start < timeoutMs) {
+    if (!logTask) {
+      drain();
+      break;
+    }
+    xTaskNotifyGive(logTask);
+    vTaskDelay(pdMS_TO_TICKS(5));
+  }
+  Serial.flush();
+}
+
+static int parseLevel(const char * name) {
+  for (int l = LOG_LEVEL_NONE; l <= LOG_LEVEL_VERBOSE; l++) {
+    if (strcmp(name, levelNames[l]) == 0) return l;
+  }
+  return -1;
+}
+
+/**
+ * Cambia en ejecución el nivel de un módulo ("*" para todos). Los niveles por
+ * encima de LOG_MIN_LEVEL se aceptan pero no tienen efecto: no están compilados.
+ */
+bool logSetLevel(const char * module, const char * level) {
+  int l = parseLevel(level);
+  if (l < 0) return false;
+  bool found = false;
+  for (int m = 0; m < LOG_MODULE_COUNT; m++) {
+    if (strcmp(module, "*") == 0 || strcmp(module, moduleNames[m]) == 0) {
+      logLevels[m] = l;
+      found = true;
+    }
+  }
+  return found;
+}
+
+const char * logModuleName(LogModule module) {
+  return module < LOG_MODULE_COUNT ? moduleNames[module] : "?";
+}
+
+const char * logLevelName(uint8_t level) {
+  return level <= LOG_LEVEL_VERBOSE ? levelNames[level] : "?";
+}
+
+LogStats logGetStats() {
+  portENTER_CRITICAL(&logMux);
+  LogStats copy = stats;
+  portEXIT_CRITICAL(&logMux);
+  return copy;
+}
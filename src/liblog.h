@@ -0,0 +1,98 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBLOG_H
+#define LIBLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Registro por niveles y módulos que no bloquea a quien escribe. Cada línea se
+// formatea en la pila del que llama y se copia a un ring buffer en RAM; una
+// tarea de baja prioridad la envía por Serial. Si el ring está lleno la línea
+// se descarta y se cuenta, así que el ciclo de medición y publicación nunca
+// espera al UART.
+//
+// Dos filtros: LOG_MIN_LEVEL en compilación (los niveles por encima quedan
+// como código muerto que el compilador elimina, cadenas incluidas) y un nivel
+// por módulo en ejecución, ajustable por MQTT con {"log":{"mqtt":"debug"}}.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_VERBOSE 5
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG   ///< Nivel máximo compilado; en producción -D LOG_MIN_LEVEL=LOG_LEVEL_INFO
+#endif
+#ifndef LOG_DEFAULT_LEVEL
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO ///< Nivel inicial de cada módulo en ejecución
+#endif
+#define LOG_BUFFER_SIZE 4096        ///< Bytes del ring entre quienes escriben y la tarea que drena
+#define LOG_LINE_MAX 192            ///< Longitud máxima de una línea (se trunca)
+#define LOG_TASK_STACK 3072         ///< Pila de la tarea que escribe en Serial
+#define LOG_TASK_PRIORITY 1         ///< Por debajo de WiFi/lwIP
+#define LOG_TASK_CORE 0             ///< loop() y la adquisición corren en el 1
+#define LOG_FLUSH_INTERVAL_MS 100   ///< La tarea drena al menos con este periodo aunque no la despierten
+#define LOG_FLUSH_TIMEOUT_MS 500    ///< Espera máxima de logFlush() antes de dormir o reiniciar
+
+typedef enum {
+  LOG_MQTT = 0,                     ///< Conexión con el bróker y mensajes recibidos
+  LOG_SENSORS,                      ///< Lecturas de CCS811 y PMS7003
+  LOG_PUBLISH,                      ///< Publicación de muestras, lotes y cola offline
+  LOG_HEALTH,                       ///< Healthcheck periódico
+  LOG_MODULE_COUNT
+} LogModule;
+
+extern uint8_t logLevels[LOG_MODULE_COUNT]; ///< Nivel en ejecución de cada módulo (ver logSetLevel)
+
+/** true si una línea de ese nivel y módulo se escribiría; constante false por encima de LOG_MIN_LEVEL. */
+#define LOG_ENABLED(module, level) ((level) <= LOG_MIN_LEVEL && (level) <= logLevels[module])
+
+#define LOG_AT(module, level, ...) \
+  do { if (LOG_ENABLED(module, level)) logPrintf(module, level, __VA_ARGS__); } while (0)
+#define LOG_E(module, ...) LOG_AT(module, LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_W(module, ...) LOG_AT(module, LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_I(module, ...) LOG_AT(module, LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_D(module, ...) LOG_AT(module, LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_V(module, ...) LOG_AT(module, LOG_LEVEL_VERBOSE, __VA_ARGS__)
+
+typedef struct {
+  uint32_t lines;                   ///< Líneas encoladas
+  uint32_t dropped;                 ///< Líneas descartadas por ring lleno
+  uint32_t highWater;               ///< Máxima ocupación del ring en bytes
+} LogStats;
+
+void logBegin();                    ///< Inicia la tarea que drena el ring; lo escrito antes queda en el ring
+void logPrintf(LogModule module, uint8_t level, const char * format, ...) __attribute__((format(printf, 3, 4)));
+void logHex(LogModule module, uint8_t level, const char * prefix, const uint8_t * data, size_t length); ///< prefix seguido de data en hexadecimal
+void logFlush(uint32_t timeoutMs);  ///< Espera a que el ring se vacíe (antes de dormir o reiniciar)
+bool logSetLevel(const char * module, const char * level); ///< Cambia el nivel de un módulo por nombre ("*" = todos); false si no existe
+const char * logModuleName(LogModule module);
+const char * logLevelName(uint8_t level);
+LogStats logGetStats();
+
+#endif /* LIBLOG_H */
@@ -25,8 +25,24 @@
 #include <libota.h>
 #include <libiot.h>
 #include <libstorage.h>
+#include <libotapatch.h>
+#include <librollout.h>
+#include <libdispatch.h>
+#include <libtopics.h>
+#include <WiFi.h>
 #include <cstring>
 #include <cstdlib>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <lwip/sockets.h>
+#include <mbedtls/md.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/base64.h>
+#if CONFIG_IDF_TARGET_ESP32S3
+#include <esp32s3/rom/miniz.h>
+#else
+#include <esp32/rom/miniz.h>
+#endif
 
 // Versión del firmware (debe coincidir con main.cpp)
 #ifndef FIRMWARE_VERSION
@@ -34,24 +50,77 @@
 #endif
 
 
+// Pipeline de la actualización: la tarea OTA descarga en un buffer libre y lo
+// pasa a la tarea escritora, que lo graba en flash y lo devuelve. Con varios
+// buffers la red sigue recibiendo mientras la flash borra y escribe; si la
+// flash se atrasa, la descarga espera un buffer libre (contrapresión).
+// El fin de la imagen se marca encolando nullptr en fullBuffers.
+struct OtaBuffer {
+    size_t length;            // Bytes válidos en data
+    uint8_t data[OTA_BUFFER_SIZE];
+};
+
+static QueueHandle_t freeBuffers = nullptr;   // Buffers listos para recibir
+static QueueHandle_t fullBuffers = nullptr;   // Buffers listos para escribir
+static SemaphoreHandle_t writerDone = nullptr;
+static volatile bool writerFailed = false;
+static const char OTA_ERROR_BASE[] = "base distinta";  // El parche no corresponde a la imagen instalada
+static const char OTA_ERROR_LINK[] = "conexion perdida"; // Reanudable con Range
+static const char OTA_ERROR_STALL[] = "descarga detenida"; // Sin datos en OTA_STALL_TIMEOUT_MS; reanudable
+static OtaStats otaStats = { OTA_STATE_IDLE };
+static RateLimiter downloadLimit;     // Límite de velocidad del despliegue (lo aplica la tarea que descarga)
+static portMUX_TYPE otaMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void setOTAState(OtaState state, const char* error) {
+    portENTER_CRITICAL(&otaMux);
+    otaStats.state = state;
+    otaStats.sequence++;
+    strncpy(otaStats.error, error ? error : "", sizeof(otaStats.error) - 1);
+    otaStats.error[sizeof(otaStats.error) - 1] = '\0';
+    portEXIT_CRITICAL(&otaMux);
+}
+
+OtaStats getOTAStats() {
+    portENTER_CRITICAL(&otaMux);
+    OtaStats copy = otaStats;
+    portEXIT_CRITICAL(&otaMux);
+    return copy;
+}
+
+size_t otaStatusJson(const OtaStats & stats, char* out, size_t size) {
+    static const char* states[] = { "idle", "waiting", "downloading", "done", "failed", "skipped" };
+    uint32_t kbps = stats.elapsedMs ? (uint32_t)((uint64_t)(stats.received - stats.resumedFrom) * 8 / stats.elapsedMs) : 0;
+    uint32_t percent = stats.total ? (uint32_t)((uint64_t)stats.received * 100 / stats.total) : 0;
+    int n = snprintf(out, size,
+                     "{\"state\":\"%s\",\"version\":\"%s\",\"total\":%lu,\"received\":%lu,\"image\":%lu,\"written\":%lu,"
+                     "\"pct\":%lu,\"kbps\":%lu,\"elapsed_ms\":%lu,\"stall_ms\":%lu,\"backpressure_ms\":%lu,"
+                     "\"flash_ms\":%lu,\"hash_ms\":%lu,\"resumes\":%lu,\"resumed_from\":%lu,\"cohort\":%u,"
+                     "\"delay_ms\":%lu,\"rate_kbps\":%lu,\"throttle_ms\":%lu,\"error\":\"%s\"}",
+                     states[stats.state], stats.version, (unsigned long)stats.total,
+                     (unsigned long)stats.received, (unsigned long)stats.imageSize, (unsigned long)stats.written,
+                     (unsigned long)percent,
+                     (unsigned long)kbps, (unsigned long)stats.elapsedMs, (unsigned long)stats.networkStallMs,
+                     (unsigned long)stats.backpressureMs, (unsigned long)stats.flashMs, (unsigned long)(stats.hashUs / 1000),
+                     (unsigned long)stats.resumes, (unsigned long)stats.resumedFrom, stats.cohort,
+                     (unsigned long)stats.startDelayMs, (unsigned long)((uint64_t)stats.rateLimit * 8 / 1000),
+                     (unsigned long)stats.throttleMs, stats.error);
+    return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+}
+
 /**
  * Configuración inicial de OTA
  */
 void setupOTA(PubSubClient& client) {
     Serial.println("--- Configurando OTA ---");
     Serial.print("OTA_TOPIC definido: ");
-    Serial.println(OTA_TOPIC);
-    
-    // Inicializa la biblioteca Update
-    Update.onProgress([](unsigned int progress, unsigned int total) {
-        // Muestra el progreso de la actualización
-        Serial.printf("Progreso: %u%%\r", (progress * 100) / total);
-    });
+    Serial.println(getTopic(TOPIC_OTA));
     
     // Suscribe al tópico de OTA
+    dispatchRegister(getTopic(TOPIC_OTA), otaMessageHandler);
     subscribeToOTATopic(client);
     
     Serial.println("--- OTA configurado ---");
+    resumePendingOTA();     // Una descarga cortada por la red o por un reinicio sigue donde quedó
 }
 
 /**
@@ -65,37 +134,66 @@ void subscribeToOTATopic(PubSubClient & client) {
     }
     
     Serial.print("Intentando suscribirse a: '");
-    Serial.print(OTA_TOPIC);
+    Serial.print(getTopic(TOPIC_OTA));
     Serial.println("'");
     
     // Suscribe con QoS 1 para asegurar la entrega
-    bool result = client.subscribe(OTA_TOPIC, 1);
+    bool result = client.subscribe(getTopic(TOPIC_OTA), 1);
     if (result) {
-        Serial.println("✓ Suscrito exitosamente al tópico OTA: " + String(OTA_TOPIC));
-        // Procesar mensajes inmediatamente para confirmar suscripción
-        client.loop();
-        delay(50);
-        Serial.println("✓ Procesamiento de mensajes después de suscripción OTA completado");
+        Serial.println("✓ Suscrito exitosamente al tópico OTA: " + String(getTopic(TOPIC_OTA)));
     } else {
-        Serial.println("✗ Error al suscribirse al tópico OTA: " + String(OTA_TOPIC));
+        Serial.println("✗ Error al suscribirse al tópico OTA: " + String(getTopic(TOPIC_OTA)));
         Serial.print("Estado del cliente: ");
         Serial.println(client.state());
     }
 }
 
+static bool parseHex(const char* hex, uint8_t* out, size_t length) {
+    if (strlen(hex) != length * 2) return false;
+    for (size_t i = 0; i < length * 2; i++) {
+        char c = hex[i];
+        int value = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                    (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (value < 0) return false;
+        out[i / 2] = (i % 2) ? (out[i / 2] | value) : (value << 4);
+    }
+    return true;
+}
+
+/**
+ * Deja en el estado publicado que este dispositivo no participa del
+ * despliegue, sin pisar una actualización en curso.
+ */
+static void reportSkipped(const char* version, uint8_t cohort) {
+    OtaState state = getOTAStats().state;
+    if (state == OTA_STATE_WAITING || state == OTA_STATE_DOWNLOADING) return;
+    portENTER_CRITICAL(&otaMux);
+    uint32_t sequence = otaStats.sequence;
+    memset(&otaStats, 0, sizeof(otaStats));
+    otaStats.sequence = sequence;
+    otaStats.cohort = cohort;
+    strncpy(otaStats.version, version, sizeof(otaStats.version) - 1);
+    portEXIT_CRITICAL(&otaMux);
+    setOTAState(OTA_STATE_SKIPPED, NULL);
+}
+
 /**
  * Verifica si hay actualizaciones disponibles
  * Procesa el mensaje JSON recibido en el tópico OTA
  */
-void checkOTAUpdate(const char* payload) {
-    Serial.println("Mensaje OTA recibido: " + String(payload));
+void checkOTAUpdate(char* payload, size_t length) {
+    Serial.print("Mensaje OTA recibido: ");
+    Serial.write((const uint8_t*)payload, length);
+    Serial.println();
     String currentVersion = getFirmwareVersion();
     Serial.print("Versión actual del firmware: ");
     Serial.println(currentVersion);
     
     // Parsea el JSON
-    StaticJsonDocument<512> doc;
-    DeserializationError error = deserializeJson(doc, payload);
+    StaticJsonDocument<1024> doc;
+    // Con char* ArduinoJson lee sin copiar: los textos apuntan al payload,
+    // que sigue vivo hasta que retorna esta función
+    DeserializationError error = deserializeJson(doc, payload, length);
     
     if (error) {
         Serial.print("Error al parsear JSON: ");
@@ -114,18 +212,95 @@ void checkOTAUpdate(const char* payload) {
         Serial.println("Nueva versión disponible: " + String(version));
         Serial.println("URL de actualización: " + String(url));
         
+        // Parche contra la versión instalada, si el mensaje trae uno para ella
+        const char* deltaUrl = NULL;
+        const char* deltaBase = doc["delta"]["base"] | "";
+        if (doc["delta"]["url"].is<const char*>() && currentVersion.equals(deltaBase)) {
+            deltaUrl = doc["delta"]["url"];
+            Serial.println("Parche disponible desde " + currentVersion + ": " + String(deltaUrl));
+        } else if (doc["compressed"]["url"].is<const char*>()) {
+            // Sin parche para esta versión, la imagen comprimida ahorra tráfico;
+            // si se interrumpe, la plana de url es la que se reanuda
+            deltaUrl = doc["compressed"]["url"];
+            Serial.println("Imagen comprimida disponible: " + String(deltaUrl));
+        }
+
+        // Hash y firma de la imagen resultante; con clave configurada la firma es obligatoria
+        OtaSignature check;
+        memset(&check, 0, sizeof(check));
+        const char* sha256 = doc["sha256"] | "";
+        const char* sig = doc["sig"] | "";
+        size_t sigLength = 0;
+        if (sha256[0] && !parseHex(sha256, check.digest, sizeof(check.digest))) {
+            Serial.println("Mensaje OTA inválido: sha256 mal formado");
+            return;
+        }
+        if (sig[0] && mbedtls_base64_decode(check.signature, sizeof(check.signature), &sigLength,
+                                            (const unsigned char*)sig, strlen(sig)) != 0) {
+            Serial.println("Mensaje OTA inválido: firma mal formada");
+            return;
+        }
+        check.hasDigest = sha256[0] != '\0';
+        check.signatureLength = sigLength;
+        if (ota_public_key[0] && check.signatureLength == 0) {
+            Serial.println("✗ Mensaje OTA sin firma; se ignora");
+            return;
+        }
+
+        // Despliegue escalonado: cohorte por hash del ID y la semilla (por
+        // defecto la versión), retardo dentro de la ventana y límite de velocidad
+        OtaRollout rollout;
+        memset(&rollout, 0, sizeof(rollout));
+        // window_s y rate_kbps se recortan: un valor negativo o enorme desbordaría
+        // el retardo o el límite en vez de ignorarse
+        uint32_t percent = doc["rollout"]["percent"] | 100;
+        uint32_t hash = rolloutHash(getDeviceId(), doc["rollout"]["seed"] | version);
+        long windowS = doc["rollout"]["window_s"] | 0L;
+        long rateKbps = doc["rollout"]["rate_kbps"] | 0L;
+        windowS = constrain(windowS, 0L, (long)ROLLOUT_MAX_WINDOW_S);
+        rateKbps = constrain(rateKbps, 0L, (long)ROLLOUT_MAX_RATE_KBPS);
+        rollout.cohort = rolloutCohort(hash);
+        rollout.delayMs = rolloutDelayMs(hash, (uint32_t)windowS);
+        rollout.bytesPerSecond = (uint32_t)rateKbps * 1000 / 8;
+        if (rollout.cohort >= percent) {
+            Serial.printf("Fuera del despliegue (cohorte %u, porcentaje %lu); se ignora\n", rollout.cohort, (unsigned long)percent);
+            reportSkipped(version, rollout.cohort);
+            return;
+        }
+
         // Lanza tarea OTA con URL y versión
-        startOTATask(url, version);
+        startOTATask(url, version, deltaUrl, &check, &rollout);
     } else {
         Serial.println("Mensaje OTA inválido: No contiene URL");
     }
 }
 
+/**
+ * Handler del tópico OTA registrado en libdispatch: el payload llega sin
+ * copiar desde el buffer de PubSubClient.
+ */
+void otaMessageHandler(const char* topic, uint8_t* payload, size_t length) {
+    checkOTAUpdate((char*)payload, length);
+}
+
+
+static void freeOTAData(OTAData* otaData) {
+    free(otaData->url);
+    free(otaData->version);
+    free(otaData->deltaUrl);
+    free(otaData);
+}
 
 /**
  * Lanza la tarea OTA en otro núcleo
  */
-void startOTATask(const char* url, const char* version) {
+void startOTATask(const char* url, const char* version, const char* deltaUrl, const OtaSignature* check,
+                  const OtaRollout* rollout) {
+    OtaState current = getOTAStats().state;
+    if (current == OTA_STATE_WAITING || current == OTA_STATE_DOWNLOADING) {
+        Serial.println("Ya hay una actualización OTA en curso; se ignora la nueva");
+        return;
+    }
     // Crear estructura con datos para la tarea
     OTAData* otaData = (OTAData*)malloc(sizeof(OTAData));
     if (otaData == NULL) {
@@ -140,22 +315,43 @@ void startOTATask(const char* url, const char* version) {
     
     otaData->url = (char*)malloc(urlLen);
     otaData->version = (char*)malloc(versionLen);
+    otaData->deltaUrl = deltaUrl ? (char*)malloc(strlen(deltaUrl) + 1) : NULL;
     
-    if (otaData->url == NULL || otaData->version == NULL) {
+    if (otaData->url == NULL || otaData->version == NULL || (deltaUrl && otaData->deltaUrl == NULL)) {
         Serial.println("Error: No se pudo asignar memoria para strings OTA");
-        free(otaData->url);
-        free(otaData->version);
-        free(otaData);
+        freeOTAData(otaData);
         return;
     }
     
     strcpy(otaData->url, url);
     strcpy(otaData->version, version);
+    if (deltaUrl) strcpy(otaData->deltaUrl, deltaUrl);
+    if (check) {
+        otaData->check = *check;
+    } else {
+        memset(&otaData->check, 0, sizeof(otaData->check));
+    }
+    if (rollout) {
+        otaData->rollout = *rollout;
+    } else {
+        memset(&otaData->rollout, 0, sizeof(otaData->rollout));
+    }
+
+    portENTER_CRITICAL(&otaMux);
+    uint32_t sequence = otaStats.sequence;
+    memset(&otaStats, 0, sizeof(otaStats));
+    otaStats.sequence = sequence;
+    strncpy(otaStats.version, version, sizeof(otaStats.version) - 1);
+    otaStats.cohort = otaData->rollout.cohort;
+    otaStats.startDelayMs = otaData->rollout.delayMs;
+    otaStats.rateLimit = otaData->rollout.bytesPerSecond;
+    portEXIT_CRITICAL(&otaMux);
+    setOTAState(otaData->rollout.delayMs > 0 ? OTA_STATE_WAITING : OTA_STATE_DOWNLOADING, NULL);
 
     xTaskCreatePinnedToCore(
         performOTAUpdateTask, // función
         "OTA_Task",           // nombre de la tarea
-        8192,                 // tamaño del stack
+        OTA_RECEIVE_TASK_STACK, // tamaño del stack
         otaData,              // parámetro (puntero a estructura OTAData)
         1,                    // prioridad
         NULL,                 // handle
@@ -163,93 +359,661 @@ void startOTATask(const char* url, const char* version) {
     );
 }
 
+/**
+ * Relanza la actualización que quedó a medias por un corte de red o un
+ * reinicio. Se llama cada vez que MQTT (re)conecta; no hace nada si ya hay
+ * una en curso o si la versión guardada ya es la instalada.
+ */
+bool resumePendingOTA() {
+    OtaResumeState state;
+    uint32_t offset;
+    OtaState current = getOTAStats().state;
+    if (current == OTA_STATE_WAITING || current == OTA_STATE_DOWNLOADING || !loadOtaResume(state, offset)) return false;
+    if (getFirmwareVersion().equals(state.version)) {
+        clearOtaResume();
+        return false;
+    }
+    Serial.printf("Reanudando la actualización %s desde el byte %lu\n", state.version, (unsigned long)offset);
+    // Ya pasó la selección del despliegue: sin retardo, con el mismo límite de velocidad
+    OtaRollout rollout = { 0, state.rateLimit, 0 };
+    startOTATask(state.url, state.version, NULL, &state.check, &rollout);
+    return true;
+}
+
+
+// Partición destino. Se escribe directamente, sin Update, para poder retomar
+// la escritura en cualquier sector tras un reinicio: cada sector se borra al
+// entrar en él y la partición de arranque solo cambia cuando la imagen
+// completa pasa la validación de esp_ota_set_boot_partition().
+static const uint32_t FLASH_SECTOR = 4096;
+static const esp_partition_t* target = NULL;
+static uint32_t flashOffset = 0;      // Bytes de la imagen ya escritos
+static uint32_t flashSize = 0;
+static mbedtls_md_context_t imageHash; // SHA-256 de lo escrito, calculado al pasar (SHA por hardware)
+static bool imageHashReady = false;
 
 /**
- * Función que ejecuta la OTA (en otro hilo)
+ * Abre la partición destino y reinicia el SHA-256 de la imagen. Al continuar
+ * tras un reinicio, el hash de los offset bytes ya escritos se recalcula
+ * leyéndolos de la partición (la única vez que se lee lo escrito).
  */
-void performOTAUpdateTask(void* parameter) {
-    OTAData* otaData = (OTAData*)parameter;
-    const char* url = otaData->url;
-    const char* version = otaData->version;
+static bool flashBegin(uint32_t size, uint32_t offset) {
+    target = esp_ota_get_next_update_partition(NULL);
+    if (!target || size > target->size || offset > size) return false;
+    if (imageHashReady) mbedtls_md_free(&imageHash);
+    mbedtls_md_init(&imageHash);
+    imageHashReady = mbedtls_md_setup(&imageHash, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0) == 0 &&
+                     mbedtls_md_starts(&imageHash) == 0;
+    if (!imageHashReady) return false;
+    uint8_t block[1024];
+    for (uint32_t pos = 0; pos < offset; pos += sizeof(block)) {
+        size_t n = offset - pos < sizeof(block) ? offset - pos : sizeof(block);
+        if (esp_partition_read(target, pos, block, n) != ESP_OK) return false;
+        mbedtls_md_update(&imageHash, block, n);
+    }
+    flashSize = size;
+    flashOffset = offset;
+    portENTER_CRITICAL(&otaMux);
+    otaStats.imageSize = size;
+    otaStats.written = offset;
+    portEXIT_CRITICAL(&otaMux);
+    return true;
+}
 
-    Serial.println("Iniciando actualización OTA desde: " + String(url));
-    Serial.println("Nueva versión: " + String(version));
+static bool flashWrite(const uint8_t* data, size_t length) {
+    if (flashOffset + length > flashSize) return false;
+    uint32_t end = flashOffset + length;
+    for (uint32_t sector = (flashOffset + FLASH_SECTOR - 1) & ~(FLASH_SECTOR - 1); sector < end; sector += FLASH_SECTOR) {
+        if (esp_partition_erase_range(target, sector, FLASH_SECTOR) != ESP_OK) return false;
+    }
+    if (esp_partition_write(target, flashOffset, data, length) != ESP_OK) return false;
+    unsigned long hashStart = micros();
+    mbedtls_md_update(&imageHash, data, length);
+    unsigned long hashUs = micros() - hashStart;
+    portENTER_CRITICAL(&otaMux);
+    otaStats.hashUs += hashUs;
+    portEXIT_CRITICAL(&otaMux);
+    flashOffset = end;
+    return true;
+}
 
-    HTTPClient http;
-    http.begin(url);
+/**
+ * Compara el SHA-256 de la imagen escrita con el del mensaje y verifica la
+ * firma ECDSA de SHA-256(hash || versión) con ota_public_key. Retorna NULL o
+ * el motivo del rechazo; sin clave configurada solo se compara el hash.
+ */
+static const char* flashVerify(const OtaSignature& check, const char* version) {
+    uint8_t digest[32];
+    if (!imageHashReady || flashOffset != flashSize || mbedtls_md_finish(&imageHash, digest) != 0) {
+        return "imagen incompleta";
+    }
+    if (check.hasDigest && memcmp(digest, check.digest, sizeof(digest)) != 0) return "sha256 distinto";
+    if (ota_public_key[0] == '\0') return NULL;
+    if (check.signatureLength == 0) return "sin firma";
 
-    int httpCode = http.GET();
-    if (httpCode != HTTP_CODE_OK) {
-        Serial.printf("Error HTTP: %d\n", httpCode);
-        http.end();
-        free(otaData->url);
-        free(otaData->version);
-        free(otaData);
-        vTaskDelete(NULL);
-        return;
+    uint8_t message[32];
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    int ret = mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+    if (ret == 0) ret = mbedtls_md_starts(&ctx);
+    if (ret == 0) ret = mbedtls_md_update(&ctx, digest, sizeof(digest));
+    if (ret == 0) ret = mbedtls_md_update(&ctx, (const unsigned char*)version, strlen(version));
+    if (ret == 0) ret = mbedtls_md_finish(&ctx, message);
+    mbedtls_md_free(&ctx);
+
+    mbedtls_pk_context key;
+    mbedtls_pk_init(&key);
+    if (ret == 0) ret = mbedtls_pk_parse_public_key(&key, (const unsigned char*)ota_public_key, strlen(ota_public_key) + 1);
+    if (ret == 0) ret = mbedtls_pk_verify(&key, MBEDTLS_MD_SHA256, message, sizeof(message),
+                                          check.signature, check.signatureLength);
+    mbedtls_pk_free(&key);
+    return ret == 0 ? NULL : "firma invalida";
+}
+
+static bool flashFinish() {
+    return target && flashOffset == flashSize && esp_ota_set_boot_partition(target) == ESP_OK;
+}
+
+
+// Destino de la imagen descargada. Detecta por los primeros bytes si es un
+// firmware plano (se escribe tal cual) o un archivo OTAP (ver libotapatch.h):
+// imagen comprimida con zlib, parche contra la partición en ejecución, o ambos.
+// La descompresión usa tinfl de la ROM con una ventana circular de 32 KB.
+struct OtaSink {
+    bool started;                     // La partición destino ya está abierta (flashBegin)
+    bool patched;                     // El archivo trae cabecera OTAP
+    OtaPatchHeader header;
+    uint8_t headerBytes[OTA_PATCH_HEADER_SIZE];
+    size_t headerLength;
+    size_t contentLength;
+    tinfl_decompressor* inflator;
+    uint8_t* dictionary;
+    size_t dictionaryPos;
+    int inflateStatus;
+    OtaDelta delta;
+    const esp_partition_t* running;
+    bool persist;                     // Guardar el avance en NVS (solo imágenes planas)
+    uint32_t savedOffset;             // Último avance guardado
+    const char* error;
+};
+
+static OtaSink sink;
+
+static bool writeImage(void*, const uint8_t* data, size_t length) {
+    unsigned long start = millis();
+    bool ok = flashWrite(data, length);
+    portENTER_CRITICAL(&otaMux);
+    otaStats.flashMs += millis() - start;
+    if (ok) otaStats.written += length;
+    portEXIT_CRITICAL(&otaMux);
+    if (!ok) {
+        sink.error = "error al escribir en flash";
+    } else if (sink.persist && flashOffset - sink.savedOffset >= OTA_RESUME_SAVE_BYTES) {
+        // En una imagen plana el byte escrito es el byte descargado: tras un
+        // reinicio la descarga sigue desde el último sector completo
+        sink.savedOffset = flashOffset & ~(FLASH_SECTOR - 1);
+        saveOtaResumeOffset(sink.savedOffset);
     }
+    return ok;
+}
 
-    int contentLength = http.getSize();
-    Serial.printf("Tamaño del firmware: %d bytes\n", contentLength);
+static bool readBase(void*, uint32_t offset, uint8_t* out, size_t length) {
+    return esp_partition_read(sink.running, offset, out, length) == ESP_OK;
+}
 
-    if (!Update.begin(contentLength)) {
-        Serial.println("No hay espacio suficiente para la actualización");
-        http.end();
-        free(otaData->url);
-        free(otaData->version);
-        free(otaData);
-        vTaskDelete(NULL);
+static bool emitBody(const uint8_t* data, size_t length) {
+    if (!(sink.header.flags & OTA_PATCH_FLAG_DELTA)) return writeImage(NULL, data, length);
+    if (otaDeltaFeed(&sink.delta, data, length)) return true;
+    if (!sink.error) sink.error = "parche invalido";
+    return false;
+}
+
+/**
+ * Descomprime un bloque del cuerpo y entrega lo que salga. La ventana de 32 KB
+ * es a la vez el buffer de salida (circular) y el diccionario de zlib.
+ */
+static bool inflateBody(const uint8_t* in, size_t length) {
+    for (;;) {
+        if (sink.inflateStatus == TINFL_STATUS_DONE) return length == 0;   // Bytes después del fin del stream
+        size_t inBytes = length;
+        size_t outBytes = TINFL_LZ_DICT_SIZE - sink.dictionaryPos;
+        tinfl_status status = tinfl_decompress(sink.inflator, in, &inBytes, sink.dictionary,
+                                               sink.dictionary + sink.dictionaryPos, &outBytes,
+                                               TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        in += inBytes;
+        length -= inBytes;
+        if (outBytes > 0 && !emitBody(sink.dictionary + sink.dictionaryPos, outBytes)) return false;
+        sink.dictionaryPos = (sink.dictionaryPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+        sink.inflateStatus = status;
+        if (status < TINFL_STATUS_DONE) {
+            sink.error = "zlib invalido";
+            return false;
+        }
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT && length == 0) return true;
+    }
+}
+
+/**
+ * Con la cabecera completa: verifica que la partición en ejecución sea la base
+ * del parche (CRC-32), prepara la descompresión y abre la partición destino.
+ */
+static bool startPatch() {
+    if (!otaPatchParseHeader(sink.headerBytes, &sink.header)) {
+        sink.error = "cabecera OTAP invalida";
+        return false;
+    }
+    if (sink.header.flags & OTA_PATCH_FLAG_DELTA) {
+        sink.running = esp_ota_get_running_partition();
+        if (!sink.running || sink.header.oldSize > sink.running->size) {
+            sink.error = OTA_ERROR_BASE;
+            return false;
+        }
+        uint8_t block[1024];
+        uint32_t crc = 0;
+        for (uint32_t offset = 0; offset < sink.header.oldSize; offset += sizeof(block)) {
+            size_t n = sink.header.oldSize - offset < sizeof(block) ? sink.header.oldSize - offset : sizeof(block);
+            if (!readBase(NULL, offset, block, n)) break;
+            crc = otaCrc32(crc, block, n);
+        }
+        if (crc != sink.header.oldCrc) {
+            Serial.println("La imagen instalada no es la base del parche");
+            sink.error = OTA_ERROR_BASE;
+            return false;
+        }
+        otaDeltaInit(&sink.delta, &sink.header, readBase, writeImage, NULL);
+    }
+    if (sink.header.flags & OTA_PATCH_FLAG_ZLIB) {
+        sink.inflator = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+        sink.dictionary = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+        if (!sink.inflator || !sink.dictionary) {
+            sink.error = "sin memoria";
+            return false;
+        }
+        tinfl_init(sink.inflator);
+        sink.inflateStatus = TINFL_STATUS_NEEDS_MORE_INPUT;
+    }
+    Serial.printf("Imagen OTAP: %s%s, %lu bytes\n", (sink.header.flags & OTA_PATCH_FLAG_DELTA) ? "parche " : "imagen ",
+                  (sink.header.flags & OTA_PATCH_FLAG_ZLIB) ? "zlib" : "sin comprimir", (unsigned long)sink.header.newSize);
+    return true;
+}
+
+/**
+ * Prepara el destino para un archivo de contentLength bytes. Con offset > 0
+ * continúa una imagen plana cuyos primeros offset bytes ya están en flash.
+ */
+static void sinkBegin(size_t contentLength, uint32_t offset, bool persist) {
+    free(sink.inflator);
+    free(sink.dictionary);
+    memset(&sink, 0, sizeof(sink));
+    sink.contentLength = contentLength;
+    sink.persist = persist;
+    sink.savedOffset = offset;
+    if (offset > 0) {
+        sink.header.newSize = contentLength;
+        sink.started = flashBegin(contentLength, offset);
+        if (!sink.started) sink.error = "sin espacio";
+    }
+}
+
+/**
+ * Recibe los bytes descargados en orden. El primer bloque decide el tipo de
+ * archivo y el tamaño con que se abre la partición destino.
+ */
+static bool sinkWrite(const uint8_t* data, size_t length) {
+    if (sink.error) return false;
+    if (!sink.started) {
+        if (sink.headerLength == 0 && !otaPatchIsHeader(data, length)) {
+            sink.header.newSize = sink.contentLength;        // Firmware plano
+        } else {
+            sink.patched = true;
+            sink.persist = false;         // El estado de zlib y del parche no sobrevive a un reinicio
+            size_t n = OTA_PATCH_HEADER_SIZE - sink.headerLength;
+            if (n > length) n = length;
+            memcpy(sink.headerBytes + sink.headerLength, data, n);
+            sink.headerLength += n;
+            data += n;
+            length -= n;
+            if (sink.headerLength < OTA_PATCH_HEADER_SIZE) return true;
+            if (!startPatch()) return false;
+        }
+        if (!flashBegin(sink.header.newSize, 0)) {
+            Serial.println("No hay espacio suficiente para la actualización");
+            sink.error = "sin espacio";
+            return false;
+        }
+        sink.started = true;
+    }
+    if (length == 0) return true;
+    if (!sink.patched) return writeImage(NULL, data, length);
+    if (sink.header.flags & OTA_PATCH_FLAG_ZLIB) return inflateBody(data, length);
+    return emitBody(data, length);
+}
+
+/**
+ * Verifica que el archivo terminó donde debía: stream zlib cerrado y parche
+ * aplicado por completo. flashFinish() valida luego la imagen resultante.
+ */
+static const char* sinkFinish() {
+    const char* error = sink.error;
+    if (!error && !sink.started) error = "archivo incompleto";
+    if (!error && (sink.header.flags & OTA_PATCH_FLAG_ZLIB) && sink.inflateStatus != TINFL_STATUS_DONE) {
+        error = "zlib incompleto";
+    }
+    if (!error && (sink.header.flags & OTA_PATCH_FLAG_DELTA) && !otaDeltaDone(&sink.delta)) {
+        error = "parche incompleto";
+    }
+    free(sink.inflator);
+    free(sink.dictionary);
+    sink.inflator = NULL;
+    sink.dictionary = NULL;
+    return error;
+}
+
+/**
+ * Tarea escritora: pasa cada buffer lleno al destino (descompresión, parche y
+ * flash) y lo devuelve al pool. Tras un error sigue devolviendo buffers (sin
+ * procesarlos) hasta el marcador de fin, para que la descarga no quede bloqueada.
+ */
+static void otaWriterTask(void*) {
+    OtaBuffer* buffer;
+    while (xQueueReceive(fullBuffers, &buffer, portMAX_DELAY) == pdTRUE && buffer != nullptr) {
+        if (!writerFailed && !sinkWrite(buffer->data, buffer->length)) {
+            writerFailed = true;
+        }
+        xQueueSend(freeBuffers, &buffer, portMAX_DELAY);
+    }
+    xSemaphoreGive(writerDone);
+    vTaskDelete(NULL);
+}
+
+static void pipelineBegin(OtaBuffer** pool) {
+    for (int i = 0; i < OTA_PIPELINE_BUFFERS; i++) {
+        xQueueSend(freeBuffers, &pool[i], 0);
+    }
+    writerFailed = false;
+    xTaskCreatePinnedToCore(otaWriterTask, "OTA_Writer", OTA_WRITER_TASK_STACK, NULL, 2, NULL, 1);
+}
+
+static void pipelineEnd() {
+    OtaBuffer* end = nullptr;
+    xQueueSend(fullBuffers, &end, portMAX_DELAY);
+    xSemaphoreTake(writerDone, portMAX_DELAY);     // El destino terminó con todo lo recibido
+}
+
+/**
+ * Bloquea hasta que el socket de stream tenga datos o pasen timeoutMs, sin
+ * sondear available() en cada tick. Si el cliente no expone su socket (TLS),
+ * cede la CPU un tick como antes.
+ */
+static void waitReadable(WiFiClient* stream, uint32_t timeoutMs) {
+    int fd = stream->fd();
+    if (fd < 0) {
+        vTaskDelay(1);
         return;
     }
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(fd, &readable);
+    struct timeval tv = { (time_t)(timeoutMs / 1000), (suseconds_t)((timeoutMs % 1000) * 1000) };
+    select(fd + 1, &readable, NULL, NULL, &tv);
+}
+
+/**
+ * Pasa al pipeline lo que llegue por stream hasta completar total bytes.
+ * Retorna NULL al terminar (o si falló el destino; ver sink.error),
+ * OTA_ERROR_LINK si se cerró la conexión y OTA_ERROR_STALL si no llegaron
+ * datos en OTA_STALL_TIMEOUT_MS. received queda en el byte desde el que reanudar.
+ * Con límite de velocidad, leer más lento deja que TCP frene al servidor.
+ */
+static const char* receiveStream(WiFiClient* stream, size_t* received, size_t total, unsigned long started) {
+    const char* error = NULL;
+    unsigned long lastData = millis();
+    while (*received < total && !error && !writerFailed) {
+        OtaBuffer* buffer;
+        unsigned long waitStart = millis();
+        xQueueReceive(freeBuffers, &buffer, portMAX_DELAY);
+        unsigned long backpressure = millis() - waitStart;
+        lastData += backpressure;            // Esperar a la flash no cuenta como red detenida
 
-    uint8_t buff[OTA_BUFFER_SIZE] = { 0 };
-    WiFiClient* stream = http.getStreamPtr();
-
-    size_t written = 0;
-    while (written < contentLength) {
-        size_t available = stream->available();
-        if (available) {
-            size_t bytesToRead = min(available, sizeof(buff));
-            size_t bytesRead = stream->readBytes(buff, bytesToRead);
-            
-            if (Update.write(buff, bytesRead) != bytesRead) {
-                Serial.println("Error al escribir en la memoria flash");
-                http.end();
-                free(otaData->url);
-                free(otaData->version);
-                free(otaData);
-                vTaskDelete(NULL);
-                return;
+        buffer->length = 0;
+        unsigned long stall = 0;
+        unsigned long throttle = 0;
+        while (buffer->length < OTA_BUFFER_SIZE && *received < total) {
+            size_t available = stream->available();
+            if (available == 0) {
+                if (!stream->connected()) {
+                    error = OTA_ERROR_LINK;
+                    break;
+                }
+                if (millis() - lastData > OTA_STALL_TIMEOUT_MS) {
+                    error = OTA_ERROR_STALL;
+                    break;
+                }
+                unsigned long stallStart = millis();
+                waitReadable(stream, OTA_READ_WAIT_MS); // Duerme en el socket mientras llegan datos
+                stall += millis() - stallStart;
+                continue;
+            }
+            size_t toRead = OTA_BUFFER_SIZE - buffer->length;
+            if (toRead > available) toRead = available;
+            if (toRead > total - *received) toRead = total - *received;
+            size_t n = stream->readBytes(buffer->data + buffer->length, toRead);
+            buffer->length += n;
+            *received += n;
+            uint32_t wait = rateLimitWaitMs(&downloadLimit, n, millis());
+            if (wait > 0) {
+                vTaskDelay(pdMS_TO_TICKS(wait));
+                throttle += wait;
             }
-            written += bytesRead;
+            if (n > 0) lastData = millis();
+        }
+
+        portENTER_CRITICAL(&otaMux);
+        otaStats.received = *received;
+        otaStats.backpressureMs += backpressure;
+        otaStats.networkStallMs += stall;
+        otaStats.throttleMs += throttle;
+        otaStats.elapsedMs = millis() - started;
+        portEXIT_CRITICAL(&otaMux);
+
+        if (buffer->length > 0) {
+            xQueueSend(fullBuffers, &buffer, portMAX_DELAY);
+        } else {
+            xQueueSend(freeBuffers, &buffer, portMAX_DELAY);
         }
-        delay(1);  // respirito para el watchdog
     }
+    return error;
+}
 
-    if (Update.end()) {
-        Serial.println("Actualización completada correctamente");
-        
-        // Guardar la nueva versión en memoria no volátil antes de reiniciar
-        Serial.print("Guardando nueva versión en memoria no volátil: ");
-        Serial.println(version);
-        if (saveFirmwareVersion(String(version))) {
-            Serial.println("✓ Versión guardada correctamente");
+static void waitForWiFi() {
+    unsigned long start = millis();
+    while (WiFi.status() != WL_CONNECTED && millis() - start < OTA_RESUME_WIFI_WAIT_MS) {
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+}
+
+/**
+ * Descarga url y la escribe en la partición OTA a través del pipeline. Si la
+ * conexión se cae o se detiene, la retoma con Range desde el último byte
+ * recibido (If-Range garantiza que el archivo no cambió), hasta
+ * OTA_RESUME_ATTEMPTS veces. Con resume, el avance de una imagen plana se
+ * guarda en NVS y offset es el byte desde el que seguir tras un reinicio.
+ * Retorna NULL si la imagen quedó completa, con el hash y la firma de
+ * otaData->check, y marcada como partición de arranque.
+ */
+static const char* downloadFirmware(const char* url, const OTAData* otaData, OtaResumeState* resume, uint32_t offset) {
+    static const char* headerKeys[] = { "ETag", "Last-Modified", "Content-Range" };
+    const char* error = NULL;
+    OtaBuffer* pool[OTA_PIPELINE_BUFFERS] = { NULL };
+    for (int i = 0; i < OTA_PIPELINE_BUFFERS && !error; i++) {
+        pool[i] = (OtaBuffer*)malloc(sizeof(OtaBuffer));
+        if (!pool[i]) error = "sin memoria";
+    }
+    if (!freeBuffers) freeBuffers = xQueueCreate(OTA_PIPELINE_BUFFERS, sizeof(OtaBuffer*));
+    if (!fullBuffers) fullBuffers = xQueueCreate(OTA_PIPELINE_BUFFERS + 1, sizeof(OtaBuffer*));
+    if (!writerDone) writerDone = xSemaphoreCreateBinary();
+
+    // El avance guardado solo vale para el mismo archivo en la misma partición
+    const esp_partition_t* next = esp_ota_get_next_update_partition(NULL);
+    if (!resume || !next || resume->partition != next->address || resume->size == 0) offset = 0;
+    char validator[sizeof(resume->validator)] = "";
+    if (offset > 0) strcpy(validator, resume->validator);
+    size_t total = offset > 0 ? resume->size : 0;
+    size_t received = offset;
+    bool running = false;                  // El pipeline ya está recibiendo este archivo
+    unsigned long started = millis();
+    rateLimitInit(&downloadLimit, otaData->rollout.bytesPerSecond, ROLLOUT_BURST_BYTES, started);
+    portENTER_CRITICAL(&otaMux);
+    otaStats.total = total;
+    otaStats.received = received;
+    otaStats.resumedFrom = offset;
+    portEXIT_CRITICAL(&otaMux);
+
+    for (int attempt = 0; !error; attempt++) {
+        HTTPClient http;
+        http.begin(url);
+        http.collectHeaders(headerKeys, 3);
+        if (received > 0) {
+            http.addHeader("Range", "bytes=" + String((unsigned long)received) + "-");
+            if (validator[0]) http.addHeader("If-Range", validator);
+        }
+        int httpCode = http.GET();
+        const char* attemptError = NULL;
+        if (httpCode == HTTP_CODE_OK && received > 0 && !running) {
+            Serial.println("El servidor no reanudó la descarga guardada; se empieza de cero");
+            received = offset = 0;
+        }
+        if (httpCode == HTTP_CODE_OK && received == 0) {
+            int size = http.getSize();
+            if (size <= 0) error = "tamano desconocido";
+            total = size > 0 ? size : 0;
+            // If-Range solo admite ETag fuertes; si no hay, se usa Last-Modified
+            String tag = http.header("ETag");
+            if (tag.length() == 0 || tag.startsWith("W/")) tag = http.header("Last-Modified");
+            if (tag.length() >= sizeof(validator)) tag = "";
+            strcpy(validator, tag.c_str());
+        } else if (httpCode == HTTP_CODE_PARTIAL_CONTENT && received > 0) {
+            unsigned long first = 0, size = 0;
+            if (sscanf(http.header("Content-Range").c_str(), "bytes %lu-%*u/%lu", &first, &size) != 2 ||
+                first != received || size != total) {
+                error = "rango invalido";
+            }
+        } else if (httpCode == HTTP_CODE_OK) {
+            error = "el archivo cambio";      // If-Range no coincidió a mitad de la descarga
+        } else if (httpCode < 0 || httpCode >= 500) {
+            attemptError = OTA_ERROR_LINK;
         } else {
-            Serial.println("⚠ Error al guardar la versión (continuando igualmente)");
+            Serial.printf("Error HTTP: %d\n", httpCode);
+            error = "error HTTP";
+        }
+
+        if (!error && !attemptError && !running) {
+            Serial.printf("Tamaño de la descarga: %lu bytes", (unsigned long)total);
+            if (received > 0) Serial.printf(", reanudada desde %lu", (unsigned long)received);
+            Serial.println();
+            if (resume && received == 0) {
+                // Identidad del archivo antes de escribir el primer byte
+                resume->size = total;
+                resume->partition = next ? next->address : 0;
+                strcpy(resume->validator, validator);
+                saveOtaResume(*resume);
+            }
+            portENTER_CRITICAL(&otaMux);
+            otaStats.total = total;
+            otaStats.received = received;
+            portEXIT_CRITICAL(&otaMux);
+            sinkBegin(total, received, resume != NULL);
+            pipelineBegin(pool);
+            running = true;
+        }
+        if (!error && !attemptError) {
+            attemptError = receiveStream(http.getStreamPtr(), &received, total, started);
         }
-        
-        http.end();
-        free(otaData->url);
-        free(otaData->version);
-        free(otaData);
-        delay(1000);
-        ESP.restart();
-    } else {
-        Serial.println("Error al finalizar la actualización: " + String(Update.errorString()));
         http.end();
-        free(otaData->url);
-        free(otaData->version);
-        free(otaData);
+        if (error || !attemptError) break;
+        if (attempt + 1 >= OTA_RESUME_ATTEMPTS) {
+            error = attemptError;
+            break;
+        }
+        Serial.printf("Descarga interrumpida (%s) en %lu de %lu bytes; reanudando\n", attemptError,
+                      (unsigned long)received, (unsigned long)total);
+        portENTER_CRITICAL(&otaMux);
+        otaStats.resumes++;
+        portEXIT_CRITICAL(&otaMux);
+        waitForWiFi();
+        vTaskDelay(pdMS_TO_TICKS(1000UL << (attempt < 4 ? attempt : 4)));
+    }
+
+    if (running) {
+        pipelineEnd();
+        const char* sinkError = sinkFinish();
+        if (!error) error = sinkError;
+    }
+    portENTER_CRITICAL(&otaMux);
+    otaStats.elapsedMs = millis() - started;
+    portEXIT_CRITICAL(&otaMux);
+    if (freeBuffers) xQueueReset(freeBuffers);
+    for (int i = 0; i < OTA_PIPELINE_BUFFERS; i++) free(pool[i]);
+    if (!error) error = flashVerify(otaData->check, otaData->version);
+    if (!error && !flashFinish()) {
+        Serial.println("La imagen descargada no es válida");
+        error = "imagen invalida";
+    }
+    return error;
+}
+
+/**
+ * Función que ejecuta la OTA (en otro hilo).
+ * Si hay un parche para la versión instalada o una imagen comprimida se
+ * intenta primero; si falla por cualquier motivo se descarga la imagen completa.
+ * El progreso queda en getOTAStats() y libiot lo publica por MQTT.
+ */
+void performOTAUpdateTask(void* parameter) {
+    OTAData* otaData = (OTAData*)parameter;
+    const char* version = otaData->version;
+
+    Serial.println("Nueva versión: " + String(version));
+
+    // Turno dentro de la ventana del despliegue, para no descargar todos a la vez
+    if (otaData->rollout.delayMs > 0) {
+        Serial.printf("Descarga programada en %lu s (cohorte %u)\n", (unsigned long)(otaData->rollout.delayMs / 1000),
+                      otaData->rollout.cohort);
+        // En tramos: pdMS_TO_TICKS multiplica por la frecuencia del tick y desborda pasados ~4 294 967 ms (71 min)
+        for (uint32_t left = otaData->rollout.delayMs; left > 0;) {
+            uint32_t chunk = left < OTA_ROLLOUT_SLEEP_MS ? left : OTA_ROLLOUT_SLEEP_MS;
+            vTaskDelay(pdMS_TO_TICKS(chunk));
+            left -= chunk;
+        }
+        setOTAState(OTA_STATE_DOWNLOADING, NULL);
+    }
+
+    // Si es la misma actualización que quedó a medias se sigue desde el avance
+    // guardado; si no, el registro en NVS pasa a ser el de esta
+    OtaResumeState resume;
+    uint32_t offset = 0;
+    bool persist = true;
+    if (!loadOtaResume(resume, offset) || strcmp(resume.url, otaData->url) != 0 || strcmp(resume.version, version) != 0) {
+        memset(&resume, 0, sizeof(resume));
+        strncpy(resume.url, otaData->url, sizeof(resume.url) - 1);
+        strncpy(resume.version, version, sizeof(resume.version) - 1);
+        resume.check = otaData->check;
+        resume.rateLimit = otaData->rollout.bytesPerSecond;
+        offset = 0;
+        persist = strlen(otaData->url) < sizeof(resume.url) && strlen(version) < sizeof(resume.version) &&
+                  saveOtaResume(resume);
+        if (!persist) Serial.println("⚠ No se pudo guardar el avance de la OTA; no se reanudará tras reiniciar");
+    }
+
+    // El parche o la imagen comprimida son opcionales y no se reanudan: si fallan
+    // por cualquier motivo (base distinta, 404, 5xx, red caída o detenida, parche
+    // o zlib inválido, SHA-256 distinto) se descarga en esta misma tarea la imagen
+    // completa, que es la única que se reanuda al reconectar o tras reiniciar.
+    // Si ya hay avance guardado es de la imagen completa
+    const char* error = NULL;
+    bool full = true;
+    if (otaData->deltaUrl && offset == 0) {
+        Serial.println("Iniciando actualización OTA (OTAP) desde: " + String(otaData->deltaUrl));
+        error = downloadFirmware(otaData->deltaUrl, otaData, NULL, 0);
+        full = error != NULL;
+        if (full) Serial.printf("Imagen OTAP fallida (%s); se descarga la imagen completa\n", error);
+    }
+    if (full) {
+        Serial.println("Iniciando actualización OTA desde: " + String(otaData->url));
+        error = downloadFirmware(otaData->url, otaData, persist ? &resume : NULL, offset);
+    }
+
+    if (error) {
+        Serial.printf("✗ Actualización OTA fallida: %s\n", error);
+        if (error == OTA_ERROR_LINK || error == OTA_ERROR_STALL) {
+            Serial.println("El avance queda guardado; se reanudará al reconectar");
+        } else {
+            clearOtaResume();
+        }
+        setOTAState(OTA_STATE_FAILED, error);
+        freeOTAData(otaData);
         vTaskDelete(NULL);
+        return;
+    }
+
+    OtaStats stats = getOTAStats();
+    Serial.printf("Actualización completada correctamente: %lu bytes descargados, imagen de %lu bytes en %lu ms (red %lu ms, flash %lu ms)\n",
+                  (unsigned long)stats.received, (unsigned long)stats.written, (unsigned long)stats.elapsedMs,
+                  (unsigned long)stats.networkStallMs, (unsigned long)stats.flashMs);
+    Serial.printf("SHA-256 de la imagen: %lu us en total, %lu us por bloque de 4 KB\n", (unsigned long)stats.hashUs,
+                  (unsigned long)(stats.written ? (uint64_t)stats.hashUs * 4096 / stats.written : 0));
+
+    clearOtaResume();
+
+    // Guardar la nueva versión en memoria no volátil antes de reiniciar
+    Serial.print("Guardando nueva versión en memoria no volátil: ");
+    Serial.println(version);
+    if (saveFirmwareVersion(String(version))) {
+        Serial.println("✓ Versión guardada correctamente");
+    } else {
+        Serial.println("⚠ Error al guardar la versión (continuando igualmente)");
     }
+    setOTAState(OTA_STATE_DONE, NULL);
+    freeOTAData(otaData);
+    delay(1000);                // Da tiempo a publicar el estado final
+    ESP.restart();
 }
@@ -27,24 +27,96 @@
 
 #include <Arduino.h>
 #include <HTTPClient.h>
-#include <Update.h>
 #include <ArduinoJson.h>
 #include <PubSubClient.h>
 
 // Constantes para OTA
-#define OTA_TOPIC "dispositivo/device1/ota"  // Tópico para recibir actualizaciones OTA
-#define OTA_BUFFER_SIZE 4096                 // Tamaño del buffer para descargar firmware
+#define OTA_BUFFER_SIZE 4096                 // Tamaño de cada buffer del pipeline (un sector de flash)
+#define OTA_PIPELINE_BUFFERS 4               // Buffers entre la tarea que descarga y la que escribe en flash
+#define OTA_RECEIVE_TASK_STACK 8192          // Pila de la tarea que descarga (HTTP + TLS)
+#define OTA_WRITER_TASK_STACK 6144           // Pila de la tarea que descomprime, aplica parches y escribe en flash
+#define OTA_STATUS_INTERVAL_MS 2000          // Periodo del estado publicado durante la descarga
+#ifndef OTA_STALL_TIMEOUT_MS
+#define OTA_STALL_TIMEOUT_MS 15000           // Sin datos durante este tiempo se corta la conexión y se reanuda
+#endif
+#define OTA_READ_WAIT_MS 100                 // Espera máxima en el socket por datos antes de revisar conexión y estancamiento
+#ifndef OTA_RESUME_ATTEMPTS
+#define OTA_RESUME_ATTEMPTS 8                // Reconexiones por actualización; luego se reanuda al volver MQTT o tras reiniciar
+#endif
+#define OTA_RESUME_SAVE_BYTES 65536          // Cada cuántos bytes escritos se guarda el avance en NVS
+#define OTA_RESUME_WIFI_WAIT_MS 60000        // Espera máxima a que vuelva el WiFi antes de cada reintento
+#define OTA_ROLLOUT_SLEEP_MS 60000           // Tramo máximo de la espera del despliegue escalonado
+#define OTA_SIGNATURE_MAX 72                 // Firma ECDSA P-256 en DER
+
+// Estado de la actualización
+enum OtaState {
+    OTA_STATE_IDLE,         // Sin actualización en curso
+    OTA_STATE_WAITING,      // En la cohorte del despliegue; esperando su turno en la ventana
+    OTA_STATE_DOWNLOADING,  // Descargando y escribiendo en flash
+    OTA_STATE_DONE,         // Imagen verificada; el dispositivo se reinicia
+    OTA_STATE_FAILED,       // La última actualización falló (ver error)
+    OTA_STATE_SKIPPED       // El dispositivo no está en el porcentaje del despliegue
+};
+
+// Progreso y tiempos de la actualización. Los tiempos de espera separan la red
+// lenta (sin datos disponibles) de la flash lenta (sin buffers libres).
+struct OtaStats {
+    OtaState state;
+    uint32_t sequence;        // Cambia con cada cambio de estado
+    uint32_t total;           // Tamaño de la descarga (Content-Length)
+    uint32_t received;        // Bytes descargados
+    uint32_t imageSize;       // Tamaño de la imagen resultante (mayor que total si es comprimida o parche)
+    uint32_t written;         // Bytes escritos en flash
+    uint32_t elapsedMs;       // Duración desde el inicio de la descarga
+    uint32_t networkStallMs;  // Tiempo esperando datos de la red
+    uint32_t backpressureMs;  // Tiempo esperando un buffer libre (flash más lenta que la red)
+    uint32_t flashMs;         // Tiempo borrando y escribiendo la partición
+    uint32_t hashUs;          // Tiempo calculando el SHA-256 de la imagen (incluido en flashMs)
+    uint32_t resumes;         // Reconexiones con HTTP Range durante esta actualización
+    uint32_t resumedFrom;     // Byte desde el que se reanudó tras un reinicio (0 si empezó de cero)
+    uint32_t startDelayMs;    // Retardo asignado dentro de la ventana del despliegue
+    uint32_t rateLimit;       // Límite de descarga en bytes/s (0 = sin límite)
+    uint32_t throttleMs;      // Tiempo esperando por el límite de descarga
+    uint8_t cohort;           // Cohorte 0..99 del dispositivo en el despliegue
+    char version[24];
+    char error[48];
+};
+
+// Integridad esperada de la imagen resultante, del mensaje OTA ("sha256" y
+// "sig"). La firma es ECDSA P-256 sobre SHA-256(sha256 de la imagen || versión)
+// y se verifica con ota_public_key (ver scripts/sign_ota.py).
+struct OtaSignature {
+    bool hasDigest;
+    uint8_t digest[32];
+    uint8_t signature[OTA_SIGNATURE_MAX];
+    uint8_t signatureLength;  // 0 si el mensaje no trae firma
+};
+
+// Controles de despliegue del mensaje OTA ya resueltos para este dispositivo (ver librollout.h)
+struct OtaRollout {
+    uint32_t delayMs;         // Espera antes de empezar la descarga
+    uint32_t bytesPerSecond;  // Límite de velocidad de descarga (0 = sin límite)
+    uint8_t cohort;           // Cohorte del dispositivo, para el estado publicado
+};
 
 // Estructura para pasar datos a la tarea OTA
 struct OTAData {
     char* url;
     char* version;
+    char* deltaUrl;           // Parche o imagen comprimida a probar antes de url (NULL si no hay)
+    OtaSignature check;
+    OtaRollout rollout;
 };
 
 // Funciones para OTA
 void setupOTA(PubSubClient & client);                            // Configuración inicial de OTA
-void checkOTAUpdate(const char* payload);   // Verifica si hay actualizaciones disponibles
+void checkOTAUpdate(char* payload, size_t length); // Verifica si hay actualizaciones disponibles (payload sin terminador, se modifica)
+void otaMessageHandler(const char* topic, uint8_t* payload, size_t length); // Handler de OTA_TOPIC para libdispatch
 void performOTAUpdateTask(void* parameter); // Función que ejecuta la OTA (en otro hilo)
 void subscribeToOTATopic(PubSubClient & client);                 // Suscribe al tópico de OTA
-void startOTATask(const char* url, const char* version); // Lanza la tarea OTA en otro núcleo
+void startOTATask(const char* url, const char* version, const char* deltaUrl = NULL,
+                  const OtaSignature* check = NULL, const OtaRollout* rollout = NULL); // Lanza la tarea OTA en otro núcleo
+bool resumePendingOTA();                    // Relanza la descarga guardada en NVS, si quedó una a medias
+OtaStats getOTAStats();                     // Copia del progreso de la actualización en curso o de la última
+size_t otaStatusJson(const OtaStats & stats, char* out, size_t size); // Codifica el progreso como JSON; 0 si no cabe
 #endif /* LIBOTA_H */
@@ -0,0 +1,167 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <libotapatch.h>
+
+static uint32_t readLe32(const uint8_t * p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool otaPatchIsHeader(const uint8_t * data, size_t length) {
+  return length >= 4 && memcmp(data, "OTAP", 4) == 0;
+}
+
+bool otaPatchParseHeader(const uint8_t * data, OtaPatchHeader * header) {
+  if (!otaPatchIsHeader(data, OTA_PATCH_HEADER_SIZE)) return false;
+  header->version = data[4];
+  header->flags = data[5];
+  header->newSize = readLe32(data + 8);
+  header->oldSize = readLe32(data + 12);
+  header->oldCrc = readLe32(data + 16);
+  return header->version == OTA_PATCH_VERSION && header->newSize > 0;
+}
+
+/**
+ * CRC-32 (polinomio reflejado 0xEDB88320) con tabla de 16 entradas: 64 bytes
+ * de tabla en lugar de 1 KB, suficiente para verificar la base una vez por OTA.
+ */
+uint32_t otaCrc32(uint32_t crc, const uint8_t * data, size_t length) {
+  static const uint32_t table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+void otaDeltaInit(OtaDelta * delta, const OtaPatchHeader * header, OtaReadBase readBase,
+                  OtaWriteImage writeImage, void * context) {
+  memset(delta, 0, sizeof(*delta));
+  delta->stage = OTA_DELTA_CONTROL;
+  delta->oldSize = header->oldSize;
+  delta->newSize = header->newSize;
+  delta->readBase = readBase;
+  delta->writeImage = writeImage;
+  delta->context = context;
+}
+
+/**
+ * Suma los bytes diff a la imagen base. Fuera de la base se toma 0, como bsdiff.
+ */
+static bool applyDiff(OtaDelta * delta, const uint8_t * data, size_t length) {
+  uint8_t base[OTA_PATCH_CHUNK];
+  size_t first = 0;                 // Bytes iniciales que caen antes de la base
+  size_t inside = 0;                // Bytes dentro de [0, oldSize)
+  if (delta->oldPos < 0) {
+    first = (size_t)(-delta->oldPos) < length ? (size_t)(-delta->oldPos) : length;
+  }
+  int64_t start = delta->oldPos + (int64_t)first;
+  if (start < (int64_t)delta->oldSize) {
+    int64_t available = (int64_t)delta->oldSize - start;
+    inside = (int64_t)(length - first) < available ? length - first : (size_t)available;
+  }
+  memset(base, 0, length);
+  if (inside > 0 && !delta->readBase(delta->context, (uint32_t)start, base + first, inside)) return false;
+  for (size_t i = 0; i < length; i++) base[i] += data[i];
+  delta->oldPos += (int64_t)length;
+  return delta->writeImage(delta->context, base, length);
+}
+
+bool otaDeltaFeed(OtaDelta * delta, const uint8_t * data, size_t length) {
+  while (length > 0 && delta->stage != OTA_DELTA_ERROR) {
+    size_t n;
+    switch (delta->stage) {
+      case OTA_DELTA_CONTROL:
+        n = sizeof(delta->control) - delta->controlLength;
+        if (n > length) n = length;
+        memcpy(delta->control + delta->controlLength, data, n);
+        delta->controlLength += n;
+        if (delta->controlLength == sizeof(delta->control)) {
+          delta->diffLeft = readLe32(delta->control);
+          delta->extraLeft = readLe32(delta->control + 4);
+          delta->seek = (int32_t)readLe32(delta->control + 8);
+          delta->controlLength = 0;
+          if ((uint64_t)delta->newPos + delta->diffLeft + delta->extraLeft > delta->newSize) {
+            delta->stage = OTA_DELTA_ERROR;   // El registro escribiría más allá de la imagen
+            return false;
+          }
+          if (delta->diffLeft > 0) {
+            delta->stage = OTA_DELTA_DIFF;
+          } else if (delta->extraLeft > 0) {
+            delta->stage = OTA_DELTA_EXTRA;
+          } else {
+            delta->oldPos += delta->seek;     // Registro vacío: solo mueve la posición base
+          }
+        }
+        break;
+      case OTA_DELTA_DIFF:
+        n = delta->diffLeft < OTA_PATCH_CHUNK ? delta->diffLeft : OTA_PATCH_CHUNK;
+        if (n > length) n = length;
+        if (n > 0 && !applyDiff(delta, data, n)) {
+          delta->stage = OTA_DELTA_ERROR;
+          return false;
+        }
+        delta->diffLeft -= n;
+        delta->newPos += n;
+        if (delta->diffLeft == 0) {
+          if (delta->extraLeft > 0) {
+            delta->stage = OTA_DELTA_EXTRA;
+          } else {
+            delta->oldPos += delta->seek;
+            delta->stage = OTA_DELTA_CONTROL;
+          }
+        }
+        break;
+      case OTA_DELTA_EXTRA:
+        n = delta->extraLeft;
+        if (n > length) n = length;
+        if (n > 0 && !delta->writeImage(delta->context, data, n)) {
+          delta->stage = OTA_DELTA_ERROR;
+          return false;
+        }
+        delta->extraLeft -= n;
+        delta->newPos += n;
+        if (delta->extraLeft == 0) {
+          delta->oldPos += delta->seek;
+          delta->stage = OTA_DELTA_CONTROL;
+        }
+        break;
+      default:
+        return false;
+    }
+    data += n;
+    length -= n;
+  }
+  return delta->stage != OTA_DELTA_ERROR;
+}
+
+bool otaDeltaDone(const OtaDelta * delta) {
+  return delta->stage == OTA_DELTA_CONTROL && delta->controlLength == 0 && delta->newPos == delta->newSize;
+}
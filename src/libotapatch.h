@@ -0,0 +1,95 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBOTAPATCH_H
+#define LIBOTAPATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Imágenes OTA comprimidas y parches binarios. No depende de Arduino: la
+// lectura de la imagen actual y la escritura de la nueva se hacen con
+// callbacks, así que el mismo código aplica parches sobre la partición en el
+// dispositivo o sobre un archivo en el host. Los genera scripts/make_ota_patch.py.
+//
+// Archivo: cabecera de 20 bytes (little endian) seguida del cuerpo.
+//   "OTAP" | versión (1) | banderas | reservado (2) | tamaño nuevo (4)
+//   | tamaño base (4) | CRC-32 de la imagen base (4)
+// Con OTA_PATCH_FLAG_ZLIB el cuerpo es un stream zlib; al descomprimirlo
+// queda la imagen nueva o, con OTA_PATCH_FLAG_DELTA, una serie de registros
+// al estilo bsdiff:
+//   diffLen (u32) | extraLen (u32) | seek (i32) | diffLen bytes | extraLen bytes
+// Los bytes diff se suman (mod 256) a la imagen base desde la posición actual;
+// los extra se copian tal cual; seek mueve la posición en la base.
+// Una imagen sin cabecera (primer byte 0xE9) se trata como firmware plano.
+
+#define OTA_PATCH_HEADER_SIZE 20    ///< Bytes de la cabecera
+#define OTA_PATCH_VERSION 1         ///< Versión del formato
+#define OTA_PATCH_FLAG_ZLIB 0x01    ///< El cuerpo está comprimido con zlib
+#define OTA_PATCH_FLAG_DELTA 0x02   ///< El cuerpo es un parche contra la imagen base
+#define OTA_PATCH_CHUNK 256         ///< Bytes de la imagen base leídos por llamada
+
+struct OtaPatchHeader {
+  uint8_t version;                  ///< OTA_PATCH_VERSION
+  uint8_t flags;                    ///< OTA_PATCH_FLAG_*
+  uint32_t newSize;                 ///< Tamaño de la imagen resultante
+  uint32_t oldSize;                 ///< Tamaño de la imagen base (solo parches)
+  uint32_t oldCrc;                  ///< CRC-32 de los oldSize primeros bytes de la base
+};
+
+typedef bool (*OtaReadBase)(void * context, uint32_t offset, uint8_t * out, size_t length); ///< Lee la imagen base
+typedef bool (*OtaWriteImage)(void * context, const uint8_t * data, size_t length); ///< Escribe la imagen nueva
+
+enum OtaDeltaStage {
+  OTA_DELTA_CONTROL,                ///< Acumulando los 12 bytes de control
+  OTA_DELTA_DIFF,                   ///< Aplicando bytes diff
+  OTA_DELTA_EXTRA,                  ///< Copiando bytes extra
+  OTA_DELTA_ERROR                   ///< Parche inválido o error de lectura/escritura
+};
+
+struct OtaDelta {
+  OtaDeltaStage stage;
+  uint8_t control[12];              ///< Registro de control en construcción
+  uint8_t controlLength;
+  uint32_t diffLeft;                ///< Bytes diff pendientes del registro actual
+  uint32_t extraLeft;               ///< Bytes extra pendientes del registro actual
+  int32_t seek;                     ///< Ajuste de la posición base al terminar el registro
+  int64_t oldPos;                   ///< Posición en la imagen base
+  uint32_t newPos;                  ///< Bytes de la imagen nueva ya escritos
+  uint32_t oldSize;
+  uint32_t newSize;
+  OtaReadBase readBase;
+  OtaWriteImage writeImage;
+  void * context;
+};
+
+bool otaPatchIsHeader(const uint8_t * data, size_t length); ///< true si data empieza con "OTAP"
+bool otaPatchParseHeader(const uint8_t * data, OtaPatchHeader * header); ///< Decodifica los 20 bytes; false si la versión no es compatible
+uint32_t otaCrc32(uint32_t crc, const uint8_t * data, size_t length); ///< CRC-32 (el de zlib); empezar con crc = 0
+void otaDeltaInit(OtaDelta * delta, const OtaPatchHeader * header, OtaReadBase readBase,
+                  OtaWriteImage writeImage, void * context); ///< Prepara la aplicación de un parche
+bool otaDeltaFeed(OtaDelta * delta, const uint8_t * data, size_t length); ///< Aplica bytes del parche (ya descomprimidos), en bloques de cualquier tamaño
+bool otaDeltaDone(const OtaDelta * delta); ///< true si se escribió la imagen completa y no quedó un registro a medias
+
+#endif /* LIBOTAPATCH_H */
@@ -0,0 +1,127 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <libpms7003.h>
+#include <string.h>
+
+void pmsParserInit(Pms7003Parser * p) {
+  memset(p, 0, sizeof(*p));
+}
+
+static uint16_t be16(const uint8_t * b) {
+  return (uint16_t)((b[0] << 8) | b[1]);
+}
+
+/**
+ * Valida la trama completa y, si es correcta, la decodifica en p->latest.
+ */
+static bool finishFrame(Pms7003Parser * p) {
+  uint16_t sum = 0;
+  for (int i = 0; i < PMS7003_FRAME_SIZE - 2; i++) sum += p->frame[i];
+  if (sum != be16(&p->frame[PMS7003_FRAME_SIZE - 2])) {
+    p->stats.checksumErrors++;
+    return false;
+  }
+  const uint8_t * d = &p->frame[4];
+  PMS7003Data & out = p->latest;
+  out.pm1_0_cf1   = be16(d + 0);
+  out.pm2_5_cf1   = be16(d + 2);
+  out.pm10_cf1    = be16(d + 4);
+  out.pm1_0_atm   = be16(d + 6);
+  out.pm2_5_atm   = be16(d + 8);
+  out.pm10_atm    = be16(d + 10);
+  out.num_part_03 = be16(d + 12);
+  out.num_part_05 = be16(d + 14);
+  out.num_part_1  = be16(d + 16);
+  out.num_part_25 = be16(d + 18);
+  out.num_part_5  = be16(d + 20);
+  out.num_part_10 = be16(d + 22);
+  p->fresh = true;
+  p->stats.frames++;
+  return true;
+}
+
+/**
+ * Avanza un byte. Retorna 1 si completó una trama válida, 0 si no y -1 si la
+ * trama en construcción se rechazó; en ese caso sus p->pos bytes siguen en
+ * p->frame para volver a examinarlos.
+ */
+static int step(Pms7003Parser * p, uint8_t b) {
+  if (p->pos == 0) {
+    if (b != 0x42) {
+      if (!p->skipping) p->stats.resyncs++;
+      p->skipping = true;
+      return 0;
+    }
+    p->skipping = false;
+  }
+  p->frame[p->pos++] = b;
+  if (p->pos == 2 && b != 0x4D) return -1;
+  if (p->pos == 4 && be16(p->frame + 2) != PMS7003_FRAME_LENGTH) {
+    p->stats.lengthErrors++;
+    return -1;
+  }
+  if (p->pos < PMS7003_FRAME_SIZE) return 0;
+  if (!finishFrame(p)) return -1;
+  p->pos = 0;
+  return 1;
+}
+
+size_t pmsParserFeed(Pms7003Parser * p, const uint8_t * data, size_t len) {
+  size_t frames = 0;
+  // Bytes por procesar: el de la entrada más los de tramas rechazadas, cuya
+  // cabecera real puede estar más adelante. Entre esta cola y p->frame nunca
+  // hay más de PMS7003_FRAME_SIZE + 1 bytes, así que no hace falta más espacio.
+  uint8_t queue[PMS7003_FRAME_SIZE + 1];
+  for (size_t i = 0; i < len; i++) {
+    p->stats.bytes++;
+    size_t head = 0, count = 1;
+    queue[0] = data[i];
+    while (head < count) {
+      int r = step(p, queue[head++]);
+      if (r > 0) {
+        frames++;
+      } else if (r < 0) {
+        // Descarta el primer byte de la trama rechazada y reexamina el resto
+        size_t rest = count - head;
+        size_t replay = p->pos - 1;
+        memmove(queue + replay, queue + head, rest);
+        memcpy(queue, p->frame + 1, replay);
+        head = 0;
+        count = replay + rest;
+        p->pos = 0;
+        p->skipping = false;
+        p->stats.resyncs++;
+      }
+    }
+  }
+  return frames;
+}
+
+bool pmsParserTake(Pms7003Parser * p, PMS7003Data * out) {
+  if (!p->fresh) return false;
+  *out = p->latest;
+  p->fresh = false;
+  return true;
+}
@@ -0,0 +1,64 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBPMS7003_H
+#define LIBPMS7003_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libsensordata.h>
+
+// Parser incremental de tramas del PMS7003. No depende de Arduino: recibe los
+// bytes en bloques de cualquier tamaño (desde el callback de la UART o desde
+// una captura en el host) y conserva solo la última trama válida.
+//
+// Trama: 0x42 0x4D, longitud (28, big endian), 13 palabras de datos y la suma
+// de verificación de los 30 bytes anteriores. 32 bytes en total.
+
+#define PMS7003_FRAME_SIZE 32       ///< Bytes de una trama completa
+#define PMS7003_FRAME_LENGTH 28     ///< Valor del campo de longitud (datos + suma)
+
+struct Pms7003Stats {
+  uint32_t bytes;                   ///< Bytes procesados
+  uint32_t frames;                  ///< Tramas válidas
+  uint32_t checksumErrors;          ///< Tramas con suma de verificación incorrecta
+  uint32_t lengthErrors;            ///< Cabeceras con longitud distinta de 28
+  uint32_t resyncs;                 ///< Veces que se descartaron bytes buscando la cabecera
+  uint32_t overruns;                ///< Desbordes de la UART (los reporta quien alimenta el parser)
+};
+
+struct Pms7003Parser {
+  uint8_t frame[PMS7003_FRAME_SIZE]; ///< Trama en construcción
+  uint8_t pos;                      ///< Bytes acumulados de la trama en construcción
+  bool skipping;                    ///< Se están descartando bytes fuera de trama
+  bool fresh;                       ///< Hay una trama válida que aún no se ha leído
+  PMS7003Data latest;               ///< Última trama válida
+  Pms7003Stats stats;
+};
+
+void pmsParserInit(Pms7003Parser * p);   ///< Deja el parser buscando cabecera y borra estadísticas
+size_t pmsParserFeed(Pms7003Parser * p, const uint8_t * data, size_t len); ///< Procesa len bytes; retorna cuántas tramas válidas completó
+bool pmsParserTake(Pms7003Parser * p, PMS7003Data * out); ///< Copia la última trama válida si no se había leído
+
+#endif /* LIBPMS7003_H */
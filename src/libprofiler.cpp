@@ -0,0 +1,131 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <libprofiler.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+static inline uint32_t profilerMicros() { return micros(); }
+#define PROFILER_PRINTF Serial.printf
+#else
+#include <chrono>
+static inline uint32_t profilerMicros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#define PROFILER_PRINTF printf
+#endif
+
+static ProfilerPhase phases[PROFILER_MAX_PHASES];
+static size_t phaseCount = 0;
+static size_t openPhases[PROFILER_MAX_DEPTH];   // Índices de las fases abiertas
+static size_t depth = 0;
+static bool truncated = false;            // Se descartaron fases por falta de espacio
+
+static ProfilerPhase * addPhase(const char * name) {
+  if (phaseCount >= PROFILER_MAX_PHASES) {
+    truncated = true;
+    return nullptr;
+  }
+  ProfilerPhase * p = &phases[phaseCount++];
+  p->name = name;
+  p->startUs = profilerMicros();
+  p->durationUs = 0;
+  p->depth = (uint8_t)depth;
+  return p;
+}
+
+void profilerBegin(const char * name) {
+  if (depth >= PROFILER_MAX_DEPTH) {
+    truncated = true;
+    return;
+  }
+  // Si no hay espacio se sigue contando el nivel para que profilerEnd() quede pareado
+  openPhases[depth++] = addPhase(name) ? phaseCount - 1 : PROFILER_MAX_PHASES;
+}
+
+void profilerEnd() {
+  if (depth == 0) return;
+  size_t idx = openPhases[--depth];
+  if (idx < phaseCount) {
+    phases[idx].durationUs = profilerMicros() - phases[idx].startUs;
+  }
+}
+
+void profilerEvent(const char * name) {
+  addPhase(name);
+}
+
+void profilerRecord(const char * name, uint32_t startUs, uint32_t durationUs) {
+  ProfilerPhase * p = addPhase(name);
+  if (p) {
+    p->startUs = startUs;
+    p->durationUs = durationUs;
+  }
+}
+
+size_t profilerCount() {
+  return phaseCount;
+}
+
+const ProfilerPhase * profilerPhase(size_t idx) {
+  return idx < phaseCount ? &phases[idx] : nullptr;
+}
+
+/**
+ * Reporte compacto: {"phases":[["nombre",inicio_us,duración_us,nivel],...],"truncated":false}
+ */
+size_t profilerReportJson(char * out, size_t outSize) {
+  size_t pos = 0;
+  int n = snprintf(out, outSize, "{\"phases\":[");
+  if (n < 0 || (size_t)n >= outSize) return 0;
+  pos = n;
+  for (size_t i = 0; i < phaseCount; i++) {
+    const ProfilerPhase & p = phases[i];
+    n = snprintf(out + pos, outSize - pos, "%s[\"%s\",%lu,%lu,%u]", i ? "," : "", p.name,
+                 (unsigned long)p.startUs, (unsigned long)p.durationUs, (unsigned)p.depth);
+    if (n < 0 || (size_t)n >= outSize - pos) return 0;
+    pos += n;
+  }
+  n = snprintf(out + pos, outSize - pos, "],\"truncated\":%s}", truncated ? "true" : "false");
+  if (n < 0 || (size_t)n >= outSize - pos) return 0;
+  return pos + n;
+}
+
+void printProfile() {
+  PROFILER_PRINTF("=== Perfil de arranque ===\n");
+  PROFILER_PRINTF("%-24s %10s %10s\n", "Fase", "Inicio ms", "Dur. ms");
+  for (size_t i = 0; i < phaseCount; i++) {
+    const ProfilerPhase & p = phases[i];
+    char label[25];
+    snprintf(label, sizeof(label), "%*s%s", p.depth * 2, "", p.name);
+    PROFILER_PRINTF("%-24s %10.1f %10.1f\n", label, p.startUs / 1000.0, p.durationUs / 1000.0);
+  }
+  if (truncated) {
+    PROFILER_PRINTF("(fases descartadas: aumente PROFILER_MAX_PHASES)\n");
+  }
+  PROFILER_PRINTF("==========================\n");
+}
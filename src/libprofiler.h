@@ -0,0 +1,57 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBPROFILER_H
+#define LIBPROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Perfilador de fases de arranque. Cada fase guarda su inicio y duración en
+// microsegundos desde el encendido; las fases pueden anidarse (por ejemplo
+// setupIoT > storage). Los nombres deben ser literales: solo se guarda el puntero.
+
+#ifndef PROFILER_MAX_PHASES
+#define PROFILER_MAX_PHASES 24      ///< Fases que se pueden registrar
+#endif
+#define PROFILER_MAX_DEPTH 4        ///< Niveles de anidamiento
+#define PROFILER_REPORT_MAX (64 + PROFILER_MAX_PHASES * 48) ///< Tamaño máximo del reporte JSON
+
+struct ProfilerPhase {
+  const char * name;                ///< Nombre de la fase
+  uint32_t startUs;                 ///< Inicio, en us desde el encendido
+  uint32_t durationUs;              ///< Duración (0 en los eventos puntuales)
+  uint8_t depth;                    ///< Nivel de anidamiento
+};
+
+void profilerBegin(const char * name); ///< Inicia una fase (anidada si hay otra abierta)
+void profilerEnd();                 ///< Cierra la fase abierta más reciente
+void profilerEvent(const char * name); ///< Registra un instante puntual, p. ej. la primera conexión MQTT
+void profilerRecord(const char * name, uint32_t startUs, uint32_t durationUs); ///< Registra una fase ya medida (tareas concurrentes del arranque)
+size_t profilerCount();             ///< Número de fases registradas
+const ProfilerPhase * profilerPhase(size_t idx); ///< Retorna la fase idx o nullptr
+size_t profilerReportJson(char * out, size_t outSize); ///< Escribe el reporte JSON; retorna 0 si no cabe
+void printProfile();                ///< Imprime las fases como tabla por Serial
+
+#endif /* LIBPROFILER_H */
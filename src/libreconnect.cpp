@@ -0,0 +1,90 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <libreconnect.h>
+#include <stddef.h>
+
+void reconnectInit(Reconnect * r, const ReconnectOps * ops, uint32_t baseMs, uint32_t maxMs) {
+  r->state = RECONNECT_CONNECT;
+  backoffInit(&r->backoff, baseMs, maxMs);
+  r->retryAt = 0;
+  r->ops = ops;
+}
+
+/**
+ * Programa el siguiente intento de conexión según el backoff con jitter.
+ */
+static void scheduleRetry(Reconnect * r, uint32_t random) {
+  uint32_t wait = backoffNext(&r->backoff, random);
+  r->retryAt = r->ops->now() + wait;  // Después de connect(), que pudo bloquear
+  r->state = RECONNECT_WAIT_RETRY;
+  if (r->ops->retry) r->ops->retry(wait, r->backoff.attempt);
+}
+
+/**
+ * Avanza un paso la máquina. El único paso que puede tardar es connect()
+ * (conexión TCP y handshake TLS), acotado por el timeout del cliente.
+ */
+void reconnectStep(Reconnect * r, uint32_t random) {
+  const ReconnectOps * ops = r->ops;
+  switch (r->state) {
+    case RECONNECT_READY:
+      if (!ops->connected()) scheduleRetry(r, random);
+      break;
+
+    case RECONNECT_WAIT_RETRY:
+      if (ops->linkUp() && (int32_t)(ops->now() - r->retryAt) >= 0) {
+        r->state = RECONNECT_CONNECT;
+      }
+      break;
+
+    case RECONNECT_CONNECT:
+      if (!ops->linkUp()) {
+        scheduleRetry(r, random);
+        break;
+      }
+      if (!ops->clockReady()) break;  // Sin hora válida el certificado del servidor no se puede verificar
+      if (ops->connect()) {
+        r->state = RECONNECT_SUBSCRIBE;
+      } else {
+        scheduleRetry(r, random);
+      }
+      break;
+
+    case RECONNECT_SUBSCRIBE:
+      ops->subscribe();
+      r->state = RECONNECT_SUBSCRIBE_OTA;
+      break;
+
+    case RECONNECT_SUBSCRIBE_OTA:
+      ops->ready();
+      backoffReset(&r->backoff);
+      r->state = RECONNECT_READY;
+      break;
+  }
+}
+
+bool reconnectReady(const Reconnect * r) {
+  return r->state == RECONNECT_READY && r->ops->connected();
+}
@@ -0,0 +1,68 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBRECONNECT_H
+#define LIBRECONNECT_H
+
+#include <stdint.h>
+#include <libbackoff.h>
+
+// Máquina de reconexión MQTT sin bloqueos. No depende de Arduino ni de
+// PubSubClient: el reloj y las operaciones de red se reciben como funciones y el
+// valor aleatorio como parámetro, así se puede simular en el host con un reloj y
+// un cliente falsos. Cada paso hace como máximo una operación de red.
+
+// Estados de la máquina; reconnectStep() avanza uno por cada pasada de loop()
+enum ReconnectState {
+  RECONNECT_READY,                  ///< Conectado y suscrito: solo se atiende client.loop()
+  RECONNECT_WAIT_RETRY,             ///< Desconectado, esperando a que venza el backoff
+  RECONNECT_CONNECT,                ///< Intentar la conexión con el bróker
+  RECONNECT_SUBSCRIBE,              ///< Suscribirse al tópico de comandos
+  RECONNECT_SUBSCRIBE_OTA           ///< Suscribirse al tópico OTA y completar la conexión
+};
+
+// Operaciones de red que usa la máquina
+struct ReconnectOps {
+  uint32_t (*now)();                ///< Reloj en milisegundos (millis() en el ESP32)
+  bool (*connected)();              ///< Retorna true si la sesión MQTT está activa
+  bool (*linkUp)();                 ///< Retorna true si el enlace WiFi está asociado
+  bool (*clockReady)();             ///< Retorna true si la hora permite verificar el certificado
+  bool (*connect)();                ///< Abre la sesión; puede bloquear hasta el timeout del handshake
+  void (*subscribe)();              ///< Se suscribe al tópico de comandos
+  void (*ready)();                  ///< Se suscribe al tópico OTA y avisa que la conexión está lista
+  void (*retry)(uint32_t waitMs, uint32_t attempt); ///< Avisa la espera programada (puede ser NULL)
+};
+
+struct Reconnect {
+  ReconnectState state;             ///< Estado actual
+  Backoff backoff;                  ///< Espera entre intentos fallidos
+  uint32_t retryAt;                 ///< Instante (ms) en que vence la espera actual
+  const ReconnectOps * ops;         ///< Operaciones de red
+};
+
+void reconnectInit(Reconnect * r, const ReconnectOps * ops, uint32_t baseMs, uint32_t maxMs); ///< Deja la máquina lista para el primer intento
+void reconnectStep(Reconnect * r, uint32_t random); ///< Avanza un paso; random es el jitter del backoff (esp_random() en el ESP32)
+bool reconnectReady(const Reconnect * r); ///< Retorna true si la conexión está lista para publicar
+
+#endif /* LIBRECONNECT_H */
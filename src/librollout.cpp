@@ -0,0 +1,69 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <librollout.h>
+
+uint32_t rolloutHash(const char * deviceId, const char * seed) {
+  uint32_t hash = 2166136261u;
+  for (const char * p = deviceId; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619u;
+  hash = (hash ^ (uint8_t)':') * 16777619u;
+  for (const char * p = seed; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619u;
+  return hash;
+}
+
+uint8_t rolloutCohort(uint32_t hash) {
+  return hash % 100;
+}
+
+/**
+ * El retardo sale del hash mezclado (finalizador de MurmurHash3) para que no
+ * quede correlacionado con la cohorte: los dispositivos que se suman al
+ * subir percent se reparten en toda la ventana.
+ */
+uint32_t rolloutDelayMs(uint32_t hash, uint32_t windowS) {
+  hash ^= hash >> 16;
+  hash *= 0x85EBCA6Bu;
+  hash ^= hash >> 13;
+  hash *= 0xC2B2AE35u;
+  hash ^= hash >> 16;
+  if (windowS > ROLLOUT_MAX_WINDOW_S) windowS = ROLLOUT_MAX_WINDOW_S;
+  return (uint32_t)(((uint64_t)hash * ((uint64_t)windowS * 1000)) >> 32);
+}
+
+void rateLimitInit(RateLimiter * limiter, uint32_t bytesPerSecond, uint32_t burst, uint32_t nowMs) {
+  limiter->bytesPerSecond = bytesPerSecond;
+  limiter->burst = (int64_t)burst * 1000;
+  limiter->tokens = limiter->burst;
+  limiter->lastMs = nowMs;
+}
+
+uint32_t rateLimitWaitMs(RateLimiter * limiter, uint32_t bytes, uint32_t nowMs) {
+  if (limiter->bytesPerSecond == 0) return 0;
+  limiter->tokens += (int64_t)(uint32_t)(nowMs - limiter->lastMs) * limiter->bytesPerSecond;
+  if (limiter->tokens > limiter->burst) limiter->tokens = limiter->burst;
+  limiter->lastMs = nowMs;
+  limiter->tokens -= (int64_t)bytes * 1000;
+  if (limiter->tokens >= 0) return 0;
+  return (uint32_t)((-limiter->tokens + limiter->bytesPerSecond - 1) / limiter->bytesPerSecond);
+}
@@ -0,0 +1,63 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBROLLOUT_H
+#define LIBROLLOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Despliegue escalonado de las OTA. El mensaje OTA puede traer
+// "rollout":{"percent":..,"seed":..,"window_s":..,"rate_kbps":..}. Cada
+// dispositivo cae en una cohorte 0..99 según un hash de su ID y la semilla y
+// solo se actualiza si su cohorte es menor que percent: subir percent con la
+// misma semilla suma dispositivos sin sacar a ninguno. El inicio se reparte
+// en window_s segundos con un retardo derivado del mismo hash y la descarga
+// se limita a rate_kbps con un token bucket.
+// scripts/simulate_rollout.py reproduce estas funciones para estimar la carga
+// del servidor. Este módulo no depende de Arduino.
+
+#define ROLLOUT_BURST_BYTES 16384   ///< Ráfaga que el limitador deja pasar sin esperar (4 buffers de descarga)
+#define ROLLOUT_MAX_WINDOW_S 604800 ///< Ventana máxima (7 días); valores mayores se recortan
+#define ROLLOUT_MAX_RATE_KBPS 1000000 ///< Límite de velocidad máximo aceptado (1 Gbit/s); valores mayores se recortan
+
+uint32_t rolloutHash(const char * deviceId, const char * seed); ///< FNV-1a de "deviceId:seed"
+uint8_t rolloutCohort(uint32_t hash);                 ///< Cohorte 0..99 del dispositivo
+uint32_t rolloutDelayMs(uint32_t hash, uint32_t windowS); ///< Retardo uniforme en [0, windowS) s, independiente de la cohorte (windowS se recorta a ROLLOUT_MAX_WINDOW_S)
+
+/**
+ * Token bucket en milésimas de byte, para no perder la fracción de byte
+ * que se acumula entre llamadas muy seguidas a velocidades bajas.
+ */
+typedef struct {
+  uint32_t bytesPerSecond;          ///< 0 = sin límite
+  int64_t tokens;                   ///< Saldo en milésimas de byte; negativo = deuda a esperar
+  int64_t burst;                    ///< Saldo máximo en milésimas de byte
+  uint32_t lastMs;                  ///< Última recarga
+} RateLimiter;
+
+void rateLimitInit(RateLimiter * limiter, uint32_t bytesPerSecond, uint32_t burst, uint32_t nowMs);
+uint32_t rateLimitWaitMs(RateLimiter * limiter, uint32_t bytes, uint32_t nowMs); ///< Descuenta bytes y retorna los ms a esperar antes de seguir (0 si hay saldo)
+
+#endif /* LIBROLLOUT_H */
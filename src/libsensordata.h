@@ -0,0 +1,101 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBSENSORDATA_H
+#define LIBSENSORDATA_H
+
+#include <stdint.h>
+
+// Estructura para datos del PMS7003
+struct PMS7003Data {
+  uint16_t pm1_0_cf1;
+  uint16_t pm2_5_cf1;
+  uint16_t pm10_cf1;
+  uint16_t pm1_0_atm;
+  uint16_t pm2_5_atm;
+  uint16_t pm10_atm;
+  uint16_t num_part_03;
+  uint16_t num_part_05;
+  uint16_t num_part_1;
+  uint16_t num_part_25;
+  uint16_t num_part_5;
+  uint16_t num_part_10;
+};
+
+typedef struct {
+  // Datos del CCS811
+  uint16_t co2;
+  uint16_t tvoc;
+  bool ccs811_valido;
+  // Datos del PMS7003
+  PMS7003Data pms7003;
+  bool pms7003_valido;
+} SensorData;
+
+// Vista por canales de una muestra: CO2, TVOC y los 12 campos del PMS7003 en el
+// orden de PMS7003Data. La usan la agregación y el envío por excepción.
+#define SENSOR_CHANNELS 14
+#define SENSOR_CCS811_CHANNELS 2    ///< Los dos primeros canales vienen del CCS811
+
+/// Nombre del canal ch, igual a la clave del JSON de telemetría
+inline const char * sensorChannelName(int ch) {
+  static const char * const names[SENSOR_CHANNELS] = {
+    "co2", "tvoc",
+    "pm1_0_cf1", "pm2_5_cf1", "pm10_cf1", "pm1_0", "pm2_5", "pm10",
+    "n0_3", "n0_5", "n1_0", "n2_5", "n5_0", "n10"
+  };
+  return ch >= 0 && ch < SENSOR_CHANNELS ? names[ch] : "";
+}
+
+/// Copia los 14 canales de data en v
+inline void sensorChannels(const SensorData * data, uint16_t v[SENSOR_CHANNELS]) {
+  const PMS7003Data & p = data->pms7003;
+  v[0] = data->co2;
+  v[1] = data->tvoc;
+  v[2] = p.pm1_0_cf1;
+  v[3] = p.pm2_5_cf1;
+  v[4] = p.pm10_cf1;
+  v[5] = p.pm1_0_atm;
+  v[6] = p.pm2_5_atm;
+  v[7] = p.pm10_atm;
+  v[8] = p.num_part_03;
+  v[9] = p.num_part_05;
+  v[10] = p.num_part_1;
+  v[11] = p.num_part_25;
+  v[12] = p.num_part_5;
+  v[13] = p.num_part_10;
+}
+
+/// Retorna true si el canal ch tiene una lectura válida en data
+inline bool sensorChannelValid(const SensorData * data, int ch) {
+  return ch < SENSOR_CCS811_CHANNELS ? data->ccs811_valido : data->pms7003_valido;
+}
+
+// Muestra con su marca de tiempo (segundos Unix, tomada de SNTP)
+struct TimedSample {
+  uint32_t timestamp;
+  SensorData data;
+};
+
+#endif /* LIBSENSORDATA_H */
@@ -0,0 +1,344 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <libspool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define RECORD_MAGIC 0x5351         // "QS"
+#define RECORD_HEADER 8             // magic(2) + longitud(2) + crc32(4)
+#define PATH_SIZE (SPOOL_PATH_MAX + 20)   // Ruta base + "/segNNNNNNNNNN.log"
+
+enum RecordResult { RECORD_OK, RECORD_END, RECORD_BAD };
+
+static char basePath[SPOOL_PATH_MAX];
+static bool ready = false;
+static uint32_t headSeg = 0;        // Posición de lectura confirmada (persistida en "head")
+static uint32_t headOffset = 0;
+static uint32_t readSeg = 0;        // Posición de lectura tentativa (aún sin confirmar)
+static uint32_t readOffset = 0;
+static uint32_t writeSeg = 0;       // Segmento y posición donde se agrega el siguiente registro
+static uint32_t writeOffset = 0;
+static FILE * reader = NULL;        // Segmento abierto durante un drenado
+static uint32_t readerSeg = 0;
+static SpoolStats stats = {};
+
+/**
+ * CRC-32 (IEEE) bit a bit: los registros son pequeños y así no se necesita tabla.
+ */
+static uint32_t crc32(const uint8_t * data, size_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static void putLE32(uint8_t * p, uint32_t v) {
+  p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t getLE32(const uint8_t * p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void segmentPath(char * out, uint32_t seg) {
+  snprintf(out, PATH_SIZE, "%s/seg%05lu.log", basePath, (unsigned long)seg);
+}
+
+static void closeReader() {
+  if (reader) {
+    fclose(reader);
+    reader = NULL;
+  }
+}
+
+/**
+ * Lee el registro que empieza en offset dentro de f.
+ */
+static RecordResult readRecord(FILE * f, uint32_t offset, uint8_t * buf, size_t size, size_t * length) {
+  uint8_t header[RECORD_HEADER];
+  if (fseek(f, (long)offset, SEEK_SET) != 0) return RECORD_END;
+  size_t got = fread(header, 1, RECORD_HEADER, f);
+  if (got == 0) return RECORD_END;
+  if (got < RECORD_HEADER) return RECORD_BAD;
+  uint16_t magic = (uint16_t)(header[0] | (header[1] << 8));
+  uint16_t len = (uint16_t)(header[2] | (header[3] << 8));
+  if (magic != RECORD_MAGIC || len == 0 || len > SPOOL_RECORD_MAX || len > size) return RECORD_BAD;
+  if (fread(buf, 1, len, f) != len) return RECORD_BAD;
+  if (crc32(buf, len) != getLE32(header + 4)) return RECORD_BAD;
+  *length = len;
+  return RECORD_OK;
+}
+
+/**
+ * Persiste la posición confirmada escribiendo un archivo temporal y renombrándolo,
+ * para que un reinicio a mitad de la escritura deje la versión anterior intacta.
+ */
+static bool saveHead() {
+  char tmp[PATH_SIZE];
+  char path[PATH_SIZE];
+  snprintf(tmp, sizeof(tmp), "%s/head.tmp", basePath);
+  snprintf(path, sizeof(path), "%s/head", basePath);
+  uint8_t data[12];
+  putLE32(data, headSeg);
+  putLE32(data + 4, headOffset);
+  putLE32(data + 8, crc32(data, 8));
+  FILE * f = fopen(tmp, "wb");
+  if (!f) return false;
+  bool ok = fwrite(data, 1, sizeof(data), f) == sizeof(data);
+  ok = (fclose(f) == 0) && ok;
+  if (ok) {
+    remove(path);
+    ok = rename(tmp, path) == 0;
+  }
+  if (!ok) stats.writeErrors++;
+  return ok;
+}
+
+static bool loadHeadFile(const char * name, uint32_t * seg, uint32_t * offset) {
+  char path[PATH_SIZE];
+  snprintf(path, sizeof(path), "%s/%s", basePath, name);
+  FILE * f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t data[12];
+  bool ok = fread(data, 1, sizeof(data), f) == sizeof(data);
+  fclose(f);
+  if (!ok || crc32(data, 8) != getLE32(data + 8)) return false;
+  *seg = getLE32(data);
+  *offset = getLE32(data + 4);
+  return true;
+}
+
+/**
+ * Recupera la posición confirmada. Si el reinicio ocurrió entre el remove y el
+ * rename de saveHead, "head" no existe pero "head.tmp" ya tiene la versión nueva
+ * completa (su CRC lo confirma).
+ */
+static bool loadHead(uint32_t * seg, uint32_t * offset) {
+  return loadHeadFile("head", seg, offset) || loadHeadFile("head.tmp", seg, offset);
+}
+
+/**
+ * Abre o crea la cola en basePath. Recupera la posición de lectura confirmada y
+ * recorre el último segmento para ubicar el final del último registro válido; si
+ * encuentra un append interrumpido, ese segmento queda sellado y las escrituras
+ * continúan en uno nuevo.
+ */
+bool spoolBegin(const char * path) {
+  closeReader();
+  ready = false;
+  if (strlen(path) >= sizeof(basePath)) return false;
+  strcpy(basePath, path);
+  mkdir(basePath, 0775);
+  DIR * dir = opendir(basePath);
+  if (!dir) return false;
+
+  bool found = false;
+  uint32_t minSeg = 0, maxSeg = 0;
+  struct dirent * entry;
+  while ((entry = readdir(dir)) != NULL) {
+    unsigned long id;
+    char tail[8];
+    if (sscanf(entry->d_name, "seg%lu.%7s", &id, tail) != 2 || strcmp(tail, "log") != 0) continue;
+    if (!found || id < minSeg) minSeg = (uint32_t)id;
+    if (!found || id > maxSeg) maxSeg = (uint32_t)id;
+    found = true;
+  }
+  closedir(dir);
+
+  uint32_t seg, offset;
+  bool haveHead = loadHead(&seg, &offset);
+  if (!found) {
+    headSeg = writeSeg = haveHead ? seg : 0;
+    headOffset = writeOffset = 0;
+  } else {
+    headSeg = minSeg;
+    headOffset = 0;
+    if (haveHead && seg >= minSeg && seg <= maxSeg) {
+      headSeg = seg;
+      headOffset = offset;
+    }
+    writeSeg = maxSeg;
+    writeOffset = 0;
+
+    // Ubicar el final del último registro válido del segmento de escritura
+    char segPath[PATH_SIZE];
+    segmentPath(segPath, writeSeg);
+    FILE * f = fopen(segPath, "rb");
+    if (f) {
+      uint8_t buf[SPOOL_RECORD_MAX];
+      size_t len;
+      RecordResult result;
+      while ((result = readRecord(f, writeOffset, buf, sizeof(buf), &len)) == RECORD_OK) {
+        writeOffset += RECORD_HEADER + len;
+      }
+      fclose(f);
+      if (result == RECORD_BAD) {
+        writeSeg++;
+        writeOffset = 0;
+      }
+    }
+    if (writeOffset >= SPOOL_SEGMENT_SIZE) {
+      writeSeg++;
+      writeOffset = 0;
+    }
+  }
+  readSeg = headSeg;
+  readOffset = headOffset;
+  ready = true;
+  return true;
+}
+
+/**
+ * Agrega un registro al segmento actual, rotando a uno nuevo cuando no cabe.
+ * Si la cola supera SPOOL_MAX_SEGMENTS se descarta el segmento más antiguo.
+ */
+bool spoolAppend(const uint8_t * data, size_t length) {
+  if (!ready || length == 0 || length > SPOOL_RECORD_MAX) return false;
+  closeReader();
+  uint32_t recordSize = RECORD_HEADER + (uint32_t)length;
+  if (writeOffset + recordSize > SPOOL_SEGMENT_SIZE) {
+    writeSeg++;
+    writeOffset = 0;
+  }
+  char path[PATH_SIZE];
+  if (writeSeg - headSeg + 1 > SPOOL_MAX_SEGMENTS) {
+    while (writeSeg - headSeg + 1 > SPOOL_MAX_SEGMENTS) {
+      segmentPath(path, headSeg);
+      remove(path);
+      headSeg++;
+      headOffset = 0;
+      stats.droppedSegments++;
+    }
+    if (readSeg < headSeg) {
+      readSeg = headSeg;
+      readOffset = 0;
+    }
+    saveHead();
+  }
+
+  uint8_t record[RECORD_HEADER + SPOOL_RECORD_MAX];
+  record[0] = (uint8_t)RECORD_MAGIC;
+  record[1] = (uint8_t)(RECORD_MAGIC >> 8);
+  record[2] = (uint8_t)length;
+  record[3] = (uint8_t)(length >> 8);
+  putLE32(record + 4, crc32(data, length));
+  memcpy(record + RECORD_HEADER, data, length);
+
+  segmentPath(path, writeSeg);
+  FILE * f = fopen(path, "ab");
+  bool ok = f && fwrite(record, 1, recordSize, f) == recordSize;
+  if (f) ok = (fclose(f) == 0) && ok;
+  if (!ok) {
+    // Sellar el segmento: lo que haya quedado a medias se descarta al leer
+    stats.writeErrors++;
+    writeSeg++;
+    writeOffset = 0;
+    return false;
+  }
+  writeOffset += recordSize;
+  stats.appended++;
+  return true;
+}
+
+/**
+ * Lee el siguiente registro a partir de la posición tentativa. Los registros
+ * inválidos y el final de los segmentos sellados se saltan.
+ */
+size_t spoolRead(uint8_t * buf, size_t size) {
+  if (!ready) return 0;
+  while (readSeg < writeSeg || (readSeg == writeSeg && readOffset < writeOffset)) {
+    if (!reader || readerSeg != readSeg) {
+      closeReader();
+      char path[PATH_SIZE];
+      segmentPath(path, readSeg);
+      reader = fopen(path, "rb");
+      readerSeg = readSeg;
+    }
+    size_t len = 0;
+    RecordResult result = reader ? readRecord(reader, readOffset, buf, size, &len) : RECORD_END;
+    if (result == RECORD_OK) {
+      readOffset += RECORD_HEADER + (uint32_t)len;
+      stats.read++;
+      return len;
+    }
+    if (result == RECORD_BAD) stats.corrupt++;
+    if (readSeg == writeSeg) break;
+    readSeg++;
+    readOffset = 0;
+  }
+  return 0;
+}
+
+/**
+ * Confirma los registros leídos. Los segmentos ya consumidos se borran y, si la
+ * cola quedó vacía, el segmento de escritura se reemplaza por uno nuevo.
+ */
+bool spoolCommit() {
+  closeReader();
+  if (!ready) return false;
+  if (readSeg == headSeg && readOffset == headOffset) return true;
+  char path[PATH_SIZE];
+  for (uint32_t seg = headSeg; seg < readSeg; seg++) {
+    segmentPath(path, seg);
+    remove(path);
+  }
+  if (readSeg == writeSeg && readOffset >= writeOffset && writeOffset > 0) {
+    segmentPath(path, writeSeg);
+    remove(path);
+    writeSeg++;
+    writeOffset = 0;
+    readSeg = writeSeg;
+    readOffset = 0;
+  }
+  headSeg = readSeg;
+  headOffset = readOffset;
+  return saveHead();
+}
+
+void spoolRewind() {
+  closeReader();
+  readSeg = headSeg;
+  readOffset = headOffset;
+}
+
+bool spoolEmpty() {
+  return !ready || (headSeg == writeSeg && headOffset >= writeOffset);
+}
+
+uint16_t spoolSegments() {
+  if (!ready) return 0;
+  return (uint16_t)(writeSeg - headSeg + (writeOffset > 0 ? 1 : 0));
+}
+
+const SpoolStats & getSpoolStats() {
+  return stats;
+}
@@ -0,0 +1,63 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBSPOOL_H
+#define LIBSPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Cola persistente store-and-forward sobre un sistema de archivos (LittleFS en el
+// ESP32, montado en /littlefs). Solo usa stdio/POSIX, así que también funciona en
+// el host contra un directorio común que hace de flash.
+//
+// Los registros se agregan a segmentos "segNNNNN.log" de tamaño fijo; cada registro
+// lleva longitud y CRC32, de modo que un append interrumpido por un reinicio se
+// detecta y se descarta. La posición de lectura se guarda en "head" solo al
+// confirmar un drenado, para no escribir flash por cada registro.
+
+#define SPOOL_SEGMENT_SIZE 16384    ///< Bytes máximos por segmento
+#define SPOOL_MAX_SEGMENTS 8        ///< Segmentos máximos; al excederlo se descarta el más antiguo
+#define SPOOL_RECORD_MAX 64         ///< Tamaño máximo del contenido de un registro
+#define SPOOL_PATH_MAX 48           ///< Longitud máxima de la ruta base
+
+// Contadores de la cola
+struct SpoolStats {
+  uint32_t appended;                ///< Registros escritos desde el arranque
+  uint32_t read;                    ///< Registros leídos desde el arranque
+  uint32_t droppedSegments;         ///< Segmentos descartados por falta de espacio
+  uint32_t corrupt;                 ///< Registros inválidos encontrados (appends interrumpidos)
+  uint32_t writeErrors;             ///< Errores de escritura en el sistema de archivos
+};
+
+bool spoolBegin(const char * basePath); ///< Abre o crea la cola en basePath y recupera el estado tras un reinicio
+bool spoolAppend(const uint8_t * data, size_t length); ///< Agrega un registro al final de la cola
+size_t spoolRead(uint8_t * buf, size_t size); ///< Lee el siguiente registro sin confirmarlo. Retorna su longitud o 0 si no hay más
+bool spoolCommit();                 ///< Confirma los registros leídos: persiste la posición y borra segmentos consumidos
+void spoolRewind();                 ///< Descarta las lecturas no confirmadas para reintentarlas más tarde
+bool spoolEmpty();                  ///< Retorna true si no quedan registros por leer
+uint16_t spoolSegments();           ///< Segmentos que ocupa la cola actualmente
+const SpoolStats & getSpoolStats(); ///< Retorna los contadores de la cola
+
+#endif /* LIBSPOOL_H */
@@ -0,0 +1,89 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBSPSC_H
+#define LIBSPSC_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Cola sin bloqueos de un solo productor y un solo consumidor (SPSC).
+ * El productor solo escribe head y el consumidor solo escribe tail, así que
+ * basta con orden adquirir/liberar entre ambos; no hay mutex ni secciones
+ * críticas. Si la cola está llena la muestra nueva se descarta y se cuenta
+ * como desborde: el productor nunca espera al consumidor.
+ * N debe ser potencia de dos; la capacidad útil es N.
+ */
+template <typename T, uint32_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "N debe ser potencia de dos");
+
+public:
+  /// Productor: encola una copia de item. Retorna false (y cuenta el desborde) si está llena.
+  bool push(const T & item) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t tail = tail_.load(std::memory_order_acquire);
+    if (head - tail >= N) {
+      overruns_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    slots_[head & (N - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    uint32_t used = head + 1 - tail;
+    if (used > highWater_.load(std::memory_order_relaxed)) {
+      highWater_.store(used, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  /// Consumidor: saca el elemento más antiguo. Retorna false si está vacía.
+  bool pop(T * out) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    uint32_t head = head_.load(std::memory_order_acquire);
+    if (head == tail) return false;
+    *out = slots_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Elementos en cola (aproximado si se consulta desde un tercer hilo).
+  uint32_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  uint32_t pushed() const { return head_.load(std::memory_order_relaxed); }        ///< Elementos encolados desde el inicio
+  uint32_t overruns() const { return overruns_.load(std::memory_order_relaxed); }  ///< Elementos descartados por cola llena
+  uint32_t highWater() const { return highWater_.load(std::memory_order_relaxed); } ///< Máxima ocupación observada
+
+private:
+  T slots_[N];
+  std::atomic<uint32_t> head_{0};   // Siguiente posición a escribir (solo el productor)
+  std::atomic<uint32_t> tail_{0};   // Siguiente posición a leer (solo el consumidor)
+  std::atomic<uint32_t> overruns_{0};
+  std::atomic<uint32_t> highWater_{0};
+};
+
+#endif /* LIBSPSC_H */
@@ -5,6 +5,12 @@
 static const char* kNamespace = "cred";
 static const char* kWiFiSsidKey = "wifi_ssid";
 static const char* kWiFiPwdKey  = "wifi_pwd";
+static const char* kWiFiFastKey = "wifi_fast";
+static const char* kTlsSessionKey = "tls_sess";
+static const char* kDeadbandKey = "deadband";
+static const char* kDeadbandOnKey = "deadband_on";
+static const char* kOtaResumeKey = "ota_resume";
+static const char* kOtaOffsetKey = "ota_offset";
 
 bool saveWiFiCredentials(const String &ssid, const String &password) {
   if (ssid.length() == 0) return false;
@@ -12,6 +18,7 @@ bool saveWiFiCredentials(const String &ssid, const String &password) {
   if (!prefs.begin(kNamespace, false)) return false;
   bool ok = prefs.putString(kWiFiSsidKey, ssid) > 0;
   ok = ok && (prefs.putString(kWiFiPwdKey, password) >= 0);
+  prefs.remove(kWiFiFastKey);     // La caché pertenece a la red anterior
   prefs.end();
   return ok;
 }
@@ -33,6 +40,7 @@ bool clearWiFiCredentials() {
   if (!prefs.begin(kNamespace, false)) return false;
   bool ok = prefs.remove(kWiFiSsidKey);
   ok = prefs.remove(kWiFiPwdKey) || ok;
+  prefs.remove(kWiFiFastKey);
   prefs.end();
   return ok;
 }
@@ -45,6 +53,122 @@ bool hasWiFiCredentials() {
   return s.length() > 0;
 }
 
+// Caché de reconexión rápida (BSSID, canal y configuración IP). Solo se escribe
+// cuando cambia, para no desgastar la flash en cada arranque.
+bool saveWiFiFastConnect(const WiFiFastConnect &fc) {
+  WiFiFastConnect current;
+  if (loadWiFiFastConnect(current) && memcmp(&current, &fc, sizeof(fc)) == 0) return true;
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, false)) return false;
+  bool ok = prefs.putBytes(kWiFiFastKey, &fc, sizeof(fc)) == sizeof(fc);
+  prefs.end();
+  return ok;
+}
+
+bool loadWiFiFastConnect(WiFiFastConnect &outFc) {
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, true)) return false;
+  bool ok = prefs.getBytesLength(kWiFiFastKey) == sizeof(outFc) &&
+            prefs.getBytes(kWiFiFastKey, &outFc, sizeof(outFc)) == sizeof(outFc);
+  prefs.end();
+  return ok && outFc.channel != 0 && outFc.ip != 0;
+}
+
+bool clearWiFiFastConnect() {
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, false)) return false;
+  bool ok = prefs.remove(kWiFiFastKey);
+  prefs.end();
+  return ok;
+}
+
+// Sesión TLS del cliente MQTT (ver libtls.cpp)
+bool saveTlsSession(const uint8_t *data, size_t len) {
+  if (len == 0) return false;
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, false)) return false;
+  bool ok = prefs.putBytes(kTlsSessionKey, data, len) == len;
+  prefs.end();
+  return ok;
+}
+
+size_t loadTlsSession(uint8_t *out, size_t maxLen) {
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, true)) return 0;
+  size_t len = prefs.getBytesLength(kTlsSessionKey);
+  if (len == 0 || len > maxLen || prefs.getBytes(kTlsSessionKey, out, len) != len) len = 0;
+  prefs.end();
+  return len;
+}
+
+bool clearTlsSession() {
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, false)) return false;
+  bool ok = prefs.remove(kTlsSessionKey);
+  prefs.end();
+  return ok;
+}
+
+bool saveDeadbandConfig(const DeadbandConfig &config, bool enabled) {
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, false)) return false;
+  bool ok = prefs.putBytes(kDeadbandKey, &config, sizeof(config)) == sizeof(config);
+  ok = ok && prefs.putUChar(kDeadbandOnKey, enabled ? 1 : 0) == 1;
+  prefs.end();
+  return ok;
+}
+
+bool loadDeadbandConfig(DeadbandConfig &outConfig, bool &outEnabled) {
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, true)) return false;
+  bool ok = prefs.getBytesLength(kDeadbandKey) == sizeof(outConfig) &&
+            prefs.getBytes(kDeadbandKey, &outConfig, sizeof(outConfig)) == sizeof(outConfig);
+  if (ok) outEnabled = prefs.getUChar(kDeadbandOnKey, 0) != 0;
+  prefs.end();
+  return ok;
+}
+
+// Descarga OTA pendiente. El avance va en una clave aparte para que guardarlo
+// cada pocos sectores escriba solo 4 bytes en NVS.
+bool saveOtaResume(const OtaResumeState &state) {
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, false)) return false;
+  bool ok = prefs.putBytes(kOtaResumeKey, &state, sizeof(state)) == sizeof(state);
+  ok = ok && prefs.putUInt(kOtaOffsetKey, 0) == sizeof(uint32_t);
+  prefs.end();
+  return ok;
+}
+
+bool loadOtaResume(OtaResumeState &outState, uint32_t &outOffset) {
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, true)) return false;
+  bool ok = prefs.getBytesLength(kOtaResumeKey) == sizeof(outState) &&
+            prefs.getBytes(kOtaResumeKey, &outState, sizeof(outState)) == sizeof(outState);
+  outOffset = ok ? prefs.getUInt(kOtaOffsetKey, 0) : 0;
+  prefs.end();
+  outState.url[sizeof(outState.url) - 1] = '\0';
+  outState.version[sizeof(outState.version) - 1] = '\0';
+  outState.validator[sizeof(outState.validator) - 1] = '\0';
+  return ok && outState.url[0] != '\0';
+}
+
+bool saveOtaResumeOffset(uint32_t offset) {
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, false)) return false;
+  bool ok = prefs.putUInt(kOtaOffsetKey, offset) == sizeof(uint32_t);
+  prefs.end();
+  return ok;
+}
+
+bool clearOtaResume() {
+  Preferences prefs;
+  if (!prefs.begin(kNamespace, false)) return false;
+  bool ok = prefs.remove(kOtaResumeKey);
+  prefs.remove(kOtaOffsetKey);
+  prefs.end();
+  return ok;
+}
+
 // Funciones para guardar/cargar la versi?n del firmware
 static const char* kFirmwareVersionKey = "fw_version";
 
@@ -6,6 +6,8 @@
 #define LIBSTORAGE_H
 
 #include <Arduino.h>
+#include <libdeadband.h>
+#include <libota.h>
 
 // Wi‑Fi credentials
 bool saveWiFiCredentials(const String &ssid, const String &password);
@@ -13,6 +15,43 @@ bool loadWiFiCredentials(String &outSsid, String &outPassword);
 bool clearWiFiCredentials();
 bool hasWiFiCredentials();
 
+// Datos de la última conexión WiFi exitosa, para reconectar sin escaneo ni DHCP
+struct WiFiFastConnect {
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t mask;
+  uint32_t dns;
+};
+bool saveWiFiFastConnect(const WiFiFastConnect &fc);
+bool loadWiFiFastConnect(WiFiFastConnect &outFc);
+bool clearWiFiFastConnect();
+
+// Sesión TLS serializada, para reanudarla tras un reinicio o deep sleep
+bool saveTlsSession(const uint8_t *data, size_t len);
+size_t loadTlsSession(uint8_t *out, size_t maxLen);  // Retorna 0 si no hay sesión o no cabe
+bool clearTlsSession();
+
+// Configuración del envío por excepción (ver libdeadband.h)
+bool saveDeadbandConfig(const DeadbandConfig &config, bool enabled);
+bool loadDeadbandConfig(DeadbandConfig &outConfig, bool &outEnabled);
+
+// Descarga OTA en curso, para reanudarla con HTTP Range tras un corte o un reinicio
+struct OtaResumeState {
+  char url[192];        // Imagen completa (la única que se reanuda)
+  char version[24];
+  char validator[64];   // ETag o Last-Modified de la imagen, enviado en If-Range
+  uint32_t size;        // Tamaño de la imagen en el servidor (0 si aún no se conoce)
+  uint32_t partition;   // Dirección de la partición destino
+  OtaSignature check;   // Hash y firma anunciados para la imagen
+  uint32_t rateLimit;   // Límite de descarga del despliegue en bytes/s
+};
+bool saveOtaResume(const OtaResumeState &state);   // También pone el avance en 0
+bool loadOtaResume(OtaResumeState &outState, uint32_t &outOffset);
+bool saveOtaResumeOffset(uint32_t offset);          // Bytes de la imagen ya escritos en flash
+bool clearOtaResume();
+
 // Firmware version
 bool saveFirmwareVersion(const String &version);
 bool loadFirmwareVersion(String &outVersion);
@@ -0,0 +1,339 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <libtelemetry.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+static inline uint32_t telemetryCycles() { return ESP.getCycleCount(); }
+static inline uint32_t telemetryMicros() { return micros(); }
+#else
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint32_t telemetryCycles() { return (uint32_t)__rdtsc(); }
+#else
+static inline uint32_t telemetryCycles() { return 0; }
+#endif
+static inline uint32_t telemetryMicros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+static TelemetryStats stats = {};
+
+// Campos del PMS7003 en el orden en que se publican. Los tres primeros
+// conservan los nombres que ya consume el backend (valores atmosféricos).
+struct PmsField {
+  const char * key;
+  uint8_t keyLen;
+  uint8_t offset;
+};
+
+#define PMS_FIELD(key, member) { key, sizeof(key) - 1, offsetof(PMS7003Data, member) }
+static const PmsField pmsFields[] = {
+  PMS_FIELD("pm1_0",     pm1_0_atm),
+  PMS_FIELD("pm2_5",     pm2_5_atm),
+  PMS_FIELD("pm10",      pm10_atm),
+  PMS_FIELD("pm1_0_cf1", pm1_0_cf1),
+  PMS_FIELD("pm2_5_cf1", pm2_5_cf1),
+  PMS_FIELD("pm10_cf1",  pm10_cf1),
+  PMS_FIELD("n0_3",      num_part_03),
+  PMS_FIELD("n0_5",      num_part_05),
+  PMS_FIELD("n1_0",      num_part_1),
+  PMS_FIELD("n2_5",      num_part_25),
+  PMS_FIELD("n5_0",      num_part_5),
+  PMS_FIELD("n10",       num_part_10),
+};
+#undef PMS_FIELD
+
+// Escritor sobre un buffer fijo: nunca escribe fuera de rango y marca el desborde
+struct JsonWriter {
+  char * buf;
+  size_t size;
+  size_t pos;
+  bool overflow;
+};
+
+static void putRaw(JsonWriter & w, const char * s, size_t n) {
+  if (w.overflow || w.pos + n > w.size) {
+    w.overflow = true;
+    return;
+  }
+  memcpy(w.buf + w.pos, s, n);
+  w.pos += n;
+}
+
+static void putUint(JsonWriter & w, uint32_t value) {
+  char digits[10];
+  size_t n = 0;
+  do {
+    digits[sizeof(digits) - 1 - n] = (char)('0' + value % 10);
+    value /= 10;
+    n++;
+  } while (value != 0);
+  putRaw(w, digits + sizeof(digits) - n, n);
+}
+
+static void putField(JsonWriter & w, const char * key, size_t keyLen, uint16_t value, bool first) {
+  putRaw(w, first ? "\"" : ",\"", first ? 1 : 2);
+  putRaw(w, key, keyLen);
+  putRaw(w, "\":", 2);
+  putUint(w, value);
+}
+
+/**
+ * Registra en las estadísticas una codificación que inició en startCycles/startMicros.
+ */
+static void recordEncode(uint32_t startCycles, uint32_t startMicros, size_t len) {
+  uint32_t cycles = telemetryCycles() - startCycles;
+  stats.lastMicros = telemetryMicros() - startMicros;
+  stats.lastCycles = cycles;
+  if (cycles > stats.maxCycles) stats.maxCycles = cycles;
+  stats.lastBytes = (uint32_t)len;
+  if (len == 0) stats.overflows++;
+  stats.encodes++;
+}
+
+/**
+ * Escribe el objeto JSON de una muestra. Los sensores sin lectura válida
+ * se publican en 0, igual que antes.
+ */
+static void putSampleJson(JsonWriter & w, const SensorData * data) {
+  putRaw(w, "{", 1);
+  putField(w, "co2", 3, data->ccs811_valido ? data->co2 : 0, true);
+  putField(w, "tvoc", 4, data->ccs811_valido ? data->tvoc : 0, false);
+  const uint8_t * pms = (const uint8_t *)&data->pms7003;
+  for (size_t i = 0; i < sizeof(pmsFields) / sizeof(pmsFields[0]); i++) {
+    uint16_t value = 0;
+    if (data->pms7003_valido) {
+      memcpy(&value, pms + pmsFields[i].offset, sizeof(value));
+    }
+    putField(w, pmsFields[i].key, pmsFields[i].keyLen, value, false);
+  }
+  putRaw(w, "}", 1);
+}
+
+/**
+ * Cierra el texto con '\0' si cabe y retorna su longitud, o 0 si hubo desborde.
+ */
+static size_t finishJson(JsonWriter & w) {
+  if (w.overflow || w.pos >= w.size) return 0;
+  w.buf[w.pos] = '\0';
+  return w.pos;
+}
+
+/**
+ * Escribe la muestra como JSON directamente en buf, sin String ni heap.
+ * Retorna la longitud escrita (sin el terminador) o 0 si el buffer no alcanza.
+ */
+size_t encodeSensorDataJson(const SensorData * data, char * buf, size_t size) {
+  uint32_t startCycles = telemetryCycles();
+  uint32_t startMicros = telemetryMicros();
+  JsonWriter w = { buf, size, 0, false };
+  putSampleJson(w, data);
+  size_t len = finishJson(w);
+  recordEncode(startCycles, startMicros, len);
+  return len;
+}
+
+/**
+ * Escribe un lote como {"ts":<base>,"dt":[...],"samples":[{...},...]}.
+ * ts es la marca de la primera muestra y dt el desfase en segundos de cada una;
+ * cada objeto de samples es idéntico al de encodeSensorDataJson().
+ */
+size_t encodeBatchJson(const TimedSample * const * samples, size_t count, char * buf, size_t size) {
+  uint32_t startCycles = telemetryCycles();
+  uint32_t startMicros = telemetryMicros();
+  JsonWriter w = { buf, size, 0, false };
+  uint32_t base = count > 0 ? samples[0]->timestamp : 0;
+  putRaw(w, "{\"ts\":", 6);
+  putUint(w, base);
+  putRaw(w, ",\"dt\":[", 7);
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0) putRaw(w, ",", 1);
+    putUint(w, samples[i]->timestamp - base);
+  }
+  putRaw(w, "],\"samples\":[", 13);
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0) putRaw(w, ",", 1);
+    putSampleJson(w, &samples[i]->data);
+  }
+  putRaw(w, "]}", 2);
+  size_t len = finishJson(w);
+  recordEncode(startCycles, startMicros, len);
+  return len;
+}
+
+// Layout CBOR (versión 1): arreglo de 16 enteros sin signo
+//   [versión, flags, co2, tvoc, <los 12 campos de PMS7003Data en orden>]
+// flags: bit 0 = CCS811 válido, bit 1 = PMS7003 válido.
+// Los canales de un sensor sin lectura válida se envían en 0.
+#define CBOR_SAMPLE_ITEMS 16
+#define CBOR_SAMPLE_MAX (3 + 14 * 3)   // Cabecera, versión y flags de 1 byte; 14 canales de hasta 3 bytes
+#define CBOR_BATCH_ITEM_MAX (1 + 5 + CBOR_SAMPLE_MAX) // [dt, muestra] con dt de hasta 32 bits
+#define CBOR_FLAG_CCS811 0x01
+#define CBOR_FLAG_PMS7003 0x02
+#define PMS_CHANNELS (sizeof(PMS7003Data) / sizeof(uint16_t))
+static_assert(PMS_CHANNELS == 12, "PMS7003Data debe ser 12 campos uint16_t sin relleno");
+static_assert(CBOR_SAMPLE_MAX <= TELEMETRY_CBOR_MAX, "TELEMETRY_CBOR_MAX es menor que el peor caso");
+
+// Tipos mayores de CBOR (RFC 8949) usados aquí
+#define CBOR_UINT 0x00
+#define CBOR_ARRAY 0x80
+
+static uint8_t * putCborHead(uint8_t * p, uint8_t major, uint32_t value) {
+  if (value < 24) {
+    *p++ = major | (uint8_t)value;
+  } else if (value <= 0xFF) {
+    *p++ = major | 24;
+    *p++ = (uint8_t)value;
+  } else if (value <= 0xFFFF) {
+    *p++ = major | 25;
+    *p++ = (uint8_t)(value >> 8);
+    *p++ = (uint8_t)value;
+  } else {
+    *p++ = major | 26;
+    *p++ = (uint8_t)(value >> 24);
+    *p++ = (uint8_t)(value >> 16);
+    *p++ = (uint8_t)(value >> 8);
+    *p++ = (uint8_t)value;
+  }
+  return p;
+}
+
+/**
+ * Escribe el arreglo CBOR de una muestra. El llamador garantiza CBOR_SAMPLE_MAX bytes libres.
+ */
+static uint8_t * putSampleCbor(uint8_t * p, const SensorData * data) {
+  uint16_t pms[PMS_CHANNELS] = {};
+  if (data->pms7003_valido) memcpy(pms, &data->pms7003, sizeof(pms));
+  uint8_t flags = (data->ccs811_valido ? CBOR_FLAG_CCS811 : 0) | (data->pms7003_valido ? CBOR_FLAG_PMS7003 : 0);
+
+  p = putCborHead(p, CBOR_ARRAY, CBOR_SAMPLE_ITEMS);
+  p = putCborHead(p, CBOR_UINT, TELEMETRY_CBOR_VERSION);
+  p = putCborHead(p, CBOR_UINT, flags);
+  p = putCborHead(p, CBOR_UINT, data->ccs811_valido ? data->co2 : 0);
+  p = putCborHead(p, CBOR_UINT, data->ccs811_valido ? data->tvoc : 0);
+  for (size_t i = 0; i < PMS_CHANNELS; i++) {
+    p = putCborHead(p, CBOR_UINT, pms[i]);
+  }
+  return p;
+}
+
+static const uint8_t * getCborUint(const uint8_t * p, const uint8_t * end, uint8_t major, uint16_t * value) {
+  if (p >= end || (*p & 0xE0) != major) return NULL;
+  uint8_t info = *p++ & 0x1F;
+  if (info < 24) {
+    *value = info;
+  } else if (info == 24) {
+    if (end - p < 1) return NULL;
+    *value = *p++;
+  } else if (info == 25) {
+    if (end - p < 2) return NULL;
+    *value = (uint16_t)((p[0] << 8) | p[1]);
+    p += 2;
+  } else {
+    return NULL;                    // Valores de 32/64 bits no caben en ningún campo
+  }
+  return p;
+}
+
+/**
+ * Escribe la muestra completa como arreglo CBOR versionado en buf, sin heap.
+ * Retorna la longitud escrita o 0 si el buffer no alcanza.
+ */
+size_t encodeSensorDataCbor(const SensorData * data, uint8_t * buf, size_t size) {
+  uint32_t startCycles = telemetryCycles();
+  uint32_t startMicros = telemetryMicros();
+  size_t len = 0;
+  // Se valida una sola vez el peor caso en lugar de revisar cada escritura
+  if (size >= CBOR_SAMPLE_MAX) {
+    len = (size_t)(putSampleCbor(buf, data) - buf);
+  }
+  recordEncode(startCycles, startMicros, len);
+  return len;
+}
+
+/**
+ * Escribe un lote como arreglo CBOR [ts, [dt, <muestra>], [dt, <muestra>], ...]
+ * donde ts es la marca de la primera muestra y dt el desfase en segundos.
+ * Retorna la longitud escrita o 0 si el buffer no alcanza.
+ */
+size_t encodeBatchCbor(const TimedSample * const * samples, size_t count, uint8_t * buf, size_t size) {
+  uint32_t startCycles = telemetryCycles();
+  uint32_t startMicros = telemetryMicros();
+  uint32_t base = count > 0 ? samples[0]->timestamp : 0;
+  const uint8_t * end = buf + size;
+  uint8_t * p = buf;
+  size_t len = 0;
+  if (size >= 10) {
+    p = putCborHead(p, CBOR_ARRAY, (uint32_t)count + 1);
+    p = putCborHead(p, CBOR_UINT, base);
+    size_t i = 0;
+    for (; i < count && end - p >= CBOR_BATCH_ITEM_MAX; i++) {
+      p = putCborHead(p, CBOR_ARRAY, 2);
+      p = putCborHead(p, CBOR_UINT, samples[i]->timestamp - base);
+      p = putSampleCbor(p, &samples[i]->data);
+    }
+    if (i == count) len = (size_t)(p - buf);
+  }
+  recordEncode(startCycles, startMicros, len);
+  return len;
+}
+
+/**
+ * Decodifica una muestra escrita por encodeSensorDataCbor().
+ * Retorna false si el mensaje está truncado, tiene otra versión o trae bytes de más.
+ */
+bool decodeSensorDataCbor(const uint8_t * buf, size_t length, SensorData * data) {
+  const uint8_t * p = buf;
+  const uint8_t * end = buf + length;
+  uint16_t version, flags;
+  if (p >= end || *p++ != (CBOR_ARRAY | CBOR_SAMPLE_ITEMS)) return false;
+  if (!(p = getCborUint(p, end, CBOR_UINT, &version)) || version != TELEMETRY_CBOR_VERSION) return false;
+  if (!(p = getCborUint(p, end, CBOR_UINT, &flags))) return false;
+  if (!(p = getCborUint(p, end, CBOR_UINT, &data->co2))) return false;
+  if (!(p = getCborUint(p, end, CBOR_UINT, &data->tvoc))) return false;
+  uint16_t pms[PMS_CHANNELS];
+  for (size_t i = 0; i < PMS_CHANNELS; i++) {
+    if (!(p = getCborUint(p, end, CBOR_UINT, &pms[i]))) return false;
+  }
+  if (p != end) return false;
+  memcpy(&data->pms7003, pms, sizeof(pms));
+  data->ccs811_valido = (flags & CBOR_FLAG_CCS811) != 0;
+  data->pms7003_valido = (flags & CBOR_FLAG_PMS7003) != 0;
+  return true;
+}
+
+const TelemetryStats & getTelemetryStats() {
+  return stats;
+}
+
+void resetTelemetryStats() {
+  memset(&stats, 0, sizeof(stats));
+}
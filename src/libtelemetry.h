@@ -0,0 +1,63 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBTELEMETRY_H
+#define LIBTELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libsensordata.h>
+
+// Este módulo no depende de Arduino para poder compilarse y medirse en el host.
+
+#define TELEMETRY_JSON_MAX 256      ///< Tamaño del buffer JSON de una muestra (peor caso ~200 bytes)
+#define TELEMETRY_CBOR_MAX 48       ///< Tamaño del buffer CBOR de una muestra (peor caso 45 bytes)
+#define TELEMETRY_CBOR_VERSION 1    ///< Versión del layout CBOR; cambia si se agregan o reordenan campos
+#define TELEMETRY_BATCH_MAX(n) (48 + (n) * (TELEMETRY_JSON_MAX + 12)) ///< Peor caso de un lote JSON de n muestras (cubre también CBOR)
+
+// Codificaciones disponibles para publicar las muestras
+enum TelemetryFormat {
+  TELEMETRY_FORMAT_JSON = 0,        ///< JSON de texto en TOPIC_PUB
+  TELEMETRY_FORMAT_CBOR = 1         ///< Arreglo CBOR compacto en TOPIC_PUB_CBOR
+};
+
+// Estadísticas de la última codificación y acumuladas
+struct TelemetryStats {
+  uint32_t encodes;                 ///< Número de codificaciones realizadas
+  uint32_t overflows;               ///< Codificaciones que no cupieron en el buffer
+  uint32_t lastBytes;               ///< Bytes producidos por la última codificación
+  uint32_t lastCycles;              ///< Ciclos de CPU de la última codificación
+  uint32_t maxCycles;               ///< Peor caso de ciclos observado
+  uint32_t lastMicros;              ///< Duración de la última codificación en microsegundos
+};
+
+size_t encodeSensorDataJson(const SensorData * data, char * buf, size_t size); ///< Escribe la muestra como JSON en buf sin usar el heap. Retorna los bytes escritos o 0 si no cabe
+size_t encodeSensorDataCbor(const SensorData * data, uint8_t * buf, size_t size); ///< Escribe la muestra completa como arreglo CBOR versionado. Retorna los bytes escritos o 0 si no cabe
+bool decodeSensorDataCbor(const uint8_t * buf, size_t length, SensorData * data); ///< Decodifica una muestra CBOR. Retorna false si el formato o la versión no coinciden
+size_t encodeBatchJson(const TimedSample * const * samples, size_t count, char * buf, size_t size); ///< Escribe un lote {"ts","dt","samples"} en buf. Retorna los bytes escritos o 0 si no cabe
+size_t encodeBatchCbor(const TimedSample * const * samples, size_t count, uint8_t * buf, size_t size); ///< Escribe un lote CBOR [ts, [dt, muestra]...] en buf. Retorna los bytes escritos o 0 si no cabe
+const TelemetryStats & getTelemetryStats(); ///< Retorna las estadísticas del codificador
+void resetTelemetryStats();         ///< Reinicia las estadísticas del codificador
+
+#endif /* LIBTELEMETRY_H */
@@ -0,0 +1,273 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <lwip/sockets.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/net_sockets.h>
+#include <libtls.h>
+#include <libstorage.h>
+
+// La sesión se guarda serializada (mbedtls_ssl_session_save) precedida por un
+// hash del servidor, para no ofrecer a un broker la sesión de otro. El mismo
+// bloque es el que se guarda en NVS.
+static uint8_t sessionBlob[sizeof(uint32_t) + TLS_SESSION_MAX];
+static uint8_t * const session = sessionBlob + sizeof(uint32_t);
+static size_t sessionLen = 0;
+static bool sessionLoaded = false;  // Ya se intentó recuperar la sesión de NVS
+
+// La cadena de confianza se interpreta una sola vez y se comparte entre conexiones
+static mbedtls_x509_crt caChain;
+static const char *caChainSource = nullptr;
+
+static uint32_t hostHash(const char *host, uint16_t port) {
+  uint32_t h = 2166136261u;         // FNV-1a
+  for (const char *c = host; c && *c; c++) {
+    h = (h ^ (uint8_t)*c) * 16777619u;
+  }
+  return (h ^ port) * 16777619u;
+}
+
+static uint32_t sessionHost() {
+  uint32_t host;
+  memcpy(&host, sessionBlob, sizeof(host));
+  return host;
+}
+
+static void storeSession(uint32_t host, const uint8_t *data, size_t len, bool persist) {
+  if (len > TLS_SESSION_MAX) return;
+  memcpy(sessionBlob, &host, sizeof(host));
+  memcpy(session, data, len);
+  sessionLen = len;
+#if TLS_SESSION_PERSIST
+  if (persist) {
+    saveTlsSession(sessionBlob, sizeof(uint32_t) + len);
+  }
+#endif
+}
+
+static void dropSession() {
+  sessionLen = 0;
+#if TLS_SESSION_PERSIST
+  clearTlsSession();
+#endif
+}
+
+/**
+ * Recupera de NVS la sesión del arranque anterior, una sola vez.
+ */
+static void restoreSession() {
+  if (sessionLoaded) return;
+  sessionLoaded = true;
+#if TLS_SESSION_PERSIST
+  size_t len = loadTlsSession(sessionBlob, sizeof(sessionBlob));
+  sessionLen = len > sizeof(uint32_t) ? len - sizeof(uint32_t) : 0;
+#endif
+}
+
+/**
+ * Abre el socket TCP con el mismo esquema que ssl_client.cpp: connect no
+ * bloqueante acotado por timeoutMs y luego socket bloqueante con timeouts.
+ */
+static int openSocket(IPAddress ip, uint16_t port, int timeoutMs) {
+  int fd = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) return -1;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = (uint32_t)ip;
+  addr.sin_port = htons(port);
+  if (timeoutMs <= 0) timeoutMs = 30000;
+
+  int res = lwip_connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+  if (res < 0 && errno != EINPROGRESS) {
+    lwip_close(fd);
+    return -1;
+  }
+  fd_set fdset;
+  FD_ZERO(&fdset);
+  FD_SET(fd, &fdset);
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  res = select(fd + 1, nullptr, &fdset, nullptr, &tv);
+  int sockerr = 0;
+  socklen_t len = sizeof(sockerr);
+  if (res <= 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &sockerr, &len) < 0 || sockerr != 0) {
+    lwip_close(fd);
+    return -1;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+  lwip_setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  lwip_setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  int enable = 1;
+  lwip_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  lwip_setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+  return fd;
+}
+
+int ResumableClientSecure::connect(IPAddress ip, uint16_t port) {
+  // Sin nombre de servidor no hay con qué asociar la sesión ni verificar el certificado
+  return WiFiClientSecure::connect(ip, port);
+}
+
+int ResumableClientSecure::connect(const char *host, uint16_t port) {
+  // Solo el modo con certificado raíz reanuda sesiones; el resto lo resuelve la clase base
+  if (_use_insecure || _CA_cert == nullptr || _cert != nullptr || _pskIdent != nullptr) {
+    return WiFiClientSecure::connect(host, port);
+  }
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) {
+    stats.failed++;
+    return 0;
+  }
+  return connectResumable(ip, port, host);
+}
+
+/**
+ * Réplica de start_ssl_client() que ofrece la sesión guardada antes del handshake
+ * y guarda la nueva al terminar. Deja sslclient en el mismo estado que la versión
+ * original, así que read/write/stop de WiFiClientSecure siguen funcionando.
+ */
+int ResumableClientSecure::connectResumable(IPAddress ip, uint16_t port, const char *host) {
+  stop();
+  ssl_init(sslclient);
+  mbedtls_entropy_init(&sslclient->entropy_ctx);
+  restoreSession();
+
+  unsigned long start = millis();
+  sslclient->socket = openSocket(ip, port, _timeout);
+  if (sslclient->socket < 0) {
+    stats.failed++;
+    stop();
+    return 0;
+  }
+
+  static const char *pers = "esp32-tls";
+  int ret = mbedtls_ctr_drbg_seed(&sslclient->drbg_ctx, mbedtls_entropy_func, &sslclient->entropy_ctx,
+                                  (const unsigned char *)pers, strlen(pers));
+  if (ret == 0) {
+    ret = mbedtls_ssl_config_defaults(&sslclient->ssl_conf, MBEDTLS_SSL_IS_CLIENT,
+                                      MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (ret == 0 && caChainSource != _CA_cert) {
+    // El certificado raíz cambió (o es la primera conexión): se interpreta de nuevo
+    mbedtls_x509_crt_free(&caChain);
+    mbedtls_x509_crt_init(&caChain);
+    ret = mbedtls_x509_crt_parse(&caChain, (const unsigned char *)_CA_cert, strlen(_CA_cert) + 1);
+    caChainSource = ret == 0 ? _CA_cert : nullptr;
+  }
+  if (ret == 0) {
+    mbedtls_ssl_conf_authmode(&sslclient->ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&sslclient->ssl_conf, &caChain, nullptr);
+    mbedtls_ssl_conf_rng(&sslclient->ssl_conf, mbedtls_ctr_drbg_random, &sslclient->drbg_ctx);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&sslclient->ssl_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+    ret = mbedtls_ssl_setup(&sslclient->ssl_ctx, &sslclient->ssl_conf);
+  }
+  if (ret == 0) {
+    ret = mbedtls_ssl_set_hostname(&sslclient->ssl_ctx, host);
+  }
+  if (ret != 0) {
+    _lastError = ret;
+    stats.failed++;
+    stop();
+    return 0;
+  }
+  mbedtls_ssl_set_bio(&sslclient->ssl_ctx, &sslclient->socket, mbedtls_net_send, mbedtls_net_recv, nullptr);
+
+  // Ofrece la sesión anterior si es del mismo servidor
+  uint32_t hash = hostHash(host, port);
+  bool offered = false;
+  if (sessionLen > 0 && sessionHost() == hash) {
+    mbedtls_ssl_session saved;
+    mbedtls_ssl_session_init(&saved);
+    if (mbedtls_ssl_session_load(&saved, session, sessionLen) == 0 &&
+        mbedtls_ssl_set_session(&sslclient->ssl_ctx, &saved) == 0) {
+      offered = true;
+    } else {
+      dropSession();
+    }
+    mbedtls_ssl_session_free(&saved);
+  }
+
+  // Handshake paso a paso: si se llega al intercambio de claves el servidor
+  // rechazó la reanudación y el handshake es completo
+  bool full = false;
+  unsigned long timeout = sslclient->handshake_timeout ? sslclient->handshake_timeout : 120000;
+  while (sslclient->ssl_ctx.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+    ret = mbedtls_ssl_handshake_step(&sslclient->ssl_ctx);
+    if (sslclient->ssl_ctx.state == MBEDTLS_SSL_CLIENT_KEY_EXCHANGE) {
+      full = true;
+    }
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+      ret = 0;
+    }
+    if (ret != 0 || millis() - start > timeout) {
+      break;
+    }
+  }
+  if (ret == 0 && sslclient->ssl_ctx.state == MBEDTLS_SSL_HANDSHAKE_OVER &&
+      mbedtls_ssl_get_verify_result(&sslclient->ssl_ctx) != 0) {
+    ret = MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+  }
+  if (ret != 0 || sslclient->ssl_ctx.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+    _lastError = ret;
+    stats.failed++;
+    if (offered) dropSession();    // Puede que el servidor ya no acepte esta sesión
+    stop();
+    return 0;
+  }
+
+  stats.lastHandshakeMs = millis() - start;
+  if (full || !offered) {
+    stats.full++;
+  } else {
+    stats.resumed++;
+  }
+  // Guarda la sesión vigente (el servidor puede haber emitido un ticket nuevo).
+  // En NVS solo tras un handshake completo, para no escribir la flash en cada reconexión.
+  mbedtls_ssl_session current;
+  mbedtls_ssl_session_init(&current);
+  static uint8_t buf[TLS_SESSION_MAX];
+  size_t len = 0;
+  if (mbedtls_ssl_get_session(&sslclient->ssl_ctx, &current) == 0 &&
+      mbedtls_ssl_session_save(&current, buf, sizeof(buf), &len) == 0) {
+    storeSession(hash, buf, len, full || !offered);
+  }
+  mbedtls_ssl_session_free(&current);
+  _connected = true;
+  return 1;
+}
+
+void ResumableClientSecure::forgetSession() {
+  sessionLoaded = true;
+  dropSession();
+}
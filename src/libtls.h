@@ -0,0 +1,65 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBTLS_H
+#define LIBTLS_H
+
+#include <WiFiClientSecure.h>
+
+#ifndef TLS_SESSION_MAX
+#define TLS_SESSION_MAX 2048        ///< Tamaño máximo de la sesión TLS serializada (incluye el certificado del servidor)
+#endif
+#ifndef TLS_SESSION_PERSIST
+#define TLS_SESSION_PERSIST 1       ///< 1: guarda la sesión en NVS para reanudarla tras un reinicio o deep sleep
+#endif
+
+// Contadores de handshakes de la conexión TLS
+struct TlsStats {
+  uint32_t full;                    ///< Handshakes completos (verificación de cadena e intercambio de claves)
+  uint32_t resumed;                 ///< Handshakes abreviados reanudando una sesión guardada
+  uint32_t failed;                  ///< Conexiones o handshakes fallidos
+  uint32_t lastHandshakeMs;         ///< Duración del último handshake exitoso
+};
+
+/**
+ * Cliente TLS que reanuda la sesión anterior (session ID o session ticket, RFC 5077)
+ * en lugar de hacer un handshake completo en cada reconexión. Reemplaza la conexión
+ * de WiFiClientSecure cuando se usa un certificado raíz (setCACert); en cualquier
+ * otro modo (inseguro, PSK, certificado de cliente) delega en la clase base.
+ * Lectura, escritura y cierre siguen siendo los de WiFiClientSecure.
+ */
+class ResumableClientSecure : public WiFiClientSecure {
+public:
+  using WiFiClientSecure::connect;
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+  void forgetSession();             ///< Descarta la sesión guardada en RAM y en NVS
+  const TlsStats & getStats() const { return stats; }
+
+private:
+  int connectResumable(IPAddress ip, uint16_t port, const char *host);
+  TlsStats stats = {};
+};
+
+#endif /* LIBTLS_H */
@@ -0,0 +1,63 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <libtopics.h>
+#include <stdio.h>
+#include <string.h>
+
+static_assert(sizeof(OTA_TOPIC) <= TOPIC_MAX_LENGTH, "OTA_TOPIC no cabe en TOPIC_MAX_LENGTH");
+
+// Último nivel de cada tópico del dispositivo, en el orden de TopicId
+static const char * const topicSuffixes[TOPIC_OTA] = {
+  "out", "in", "cbor", "batch", "boot", "summary", "delta", "ota_status"
+};
+
+static char deviceId[DEVICE_ID_SIZE];
+static char topics[TOPIC_COUNT][TOPIC_MAX_LENGTH];
+
+/**
+ * Arma el ID del dispositivo a partir de la MAC y los tópicos en sus buffers
+ * estáticos. Se puede volver a llamar (por ejemplo al despertar del deep
+ * sleep): escribe siempre los mismos buffers.
+ */
+bool topicsBegin(const char * location, const char * user, const uint8_t mac[6]) {
+  snprintf(deviceId, sizeof(deviceId), "ESP32-%02X%02X%02X%02X%02X%02X",
+           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  bool fits = true;
+  for (int t = 0; t < TOPIC_OTA; t++) {
+    int n = snprintf(topics[t], TOPIC_MAX_LENGTH, "%s/%s/%s/%s", location, deviceId, user, topicSuffixes[t]);
+    if (n < 0 || n >= TOPIC_MAX_LENGTH) fits = false;
+  }
+  memcpy(topics[TOPIC_OTA], OTA_TOPIC, sizeof(OTA_TOPIC));
+  return fits;
+}
+
+const char * getTopic(TopicId id) {
+  if (id < 0 || id >= TOPIC_COUNT) return "";
+  return topics[id];
+}
+
+const char * getDeviceId() {
+  return deviceId;
+}
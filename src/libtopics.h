@@ -0,0 +1,61 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef LIBTOPICS_H
+#define LIBTOPICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Tabla de los tópicos MQTT del dispositivo y de su ID. Cada tópico tiene la
+// estructura <país>/<estado>/<ciudad>/<ID>/<usuario>/<sufijo>: la ubicación y el
+// usuario son literales concatenados en compilación (secrets.cpp) y el ID sale
+// de la MAC. topicsBegin() llena una sola vez buffers estáticos de tamaño fijo,
+// así que la memoria es la misma en todos los dispositivos y no se usa el heap
+// durante la inicialización estática. Este módulo no depende de Arduino.
+
+#ifndef OTA_TOPIC
+#define OTA_TOPIC "dispositivo/device1/ota" ///< Tópico común a la flota para anunciar actualizaciones OTA
+#endif
+#define TOPIC_MAX_LENGTH 96         ///< Tamaño de cada buffer de tópico, con el terminador
+#define DEVICE_ID_SIZE 19           ///< "ESP32-" + 12 dígitos hexadecimales de la MAC + terminador
+
+typedef enum {
+  TOPIC_PUB = 0,                    ///< Muestras JSON: <...>/out
+  TOPIC_SUB,                        ///< Comandos y alertas: <...>/in
+  TOPIC_PUB_CBOR,                   ///< Muestras CBOR: <...>/cbor
+  TOPIC_PUB_BATCH,                  ///< Lotes de muestras (JSON empieza con '{', CBOR con un arreglo): <...>/batch
+  TOPIC_PUB_BOOT,                   ///< Reporte de arranque (retenido): <...>/boot
+  TOPIC_PUB_SUMMARY,                ///< Resúmenes por ventana: <...>/summary
+  TOPIC_PUB_DELTA,                  ///< Envío por excepción (solo los canales que cambiaron): <...>/delta
+  TOPIC_PUB_OTA,                    ///< Progreso de la actualización OTA (retenido): <...>/ota_status
+  TOPIC_OTA,                        ///< OTA_TOPIC, sin partes del dispositivo
+  TOPIC_COUNT
+} TopicId;
+
+bool topicsBegin(const char * location, const char * user, const uint8_t mac[6]); ///< Arma el ID y los tópicos; false si alguno no cabe en TOPIC_MAX_LENGTH
+const char * getTopic(TopicId id);  ///< Tópico armado por topicsBegin() ("" antes de llamarla)
+const char * getDeviceId();         ///< "ESP32-XXXXXXXXXXXX", también ID del cliente MQTT ("" antes de topicsBegin())
+
+#endif /* LIBTOPICS_H */
@@ -3,34 +3,249 @@
 #include <libwifi.h>
 #include <libdisplay.h>
 #include <libstorage.h>
+#include <libbackoff.h>
 #include <Arduino.h>
 
 
+// Estado del gestor de conexión. Los eventos de WiFi llegan desde la tarea de
+// eventos del sistema, por eso solo marcan banderas; checkWiFi() las procesa
+// desde loop() sin bloquear.
+static WiFiState state = WIFI_STATE_IDLE;
+static WiFiTimings timings = {};
+static Backoff wifiBackoff = { WIFI_BACKOFF_BASE_MS, WIFI_BACKOFF_MAX_MS, 0 };
+static unsigned long attemptStart = 0;    // millis() en que empezó el intento actual
+static unsigned long retryAt = 0;         // millis() en que vence la espera actual
+static volatile bool evAssociated = false;
+static volatile bool evGotIP = false;
+static volatile bool evDisconnected = false;
+static volatile unsigned long evAssociatedAt = 0;
+static volatile unsigned long evGotIPAt = 0;
+static volatile uint8_t evReason = 0;
+static volatile bool leaveExpected = false;   // Se llamó a WiFi.disconnect()/reconnect() y su evento aún no llega
+static bool eventsRegistered = false;
+
+// Tipo de intento en curso
+enum WiFiAttempt {
+  WIFI_ATTEMPT_FULL,                // Escaneo completo y DHCP
+  WIFI_ATTEMPT_CACHED,              // Canal, BSSID e IP de la caché de NVS
+  WIFI_ATTEMPT_LEASE,               // Canal y BSSID de la caché, IP renovada por DHCP
+  WIFI_ATTEMPT_RECONNECT            // Reasociación tras una desconexión
+};
+static WiFiAttempt attemptKind = WIFI_ATTEMPT_FULL;
+
+// Conexiones con la IP en caché desde el último DHCP. Vive en memoria RTC para
+// sobrevivir al deep sleep sin escribir la flash en cada despertar; tras un
+// arranque en frío parte del límite, así que la primera conexión renueva el
+// lease (el equipo pudo estar apagado más tiempo que el lease)
+RTC_DATA_ATTR static uint16_t cachedIpUses = WIFI_FAST_CONNECT_MAX_USES;
+static bool staticIp = false;             // La configuración IP activa es la de la caché (sin DHCP)
+
+static void onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+      leaveExpected = false;
+      evAssociatedAt = millis();
+      evAssociated = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      evGotIPAt = millis();
+      evGotIP = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      // WiFi.disconnect() y WiFi.reconnect() generan su propio evento con
+      // ASSOC_LEAVE, que llega por la cola de eventos después de que
+      // beginAttempt() limpió las banderas; no es un fallo del intento nuevo.
+      // Solo se descarta ese eco: un ASSOC_LEAVE sin llamada previa es real
+      if (info.wifi_sta_disconnected.reason == WIFI_REASON_ASSOC_LEAVE && leaveExpected) {
+        leaveExpected = false;
+        break;
+      }
+      evReason = info.wifi_sta_disconnected.reason;
+      evDisconnected = true;
+      break;
+    default:
+      break;
+  }
+}
+
 /**
- * Verifica si el dispositivo está conectado al WiFi.
- * Si no está conectado intenta reconectar a la red.
- * Si está conectado, intenta conectarse a MQTT si aún 
- * no se tiene conexión.
+ * Lanza la conexión a la red guardada en NVS o, si no hay, a la de secrets.cpp.
+ * Con la caché de reconexión rápida se fija el canal y el BSSID (sin escaneo)
+ * y, si staticIp, la última configuración IP (sin DHCP).
  */
-void checkWiFi() {
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("WiFi connection lost. Reconnecting...");
-    WiFi.reconnect();
-    
-    // Wait for reconnection
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-      delay(500);
-      Serial.print(".");
-      attempts++;
-    }
-    
-    if (WiFi.status() == WL_CONNECTED) {
-      Serial.println("\nWiFi reconnected");
+static void beginConfigured(const WiFiFastConnect *fc, bool useStaticIp) {
+  String s, p;
+  if (!loadWiFiCredentials(s, p)) {
+    s = ssid;
+    p = password;
+  }
+  staticIp = fc && useStaticIp;
+  if (staticIp) {
+    WiFi.config(IPAddress(fc->ip), IPAddress(fc->gateway), IPAddress(fc->mask), IPAddress(fc->dns));
+  } else {
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);   // Vuelve a DHCP
+  }
+  if (fc) {
+    WiFi.begin(s.c_str(), p.c_str(), fc->channel, fc->bssid);
+  } else {
+    WiFi.begin(s.c_str(), p.c_str());
+  }
+}
+
+/**
+ * Lanza un intento de conexión sin esperar el resultado.
+ */
+static void beginAttempt(WiFiAttempt kind) {
+  evAssociated = false;
+  evGotIP = false;
+  evDisconnected = false;
+  attemptStart = millis();
+  attemptKind = kind;
+  timings.attempts++;
+  if (kind == WIFI_ATTEMPT_RECONNECT) {
+    leaveExpected = true;
+    WiFi.reconnect();             // Reasocia con la red conocida sin reconfigurar
+  } else if (kind == WIFI_ATTEMPT_CACHED) {
+    WiFiFastConnect fc;
+    if (!loadWiFiFastConnect(fc)) {
+      attemptKind = WIFI_ATTEMPT_FULL;
+      beginConfigured(nullptr, false);
+    } else if (cachedIpUses >= WIFI_FAST_CONNECT_MAX_USES) {
+      // Con IP fija el lease nunca se renueva y el servidor DHCP podría
+      // reasignarla: cada tanto se pide por DHCP, sin perder el canal y BSSID
+      Serial.printf("WiFi: fast connect to channel %u, renewing IP by DHCP\n", (unsigned)fc.channel);
+      attemptKind = WIFI_ATTEMPT_LEASE;
+      timings.leaseRefreshes++;
+      beginConfigured(&fc, false);
     } else {
-      Serial.println("\nWiFi reconnection failed");
+      Serial.printf("WiFi: fast connect to channel %u\n", (unsigned)fc.channel);
+      beginConfigured(&fc, true);
     }
+  } else {
+    beginConfigured(nullptr, false);
   }
+  state = WIFI_STATE_CONNECTING;
+}
+
+/**
+ * Guarda el BSSID, canal y configuración IP de la conexión actual (en NVS solo
+ * si cambiaron); la IP recién obtenida por DHCP puede reutilizarse
+ * WIFI_FAST_CONNECT_MAX_USES veces.
+ */
+static void saveFastConnect() {
+  WiFiFastConnect fc;
+  memset(&fc, 0, sizeof(fc));     // Sin basura en el relleno: se compara con memcmp
+  const uint8_t *bssid = WiFi.BSSID();
+  if (!bssid) return;
+  memcpy(fc.bssid, bssid, sizeof(fc.bssid));
+  fc.channel = (uint8_t)WiFi.channel();
+  fc.ip = (uint32_t)WiFi.localIP();
+  fc.gateway = (uint32_t)WiFi.gatewayIP();
+  fc.mask = (uint32_t)WiFi.subnetMask();
+  fc.dns = (uint32_t)WiFi.dnsIP(0);
+  saveWiFiFastConnect(fc);
+}
+
+static void scheduleRetry() {
+  uint32_t wait = backoffNext(&wifiBackoff, esp_random());
+  retryAt = millis() + wait;
+  state = WIFI_STATE_WAIT_RETRY;
+  Serial.printf("WiFi: retrying in %lu ms\n", (unsigned long)wait);
+}
+
+/**
+ * Verifica si el dispositivo está conectado al WiFi y avanza la máquina de
+ * estados de conexión. No bloquea: se llama en cada pasada de loop().
+ * Tras una desconexión se intenta primero una reasociación inmediata
+ * (reconexión rápida) y luego reintentos con backoff exponencial y jitter.
+ */
+void checkWiFi() {
+  switch (state) {
+    case WIFI_STATE_IDLE:
+      break;
+
+    case WIFI_STATE_CONNECTED:
+      if (evDisconnected || WiFi.status() != WL_CONNECTED) {
+        timings.disconnects++;
+        Serial.printf("WiFi connection lost (reason %u). Reconnecting...\n", (unsigned)evReason);
+        backoffReset(&wifiBackoff);
+        beginAttempt(WIFI_ATTEMPT_RECONNECT);
+      }
+      break;
+
+    case WIFI_STATE_CONNECTING: {
+      // Con IP fija no hay DHCP: el intento con caché se da por fallido antes
+      unsigned long timeout = attemptKind == WIFI_ATTEMPT_CACHED ? WIFI_FAST_CONNECT_TIMEOUT_MS : WIFI_CONNECT_TIMEOUT_MS;
+      if (evAssociated) {
+        evAssociated = false;
+        timings.lastAssociateMs = evAssociatedAt - attemptStart;
+      }
+      if (evGotIP && WiFi.status() == WL_CONNECTED) {
+        evGotIP = false;
+        evDisconnected = false;
+        timings.lastGotIPMs = evGotIPAt - attemptStart;
+        timings.connects++;
+        // Una reasociación conserva la configuración IP del intento anterior
+        if (staticIp) {
+          cachedIpUses++;
+        } else {
+          cachedIpUses = 0;
+        }
+        if (attemptKind == WIFI_ATTEMPT_CACHED) {
+          timings.fastConnects++;
+        } else {
+          saveFastConnect();
+        }
+        backoffReset(&wifiBackoff);
+        state = WIFI_STATE_CONNECTED;
+        Serial.print("WiFi connected, IP address: ");
+        Serial.println(WiFi.localIP());
+        Serial.printf("WiFi timings: associate %lu ms, IP %lu ms\n",
+                      (unsigned long)timings.lastAssociateMs, (unsigned long)timings.lastGotIPMs);
+      } else if ((attemptKind == WIFI_ATTEMPT_CACHED || attemptKind == WIFI_ATTEMPT_LEASE) &&
+                 (evDisconnected || millis() - attemptStart >= timeout)) {
+        // El AP cambió de canal, de BSSID o de red: se descarta la caché y se
+        // hace de inmediato el camino completo con escaneo y DHCP
+        timings.fastFailures++;
+        Serial.println("WiFi fast connect failed, falling back to full scan");
+        leaveExpected = true;
+        WiFi.disconnect();
+        clearWiFiFastConnect();
+        beginAttempt(WIFI_ATTEMPT_FULL);
+      } else if (evDisconnected || millis() - attemptStart >= timeout) {
+        timings.failures++;
+        Serial.printf("WiFi connection attempt failed (reason %u)\n", (unsigned)evReason);
+        leaveExpected = true;
+        WiFi.disconnect();
+        scheduleRetry();
+      }
+      break;
+    }
+
+    case WIFI_STATE_WAIT_RETRY:
+      if ((long)(millis() - retryAt) >= 0) {
+        leaveExpected = false;          // El eco del disconnect() ya llegó durante la espera
+        beginAttempt(WIFI_ATTEMPT_FULL);
+      }
+      break;
+  }
+}
+
+bool hasWiFiFastConnect() {
+  WiFiFastConnect fc;
+  return loadWiFiFastConnect(fc);
+}
+
+bool wifiConnected() {
+  return state == WIFI_STATE_CONNECTED;
+}
+
+WiFiState wifiState() {
+  return state;
+}
+
+const WiFiTimings & getWiFiTimings() {
+  return timings;
 }
 
 /**
@@ -75,37 +290,26 @@ String getHostname() {
 }
 
 /**
- * Inicia el servicio de WiFi e intenta conectarse a la red WiFi específicada en las constantes.
+ * Inicia el servicio de WiFi y lanza la conexión a la red guardada en NVS o, si no
+ * hay, a la de secrets.cpp. No espera el resultado: checkWiFi() lo atiende.
  */
 void startWiFi(const char* hostname) {
   if (hostname && strlen(hostname) > 0) {
     WiFi.setHostname(hostname);
   }
-  
-  String s, p;
-  if (loadWiFiCredentials(s, p)) {
+  if (!eventsRegistered) {
+    WiFi.onEvent(onWiFiEvent);
+    eventsRegistered = true;
+  }
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);   // Los reintentos los gestiona checkWiFi()
+  if (hasWiFiCredentials()) {
     Serial.println("Using stored WiFi credentials from NVS");
-    WiFi.begin(s.c_str(), p.c_str());
   } else {
     Serial.println("Using built-in WiFi credentials (secrets.cpp)");
-    WiFi.begin(ssid, password);
-  }
-  
-  // Wait for connection
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-    delay(500);
-    Serial.print(".");
-    attempts++;
-  }
-  
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("\nWiFi connected");
-    Serial.print("IP address: ");
-    Serial.println(WiFi.localIP());
-  } else {
-    Serial.println("\nWiFi connection failed");
   }
+  backoffReset(&wifiBackoff);
+  beginAttempt(WIFI_ATTEMPT_CACHED);
 }
 
 bool hasStoredWiFi() {
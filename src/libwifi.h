@@ -25,11 +25,44 @@
 #ifndef LIBWIFI_H
 #define LIBWIFI_H
 
+#include <stdint.h>
+
+#define WIFI_CONNECT_TIMEOUT_MS 10000 //< Tiempo máximo de un intento de conexión antes de reintentar
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000 //< Tiempo máximo del intento con BSSID/canal/IP en caché
+#define WIFI_FAST_CONNECT_MAX_USES 16 //< Conexiones con la IP en caché antes de renovarla por DHCP (el lease no se renueva con IP fija); también se renueva tras un arranque en frío
+#define WIFI_BACKOFF_BASE_MS 500      //< Espera inicial entre intentos de conexión
+#define WIFI_BACKOFF_MAX_MS 30000     //< Espera máxima entre intentos de conexión
+
+// Estados del gestor de conexión WiFi
+enum WiFiState {
+  WIFI_STATE_IDLE,                  //< startWiFi() aún no se ha llamado
+  WIFI_STATE_CONNECTING,            //< Intento en curso (asociación y DHCP)
+  WIFI_STATE_CONNECTED,             //< Asociado y con dirección IP
+  WIFI_STATE_WAIT_RETRY             //< Esperando el backoff antes del siguiente intento
+};
+
+// Contadores y tiempos de conexión (en ms desde el inicio de cada intento)
+struct WiFiTimings {
+  uint32_t attempts;                //< Intentos de conexión lanzados
+  uint32_t connects;                //< Conexiones exitosas
+  uint32_t failures;                //< Intentos fallidos o vencidos
+  uint32_t disconnects;             //< Pérdidas de conexión
+  uint32_t fastConnects;            //< Conexiones logradas con la caché de reconexión rápida
+  uint32_t fastFailures;            //< Intentos con caché que fallaron y pasaron al camino completo
+  uint32_t leaseRefreshes;          //< Intentos con canal y BSSID en caché pero IP por DHCP
+  uint32_t lastAssociateMs;         //< Tiempo hasta asociarse con el AP en el último intento
+  uint32_t lastGotIPMs;             //< Tiempo hasta obtener IP en el último intento
+};
+
 extern const char* ssid;            //< Cambia por el nombre de tu red WiFi
 extern const char* password;        //< Cambia por la contraseña de tu red WiFi
 void listWiFiNetworks();            //< Función para listar las redes WiFi disponibles
 void startWiFi(const char* hostname);    //< Función para iniciar el servicio de WiFi
-void checkWiFi();                   //< Función para verificar la conexión a la red WiFi
+void checkWiFi();                   //< Función para verificar la conexión a la red WiFi (no bloquea)
+bool hasWiFiFastConnect();          //< Retorna true si hay caché de reconexión rápida
+bool wifiConnected();               //< Retorna true si hay asociación e IP
+WiFiState wifiState();              //< Retorna el estado del gestor de conexión
+const WiFiTimings & getWiFiTimings(); //< Retorna los contadores y tiempos de conexión
 bool hasStoredWiFi();               //< Retorna true si hay credenciales WiFi en NVS
 bool saveWiFi(const String &ssid, const String &pwd); //< Guarda credenciales WiFi en NVS
 bool clearStoredWiFi();             //< Limpia credenciales WiFi en NVS
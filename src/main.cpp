@@ -27,26 +27,84 @@
 #include <libiot.h>
 #include <libwifi.h>
 #include <libdisplay.h>
+#include <libi2cbus.h>
 #include <libota.h>
 #include <libstorage.h>
 #include <libprovision.h>
+#include <liblog.h>
 
 // Versi?n del firmware
 #define FIRMWARE_VERSION "v1.1.1"
+#define BOOT_TIMEOUT_MS 30000     // Tiempo máximo que setup() espera al orquestador de arranque
 
 SensorData data;  // Estructura para almacenar los datos de temperatura y humedad del SHT21
 time_t hora;      // Timestamp de la hora actual
 
+// Tareas del arranque en paralelo (ver libboot.h). Cada una se llama hasta que retorna true.
+static bool bootWiFi() {
+  checkWiFi();
+  return wifiConnected();
+}
+
+static bool bootSensors() {
+  setupSensors();           // Escaneo I2C y configuración de CCS811 y PMS7003, sin esperar el calentamiento
+  startSensorTask();        // Desde aquí se mide con periodo fijo en una tarea aparte
+  return true;
+}
+
+static bool bootTime() {
+  static bool started = false;
+  if (!started) {
+    startTimeSync();
+    started = true;
+  }
+  if (!timeSynced()) return false;
+  hora = time(nullptr);
+  return true;
+}
+
+static bool bootMQTT() {
+  checkMQTT();
+  return mqttReady();
+}
+
+/**
+ * Modo de bajo consumo (DUTY_CYCLE_ENABLED): cada despertar mide y duerme; solo
+ * cada DUTY_CYCLE_FLUSH_EVERY despertares conecta WiFi, SNTP y MQTT para enviar
+ * lo acumulado en memoria RTC. La pantalla no se enciende. No retorna.
+ */
+static void runDutyCycle() {
+  i2cBusBegin(8, 7);
+  setupSensors();
+  if (dutyCycleMeasure()) {
+    startWiFi("");
+    setupIoT();
+    int wifiJob = bootAddJob("wifi", bootWiFi);
+    int timeJob = bootAddJob("sntp", bootTime, BOOT_DEP(wifiJob));
+    bootAddJob("mqtt", bootMQTT, BOOT_DEP(timeJob));
+    bootRun(DUTY_CYCLE_CONNECT_TIMEOUT_MS);
+    dutyCycleFlush();
+  }
+  dutyCycleSleep();
+}
+
 /**
  * Configura el dispositivo para conectarse a la red WiFi y ajusta parametros IoT
  */
 void setup() {
+  profilerBegin("serial");
   Serial.begin(115200);     // Paso 1. Inicializa el puerto serie
-  delay(1000);              // Espera a que el puerto serie se estabilice
+  logBegin();               // Tarea de baja prioridad que envía el registro por Serial
+  if (esp_reset_reason() != ESP_RST_DEEPSLEEP) {
+    delay(1000);            // Espera a que el puerto serie se estabilice (al despertar de deep sleep no hace falta)
+  }
+  profilerEnd();
   
   // Imprimir informaci?n del firmware al inicio
   // Usar la versi?n guardada en memoria no vol?til (si existe) o la constante por defecto
+  profilerBegin("fw_version");
   String firmwareVersion = getFirmwareVersion();
+  profilerEnd();
   Serial.println("\n");
   Serial.println("========================================");
   Serial.println("  IoT MQTT TLS Device. .....v8");
@@ -56,6 +114,7 @@ void setup() {
   Serial.println();
   
   // Factory reset si el botón BOOT (GPIO0) está presionado al arrancar
+  profilerBegin("boot_pin");
   pinMode(0, INPUT_PULLUP);
   if (digitalRead(0) == LOW) {
     unsigned long t0 = millis();
@@ -66,16 +125,28 @@ void setup() {
       factoryReset();
     }
   }
-  listWiFiNetworks();       // Paso 2. Lista las redes WiFi disponibles
-  delay(1000);              // -- Espera 1 segundo para ver las redes disponibles
+  profilerEnd();
+#if DUTY_CYCLE_ENABLED
+  if (hasWiFiCredentials()) {
+    runDutyCycle();         // Termina en deep sleep; sin credenciales se sigue al portal de configuración
+  }
+#endif
+  profilerBegin("wifi_scan");
+  if (!hasWiFiFastConnect()) {
+    listWiFiNetworks();     // Paso 2. Lista las redes WiFi disponibles (se omite si hay caché de reconexión rápida)
+    delay(1000);            // -- Espera 1 segundo para ver las redes disponibles
+  }
+  profilerEnd();
   
   // Inicializar I2C antes de usar la pantalla OLED (pines 8 y 7 para CCS811 y OLED)
   // Esto debe hacerse antes de startDisplay() y setupIoT()
-  Wire.begin(8, 7);         // SDA=8, SCL=7 (mismos pines que usará CCS811)
-  Wire.setClock(100000);
-  delay(100);
+  profilerBegin("i2c");
+  i2cBusBegin(8, 7);        // SDA=8, SCL=7; la tarea del bus atiende a la pantalla y al CCS811 por prioridad
+  profilerEnd();
   
+  profilerBegin("display");
   startDisplay();           // Paso 3. Inicializa la pantalla OLED
+  profilerEnd();
   // Si no hay credenciales, iniciar modo provisioning (AP)
   if (!hasWiFiCredentials()) {
     displayConnecting("Modo Configuracion AP");
@@ -90,9 +161,24 @@ void setup() {
   } else {
     displayConnecting(ssid);
   }
-  startWiFi("");            // Paso 5. Inicializa el servicio de WiFi
-  setupIoT();               // Paso 6. Inicializa el servicio de IoT
-  hora = setTime();         // Paso 7. Ajusta el tiempo del dispositivo con servidores SNTP
+  startWiFi("");            // Paso 5. Lanza la conexión WiFi; se asocia mientras sigue el arranque
+  profilerBegin("setupIoT");
+  setupIoT();               // Paso 6. Configura el cliente MQTT y la cola offline
+  profilerEnd();
+
+  // Paso 7. Arranque en paralelo: los sensores se configuran y calientan mientras el
+  // WiFi se asocia; SNTP espera al WiFi y MQTT espera a SNTP (TLS necesita hora válida)
+  profilerBegin("boot_jobs");
+  int wifiJob = bootAddJob("wifi", bootWiFi);
+  int sensorsJob = bootAddJob("sensors", bootSensors);
+  bootAddJob("ccs811_warmup", sensorsReady, BOOT_DEP(sensorsJob));
+  int timeJob = bootAddJob("sntp", bootTime, BOOT_DEP(wifiJob));
+  bootAddJob("mqtt", bootMQTT, BOOT_DEP(timeJob));
+  if (!bootRun(BOOT_TIMEOUT_MS)) {
+    Serial.println("⚠ Arranque incompleto: las tareas pendientes siguen en loop()");
+  }
+  profilerEnd();
+  printProfile();           // Tabla de tiempos de arranque (se publica al conectar a MQTT)
   
   // Mostrar version al finalizar inicializacion (reutilizar variable ya declarada arriba)
   Serial.println();
@@ -109,12 +195,24 @@ void loop() {
     provisioningLoop();
     return;
   }
+  bootRunOnce();                                                 // -- Termina las tareas de arranque que no alcanzaron en setup()
   checkWiFi();                                                   // Paso 1. Verifica la conexión a la red WiFi y si no está conectado, intenta reconectar
   checkMQTT();                                                   // Paso 2. Verifica la conexión al servidor MQTT y si no está conectado, intenta reconectar
+  drainSpool();                                                  // -- Reenvía las muestras guardadas en flash mientras no hubo conexión
+  reportOTAStatus();                                             // -- Publica el progreso de una actualización OTA en curso
   String message = checkAlert();                                 // Paso 3. Verifica si hay alertas y las retorna en caso de haberlas
-  if(measure(&data)){                                            // Paso 4. Realiza una medición de los sensores CCS811 y PMS7003
+  TimedSample sample;
+  while (nextSample(&sample)) {                                  // Paso 4. Recibe las mediciones de la tarea de adquisición
+    data = sample.data;
     // Mostrar CO2 y PM2.5 en la pantalla (usando temperatura y humedad como placeholders temporales)
-    displayLoop(message, hora, data.co2, data.tvoc); // Paso 5. Muestra en la pantalla el mensaje recibido y los datos de los sensores
-    sendSensorData(&data);                                        // Paso 6. Envía los datos de los sensores al servidor MQTT
-  }   
+    displayLoop(message, hora, data.co2, data.tvoc);             // Paso 5. Muestra en la pantalla el mensaje recibido y los datos de los sensores
+    if (sample.timestamp >= TIME_VALID_EPOCH &&                  // Paso 6. Con ventana de agregación solo se publican resúmenes
+        !aggregateSample(&sample) && !reportByException(&sample)) { // -- y con deadband solo los canales que cambiaron
+      batchAdd(sample.timestamp, &sample.data, millis());        // -- Si no, guarda la muestra con su marca de tiempo en el ring buffer
+    }
+  }
+  displayTick();                                                 // -- Muestra lo que quedó pendiente por el límite de refresco
+  if (batchShouldFlush(millis()) && !sendSensorBatch()) {        // Paso 7. Si el lote llegó a N muestras o T segundos, lo envía al servidor MQTT
+    batchDefer(millis());                                        // -- Si falló, espera antes de reintentar en lugar de hacerlo en cada loop()
+  }
 }
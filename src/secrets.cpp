@@ -141,6 +141,13 @@ const char* root_ca = "-----BEGIN CERTIFICATE-----\n" \
 "emyPxgcYxn/eR44/KJ4EBs+lVDR3veyJm+kXQ99b21/+jh5Xos1AnX5iItreGCc=\n" \
 "-----END CERTIFICATE-----";
 
+// Clave pública con la que se firman las imágenes OTA (scripts/sign_ota.py genkey).
+// Con una clave configurada solo se instalan imágenes con firma válida.
+#ifndef OTA_PUBLIC_KEY
+#define OTA_PUBLIC_KEY ""
+#endif
+const char* ota_public_key = OTA_PUBLIC_KEY;
+
 /*********** Fin de parametros configurables por el usuario ***********/
 
 
@@ -152,23 +159,13 @@ const int mqtt_port = 8883;                  ///< Puerto seguro (TLS)
 const char* mqtt_user = "alvaro";                ///< Usuario MQTT
 const char* mqtt_password = "supersecreto";        ///< Contraseña MQTT
 
-// Obtener la MAC Address
-String macAddress = getMacAddress();
-const char * client_id = macAddress.c_str();      ///< ID del cliente MQTT
-const char * country = "colombia";
-const char * state = "valle";
-const char * city = "tulua";
-// Tópicos de publicación y suscripción
-String mqtt_topic_pub( String(country) + "/" + String(state) + "/"+ String(city) + "/" + String(client_id) + "/" + String(mqtt_user) + "/out");
-String mqtt_topic_sub( String(country) + "/" + String(state) + "/"+ String(city) + "/" + String(client_id) + "/" + String(mqtt_user) + "/in");
-
-// Convertir los tópicos a constantes de tipo char*
-const char * MQTT_TOPIC_PUB = mqtt_topic_pub.c_str();
-const char * MQTT_TOPIC_SUB = mqtt_topic_sub.c_str();
+// Ubicación de los tópicos <país>/<estado>/<ciudad>, concatenada en compilación
+// desde COUNTRY, STATE y CITY (.env). El ID del dispositivo (MAC) se agrega en
+// setupIoT() con topicsBegin() (ver libtopics.h)
+const char* topic_location = COUNTRY "/" STATE "/" CITY;
 
-long long int measureTime = millis();   // Tiempo de la última medición
 long long int alertTime = millis();     // Tiempo en que inició la última alerta
-WiFiClientSecure espClient;             // Conexión TLS/SSL con el servidor MQTT
+ResumableClientSecure espClient;        // Conexión TLS/SSL con el servidor MQTT (reanuda la sesión al reconectar)
 PubSubClient client(espClient);         // Cliente MQTT para la conexión con el servidor
 time_t now;                             // Timestamp de la fecha actual.
 const char* ssid = SSID;                // Cambia por el nombre de tu red WiFi
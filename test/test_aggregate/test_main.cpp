@@ -0,0 +1,216 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Pruebas de la agregación por ventanas (pio test -e native): ventanas
+// conocidas, ventana vacía, una sola muestra, valores en el máximo de 16 bits
+// y la cota de error de p50/p95 contra el percentil exacto.
+
+#include <unity.h>
+#include <libaggregate.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#define CH_CO2 0
+#define CH_TVOC 1
+#define CH_PM2_5 6                  // pm2_5_atm
+
+static AggWindow w;
+
+static SensorData ccs811(uint16_t co2, uint16_t tvoc) {
+  SensorData d = {};
+  d.co2 = co2;
+  d.tvoc = tvoc;
+  d.ccs811_valido = true;
+  return d;
+}
+
+void setUp() {
+  aggReset(&w);
+}
+
+void tearDown() {}
+
+void test_empty_window() {
+  AggStats st;
+  for (int c = 0; c < AGG_CHANNELS; c++) TEST_ASSERT_FALSE(aggChannel(&w, c, &st));
+  TEST_ASSERT_FALSE(aggChannel(&w, -1, &st));
+  TEST_ASSERT_FALSE(aggChannel(&w, AGG_CHANNELS, &st));
+  TEST_ASSERT_EQUAL_UINT16(0, aggPercentile(&w, CH_CO2, 50));
+  char json[AGG_JSON_MAX];
+  TEST_ASSERT_GREATER_THAN(0, aggEncodeJson(&w, json, sizeof(json)));
+  TEST_ASSERT_EQUAL_STRING("{\"ts\":0,\"dur\":0,\"n\":0,\"ch\":{}}", json);
+}
+
+void test_single_sample() {
+  SensorData d = ccs811(612, 33);
+  aggAdd(&w, 1700000000, &d);
+  AggStats st;
+  TEST_ASSERT_TRUE(aggChannel(&w, CH_CO2, &st));
+  TEST_ASSERT_EQUAL_UINT16(1, st.count);
+  TEST_ASSERT_EQUAL_UINT16(612, st.min);
+  TEST_ASSERT_EQUAL_UINT16(612, st.max);
+  TEST_ASSERT_EQUAL_FLOAT(612.0f, st.mean);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, st.stddev);
+  // Con una muestra el percentil queda recortado a min/max: exacto
+  TEST_ASSERT_EQUAL_UINT16(612, st.p50);
+  TEST_ASSERT_EQUAL_UINT16(612, st.p95);
+  TEST_ASSERT_FALSE(aggChannel(&w, CH_PM2_5, &st));      // PMS7003 no válido
+  char json[AGG_JSON_MAX];
+  aggEncodeJson(&w, json, sizeof(json));
+  TEST_ASSERT_EQUAL_STRING("{\"ts\":1700000000,\"dur\":0,\"n\":1,\"ch\":{\"co2\":[612,612,612.0,0.0,612,612,1],"
+                           "\"tvoc\":[33,33,33.0,0.0,33,33,1]}}", json);
+}
+
+void test_known_window() {
+  // CO2 400, 410, ..., 490: media 445, desviación poblacional sqrt(825)
+  for (int i = 0; i < 10; i++) {
+    SensorData d = ccs811(400 + 10 * i, i);
+    aggAdd(&w, 1000 + 2 * i, &d);
+  }
+  AggStats st;
+  TEST_ASSERT_TRUE(aggChannel(&w, CH_CO2, &st));
+  TEST_ASSERT_EQUAL_UINT16(10, st.count);
+  TEST_ASSERT_EQUAL_UINT16(400, st.min);
+  TEST_ASSERT_EQUAL_UINT16(490, st.max);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 445.0f, st.mean);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, 28.7228f, st.stddev);
+  // TVOC 0..9 cae en los bins exactos (hasta 7) y de ancho 2 (8..9)
+  TEST_ASSERT_TRUE(aggChannel(&w, CH_TVOC, &st));
+  TEST_ASSERT_EQUAL_UINT16(4, st.p50);
+  TEST_ASSERT_TRUE(st.p95 >= 8 && st.p95 <= 9);
+  TEST_ASSERT_EQUAL_UINT32(1000, w.startTs);
+  TEST_ASSERT_EQUAL_UINT32(1018, w.endTs);
+}
+
+void test_invalid_sensors_are_not_counted() {
+  SensorData d = ccs811(500, 10);
+  d.pms7003.pm2_5_atm = 12;
+  d.pms7003_valido = true;
+  aggAdd(&w, 1, &d);
+  d.ccs811_valido = false;
+  d.co2 = 9999;
+  aggAdd(&w, 2, &d);
+  AggStats st;
+  TEST_ASSERT_TRUE(aggChannel(&w, CH_CO2, &st));
+  TEST_ASSERT_EQUAL_UINT16(1, st.count);
+  TEST_ASSERT_EQUAL_UINT16(500, st.max);
+  TEST_ASSERT_TRUE(aggChannel(&w, CH_PM2_5, &st));
+  TEST_ASSERT_EQUAL_UINT16(2, st.count);
+  TEST_ASSERT_EQUAL_UINT16(2, w.samples);
+}
+
+void test_saturated_values() {
+  // UINT16_MAX muestras en 65535: Σx y n·Σx² quedan justo dentro de 32 y 64 bits
+  SensorData d = ccs811(UINT16_MAX, UINT16_MAX);
+  for (uint32_t i = 0; i < UINT16_MAX; i++) aggAdd(&w, i, &d);
+  TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, w.samples);
+  // La ventana llena ignora las muestras siguientes en vez de desbordar los contadores
+  SensorData low = ccs811(1, 1);
+  aggAdd(&w, UINT16_MAX, &low);
+  AggStats st;
+  TEST_ASSERT_TRUE(aggChannel(&w, CH_CO2, &st));
+  TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, st.count);
+  TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, st.min);
+  TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, st.max);
+  TEST_ASSERT_EQUAL_FLOAT(65535.0f, st.mean);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, st.stddev);
+  TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, st.p50);
+  TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, st.p95);
+  char json[AGG_JSON_MAX];
+  TEST_ASSERT_GREATER_THAN(0, aggEncodeJson(&w, json, sizeof(json)));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"co2\":[65535,65535,65535.0,0.0,65535,65535,65535]"));
+}
+
+void test_extremes_stddev() {
+  // Mitad en 0 y mitad en 65535: desviación 32767.5 sin pérdida en la varianza entera
+  for (int i = 0; i < 1000; i++) {
+    SensorData d = ccs811(i & 1 ? UINT16_MAX : 0, 0);
+    aggAdd(&w, i, &d);
+  }
+  AggStats st;
+  TEST_ASSERT_TRUE(aggChannel(&w, CH_CO2, &st));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 32767.5f, st.mean);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 32767.5f, st.stddev);
+}
+
+void test_json_overflow_returns_zero() {
+  SensorData d = ccs811(612, 33);
+  aggAdd(&w, 1, &d);
+  char json[40];
+  TEST_ASSERT_EQUAL_size_t(0, aggEncodeJson(&w, json, sizeof(json)));
+}
+
+/**
+ * p50 y p95 caen en el bin del percentil exacto (rango ⌈n·p/100⌉ de las
+ * muestras ordenadas), así que el error es menor que el ancho de ese bin:
+ * exacto hasta 7 y < 25 % relativo por encima.
+ */
+void test_percentile_error_bound() {
+  static uint16_t values[2000];
+  srand(7);
+  double worst = 0;
+  for (int trial = 0; trial < 2000; trial++) {
+    aggReset(&w);
+    int n = 1 + rand() % 2000;
+    uint32_t scale = 1u << (rand() % 17);
+    for (int i = 0; i < n; i++) {
+      uint32_t v = (uint32_t)rand() % scale;
+      if (rand() % 4 == 0) v = v / 16;     // Cola pesada hacia valores bajos
+      SensorData d = ccs811((uint16_t)(v > UINT16_MAX ? UINT16_MAX : v), 0);
+      values[i] = d.co2;
+      aggAdd(&w, i, &d);
+    }
+    std::sort(values, values + n);
+    for (uint8_t pct : {50, 95}) {
+      uint32_t rank = (n * pct + 99) / 100;
+      uint16_t exact = values[rank - 1];
+      uint16_t est = aggPercentile(&w, CH_CO2, pct);
+      uint32_t error = est > exact ? est - exact : exact - est;
+      if (exact < 8) {
+        TEST_ASSERT_EQUAL_UINT16(exact, est);
+      } else {
+        TEST_ASSERT_TRUE(error * 4 < exact);
+        if ((double)error / exact > worst) worst = (double)error / exact;
+      }
+    }
+  }
+  char msg[64];
+  snprintf(msg, sizeof(msg), "peor error relativo de p50/p95: %.1f %%", worst * 100);
+  TEST_MESSAGE(msg);
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_window);
+  RUN_TEST(test_single_sample);
+  RUN_TEST(test_known_window);
+  RUN_TEST(test_invalid_sensors_are_not_counted);
+  RUN_TEST(test_saturated_values);
+  RUN_TEST(test_extremes_stddev);
+  RUN_TEST(test_json_overflow_returns_zero);
+  RUN_TEST(test_percentile_error_bound);
+  return UNITY_END();
+}
@@ -0,0 +1,90 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Pruebas del ring buffer de lotes (pio test -e native).
+
+#include <unity.h>
+#include <libbatch.h>
+
+static SensorData reading = {};
+
+void setUp() {
+  batchConsume(batchCount());
+  batchConfigure(4, 30);
+}
+
+void tearDown() {}
+
+void test_flushes_at_sample_limit_or_age() {
+  batchAdd(100, &reading, 1000);
+  TEST_ASSERT_FALSE(batchShouldFlush(1000));
+  TEST_ASSERT_TRUE(batchShouldFlush(31000));          // La más antigua cumplió 30 s
+  for (int i = 1; i < 4; i++) batchAdd(100 + i, &reading, 1000 + i);
+  TEST_ASSERT_TRUE(batchShouldFlush(1004));           // Llegó a 4 muestras
+}
+
+void test_failed_publish_defers_next_flush_with_growing_wait() {
+  for (int i = 0; i < 4; i++) batchAdd(100 + i, &reading, 0);
+  uint32_t now = 5000;
+  batchDefer(now);
+  TEST_ASSERT_FALSE(batchShouldFlush(now));
+  TEST_ASSERT_FALSE(batchShouldFlush(now + BATCH_RETRY_MS - 1));
+  TEST_ASSERT_TRUE(batchShouldFlush(now + BATCH_RETRY_MS));
+  now += BATCH_RETRY_MS;
+  batchDefer(now);                                    // Segundo fallo seguido: espera el doble
+  TEST_ASSERT_FALSE(batchShouldFlush(now + BATCH_RETRY_MS));
+  TEST_ASSERT_TRUE(batchShouldFlush(now + 2 * BATCH_RETRY_MS));
+  for (int i = 0; i < 12; i++) {
+    now += BATCH_RETRY_MAX_MS;
+    batchDefer(now);
+  }
+  TEST_ASSERT_FALSE(batchShouldFlush(now + BATCH_RETRY_MAX_MS - 1)); // Acotada en BATCH_RETRY_MAX_MS
+  TEST_ASSERT_TRUE(batchShouldFlush(now + BATCH_RETRY_MAX_MS));
+}
+
+void test_successful_publish_clears_retry() {
+  for (int i = 0; i < 4; i++) batchAdd(100 + i, &reading, 0);
+  batchDefer(1000);
+  batchConsume(4);
+  for (int i = 0; i < 4; i++) batchAdd(200 + i, &reading, 1500);
+  TEST_ASSERT_TRUE(batchShouldFlush(1500));
+  batchDefer(1500);                                   // Un nuevo fallo vuelve a la espera inicial
+  TEST_ASSERT_TRUE(batchShouldFlush(1500 + BATCH_RETRY_MS));
+}
+
+void test_deferral_survives_millis_wraparound() {
+  for (int i = 0; i < 4; i++) batchAdd(100 + i, &reading, 0xFFFFF000u);
+  batchDefer(0xFFFFFF00u);
+  TEST_ASSERT_FALSE(batchShouldFlush(0x00000010u));
+  TEST_ASSERT_TRUE(batchShouldFlush(0xFFFFFF00u + BATCH_RETRY_MS));
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_flushes_at_sample_limit_or_age);
+  RUN_TEST(test_failed_publish_defers_next_flush_with_growing_wait);
+  RUN_TEST(test_successful_publish_clears_retry);
+  RUN_TEST(test_deferral_survives_millis_wraparound);
+  return UNITY_END();
+}
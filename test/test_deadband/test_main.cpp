@@ -0,0 +1,91 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Pruebas del envío por excepción (pio test -e native).
+
+#include <unity.h>
+#include <libdeadband.h>
+
+#define PM2_5 6                             // Canal pm2_5 (atm) en sensorChannels()
+#define PM2_5_BIT (1u << PM2_5)
+
+static Deadband deadband;
+
+static SensorData pmsSample(uint16_t pm2_5, bool valid) {
+  SensorData data = {};
+  data.pms7003.pm2_5_atm = pm2_5;
+  data.pms7003_valido = valid;
+  return data;
+}
+
+/**
+ * Pasa una muestra por el deadband como lo hace libiot y retorna la máscara reportada.
+ */
+static uint16_t report(uint32_t ts, const SensorData & data) {
+  uint16_t mask = deadbandCheck(&deadband, ts, &data);
+  deadbandCommit(&deadband, ts, &data, mask);
+  return mask;
+}
+
+void setUp() {
+  DeadbandConfig config;
+  deadbandDefaults(&config);
+  deadbandInit(&deadband, &config);
+}
+
+void tearDown() {}
+
+void test_small_changes_are_suppressed_until_threshold_or_heartbeat() {
+  TEST_ASSERT_TRUE(report(1000, pmsSample(20, true)) & PM2_5_BIT);   // Primer valor
+  TEST_ASSERT_FALSE(report(1002, pmsSample(21, true)) & PM2_5_BIT);  // Bajo los 2 µg/m³
+  TEST_ASSERT_TRUE(report(1004, pmsSample(22, true)) & PM2_5_BIT);
+  TEST_ASSERT_FALSE(report(1004 + deadband.config.heartbeatS - 1, pmsSample(22, true)) & PM2_5_BIT);
+  TEST_ASSERT_TRUE(report(1004 + deadband.config.heartbeatS, pmsSample(22, true)) & PM2_5_BIT);
+}
+
+void test_missing_pms_frames_keep_last_reported_value() {
+  // Medición cada 2 s contra tramas cada ~2.3 s: a veces no hay trama nueva
+  TEST_ASSERT_TRUE(report(1000, pmsSample(20, true)) & PM2_5_BIT);
+  TEST_ASSERT_FALSE(report(1002, pmsSample(0, false)) & PM2_5_BIT);
+  TEST_ASSERT_FALSE(report(1004, pmsSample(20, true)) & PM2_5_BIT);  // Sin cambio: no se repite
+  TEST_ASSERT_FALSE(report(1006, pmsSample(0, false)) & PM2_5_BIT);
+  TEST_ASSERT_FALSE(report(1004 + DEADBAND_STALE_S - 1, pmsSample(0, false)) & PM2_5_BIT);
+  TEST_ASSERT_FALSE(report(1004 + DEADBAND_STALE_S, pmsSample(21, true)) & PM2_5_BIT);
+}
+
+void test_sensor_gone_longer_than_stale_limit_reports_on_return() {
+  TEST_ASSERT_TRUE(report(1000, pmsSample(20, true)) & PM2_5_BIT);
+  for (uint32_t ts = 1002; ts <= 1000 + DEADBAND_STALE_S; ts += 2) {
+    TEST_ASSERT_FALSE(report(ts, pmsSample(0, false)) & PM2_5_BIT);
+  }
+  TEST_ASSERT_TRUE(report(1002 + DEADBAND_STALE_S, pmsSample(20, true)) & PM2_5_BIT);
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_small_changes_are_suppressed_until_threshold_or_heartbeat);
+  RUN_TEST(test_missing_pms_frames_keep_last_reported_value);
+  RUN_TEST(test_sensor_gone_longer_than_stale_limit_reports_on_return);
+  return UNITY_END();
+}
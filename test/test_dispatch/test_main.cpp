@@ -0,0 +1,238 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Pruebas de la tabla de despacho por tópico (pio test -e native): registro,
+// reemplazo de handler, colisiones de hash y de ranura, tabla llena, y un
+// micro-benchmark del costo por mensaje contra la ruta anterior (copiar
+// payload y tópicos a cadenas y comparar).
+
+#include <unity.h>
+#include <libdispatch.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <chrono>
+
+#define BENCH_TOPICS 8
+#define BENCH_PAYLOAD 300
+#define BENCH_MESSAGES 200000
+
+// "cmd/099bb" y "cmd/42848" tienen el mismo FNV-1a de 32 bits (0x27AFC3AE)
+static const char * COLLIDING_A = "cmd/099bb";
+static const char * COLLIDING_B = "cmd/42848";
+
+static int calls[4];
+static const char * lastTopic;
+static size_t lastLength;
+
+static void handlerA(const char * topic, uint8_t * payload, size_t length) { calls[0]++; lastTopic = topic; lastLength = length; }
+static void handlerB(const char * topic, uint8_t * payload, size_t length) { calls[1]++; lastTopic = topic; lastLength = length; }
+static void handlerC(const char * topic, uint8_t * payload, size_t length) { calls[2]++; lastTopic = topic; lastLength = length; }
+
+static volatile uint32_t sink;
+static void benchHandler(const char * topic, uint8_t * payload, size_t length) { sink += payload[0] + length; }
+
+static uint32_t fnv1a(const char * s) {
+  uint32_t hash = 2166136261u;
+  for (; *s; s++) hash = (hash ^ (uint8_t)*s) * 16777619u;
+  return hash;
+}
+
+void setUp() {
+  dispatchReset();
+  memset(calls, 0, sizeof(calls));
+  lastTopic = NULL;
+  lastLength = 0;
+}
+
+void tearDown() {}
+
+void test_register_and_lookup() {
+  int a = dispatchRegister("dispositivo/ota", handlerA);
+  int b = dispatchRegister("dispositivo/in", handlerB);
+  TEST_ASSERT_EQUAL_INT(0, a);
+  TEST_ASSERT_EQUAL_INT(1, b);
+  TEST_ASSERT_EQUAL_INT(a, dispatchLookup("dispositivo/ota"));
+  TEST_ASSERT_EQUAL_INT(b, dispatchLookup("dispositivo/in"));
+  TEST_ASSERT_EQUAL_INT(-1, dispatchLookup("dispositivo/out"));
+  TEST_ASSERT_EQUAL_INT(-1, dispatchLookup("dispositivo/ot"));
+}
+
+void test_lookup_compares_text_not_pointer() {
+  char copy[32];
+  strcpy(copy, "dispositivo/ota");
+  int a = dispatchRegister("dispositivo/ota", handlerA);
+  TEST_ASSERT_EQUAL_INT(a, dispatchLookup(copy));
+  uint8_t payload[] = {'{', '}'};
+  TEST_ASSERT_TRUE(dispatchMessage(copy, payload, sizeof(payload)));
+  TEST_ASSERT_EQUAL_INT(1, calls[0]);
+  TEST_ASSERT_EQUAL_PTR(copy, lastTopic);
+  TEST_ASSERT_EQUAL_size_t(2, lastLength);
+}
+
+void test_replace_handler_keeps_id() {
+  int first = dispatchRegister("dispositivo/in", handlerA);
+  int second = dispatchRegister("dispositivo/in", handlerB);
+  TEST_ASSERT_EQUAL_INT(first, second);
+  uint8_t payload[] = {'x'};
+  TEST_ASSERT_TRUE(dispatchMessage("dispositivo/in", payload, 1));
+  TEST_ASSERT_EQUAL_INT(0, calls[0]);
+  TEST_ASSERT_EQUAL_INT(1, calls[1]);
+  // El reemplazo no consume una entrada: caben los otros DISPATCH_MAX_TOPICS - 1
+  char topics[DISPATCH_MAX_TOPICS][16];
+  for (int i = 1; i < DISPATCH_MAX_TOPICS; i++) {
+    snprintf(topics[i], sizeof(topics[i]), "t/%d", i);
+    TEST_ASSERT_EQUAL_INT(i, dispatchRegister(topics[i], handlerC));
+  }
+}
+
+void test_null_handler_counts_as_unmatched() {
+  dispatchRegister("dispositivo/in", handlerA);
+  dispatchRegister("dispositivo/in", NULL);
+  uint32_t before = dispatchGetStats().unmatched;
+  uint8_t payload[] = {'x'};
+  TEST_ASSERT_FALSE(dispatchMessage("dispositivo/in", payload, 1));
+  TEST_ASSERT_EQUAL_UINT32(before + 1, dispatchGetStats().unmatched);
+  TEST_ASSERT_EQUAL_INT(0, calls[0]);
+}
+
+void test_hash_collision_dispatches_by_text() {
+  TEST_ASSERT_EQUAL_HEX32(fnv1a(COLLIDING_A), fnv1a(COLLIDING_B));
+  int a = dispatchRegister(COLLIDING_A, handlerA);
+  uint32_t before = dispatchGetStats().collisions;
+  int b = dispatchRegister(COLLIDING_B, handlerB);
+  TEST_ASSERT_NOT_EQUAL(a, b);
+  TEST_ASSERT_EQUAL_UINT32(before + 1, dispatchGetStats().collisions);
+  TEST_ASSERT_EQUAL_INT(a, dispatchLookup(COLLIDING_A));
+  TEST_ASSERT_EQUAL_INT(b, dispatchLookup(COLLIDING_B));
+  uint8_t payload[] = {'x'};
+  TEST_ASSERT_TRUE(dispatchMessage(COLLIDING_B, payload, 1));
+  TEST_ASSERT_TRUE(dispatchMessage(COLLIDING_A, payload, 1));
+  TEST_ASSERT_EQUAL_INT(1, calls[0]);
+  TEST_ASSERT_EQUAL_INT(1, calls[1]);
+  // Un tercer tópico con el mismo hash pero no registrado no despacha
+  char other[] = "cmd/099bb";
+  other[8] = 'c';
+  TEST_ASSERT_EQUAL_INT(-1, dispatchLookup(other));
+}
+
+void test_slot_collision_probes_next_slot() {
+  // Dos tópicos con hash distinto que caen en la misma ranura
+  char first[16], second[16];
+  strcpy(first, "s/0");
+  uint32_t slot = fnv1a(first) & (DISPATCH_TABLE_SIZE - 1);
+  int i = 1;
+  do {
+    snprintf(second, sizeof(second), "s/%d", i++);
+  } while ((fnv1a(second) & (DISPATCH_TABLE_SIZE - 1)) != slot);
+  TEST_ASSERT_NOT_EQUAL(fnv1a(first), fnv1a(second));
+  int a = dispatchRegister(first, handlerA);
+  int b = dispatchRegister(second, handlerB);
+  TEST_ASSERT_EQUAL_INT(a, dispatchLookup(first));
+  TEST_ASSERT_EQUAL_INT(b, dispatchLookup(second));
+  uint8_t payload[] = {'x'};
+  TEST_ASSERT_TRUE(dispatchMessage(second, payload, 1));
+  TEST_ASSERT_EQUAL_INT(0, calls[0]);
+  TEST_ASSERT_EQUAL_INT(1, calls[1]);
+}
+
+void test_full_table_rejects_new_topics_but_replaces() {
+  static char topics[DISPATCH_MAX_TOPICS + 1][16];
+  for (int i = 0; i <= DISPATCH_MAX_TOPICS; i++) snprintf(topics[i], sizeof(topics[i]), "full/%d", i);
+  for (int i = 0; i < DISPATCH_MAX_TOPICS; i++) TEST_ASSERT_EQUAL_INT(i, dispatchRegister(topics[i], handlerA));
+  TEST_ASSERT_EQUAL_INT(-1, dispatchRegister(topics[DISPATCH_MAX_TOPICS], handlerA));
+  TEST_ASSERT_EQUAL_INT(-1, dispatchLookup(topics[DISPATCH_MAX_TOPICS]));
+  TEST_ASSERT_EQUAL_INT(3, dispatchRegister(topics[3], handlerB));
+  for (int i = 0; i < DISPATCH_MAX_TOPICS; i++) TEST_ASSERT_EQUAL_INT(i, dispatchLookup(topics[i]));
+}
+
+void test_reset_forgets_topics() {
+  dispatchRegister("dispositivo/in", handlerA);
+  dispatchReset();
+  TEST_ASSERT_EQUAL_INT(-1, dispatchLookup("dispositivo/in"));
+  TEST_ASSERT_EQUAL_INT(0, dispatchRegister("dispositivo/ota", handlerB));
+}
+
+/**
+ * Ruta anterior de receivedCallback: payload copiado byte a byte a una cadena,
+ * copias del tópico y del tópico OTA, y comparación lineal contra cada tópico.
+ */
+static const char * benchTopics[BENCH_TOPICS];
+
+static void copyAndCompare(const char * topic, uint8_t * payload, size_t length) {
+  std::string message;
+  for (size_t i = 0; i < length; i++) message += (char)payload[i];
+  std::string topicCopy(topic);
+  std::string otaTopic(benchTopics[0]);
+  if (topicCopy == otaTopic) {
+    benchHandler(topic, payload, length);
+    return;
+  }
+  for (int i = 1; i < BENCH_TOPICS; i++) {
+    if (topicCopy == benchTopics[i]) {
+      benchHandler(topic, (uint8_t *)message.c_str(), message.length());
+      return;
+    }
+  }
+}
+
+void test_dispatch_benchmark() {
+  static char names[BENCH_TOPICS][64];
+  for (int i = 0; i < BENCH_TOPICS; i++) {
+    snprintf(names[i], sizeof(names[i]), "colombia/santander/bucaramanga/ESP32-0011223344/t%d", i);
+    benchTopics[i] = names[i];
+    TEST_ASSERT_EQUAL_INT(i, dispatchRegister(names[i], benchHandler));
+  }
+  uint8_t payload[BENCH_PAYLOAD];
+  memset(payload, '7', sizeof(payload));
+  uint32_t before = dispatchGetStats().messages;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < BENCH_MESSAGES; i++) dispatchMessage(benchTopics[i % BENCH_TOPICS], payload, sizeof(payload));
+  auto mid = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < BENCH_MESSAGES; i++) copyAndCompare(benchTopics[i % BENCH_TOPICS], payload, sizeof(payload));
+  auto end = std::chrono::steady_clock::now();
+
+  TEST_ASSERT_EQUAL_UINT32(before + BENCH_MESSAGES, dispatchGetStats().messages);
+  double table = std::chrono::duration<double, std::nano>(mid - start).count() / BENCH_MESSAGES;
+  double copy = std::chrono::duration<double, std::nano>(end - mid).count() / BENCH_MESSAGES;
+  char msg[160];
+  snprintf(msg, sizeof(msg), "%d tópicos, payload de %d bytes: %.1f ns por mensaje con la tabla, %.1f ns copiando y comparando",
+           BENCH_TOPICS, BENCH_PAYLOAD, table, copy);
+  TEST_MESSAGE(msg);
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_register_and_lookup);
+  RUN_TEST(test_lookup_compares_text_not_pointer);
+  RUN_TEST(test_replace_handler_keeps_id);
+  RUN_TEST(test_null_handler_counts_as_unmatched);
+  RUN_TEST(test_hash_collision_dispatches_by_text);
+  RUN_TEST(test_slot_collision_probes_next_slot);
+  RUN_TEST(test_full_table_rejects_new_topics_but_replaces);
+  RUN_TEST(test_reset_forgets_topics);
+  RUN_TEST(test_dispatch_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,153 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Pruebas de la planificación del modo de bajo consumo (pio test -e native).
+// Cada despertar se simula como en runDutyCycle(): contar el despertar, guardar
+// la muestra y, si toca, intentar el envío.
+
+#include <unity.h>
+#include <libdutycycle.h>
+
+#define FLUSH_EVERY 5
+
+static DutyCycleState state;             // En el equipo vive en memoria RTC
+static uint32_t clockS = 0;
+
+/**
+ * Un despertar: retorna true si toca conectarse. La muestra lleva como
+ * marca de tiempo el número de despertar, para verificar el orden.
+ */
+static bool wake(bool timeValid = true) {
+  bool flush = dutyOnWake(&state, FLUSH_EVERY, timeValid);
+  TimedSample sample = {};
+  sample.timestamp = ++clockS;
+  dutyAdd(&state, &sample);
+  return flush;
+}
+
+/**
+ * Cuenta los despertares hasta el siguiente que se conecta.
+ */
+static uint32_t wakesUntilFlush() {
+  for (uint32_t n = 1; n <= 1000; n++) {
+    if (wake()) return n;
+  }
+  return 0;
+}
+
+void setUp() {
+  state.magic = 0;
+  dutyInit(&state, false);
+  clockS = 0;
+}
+
+void tearDown() {}
+
+void test_resume_keeps_state_only_after_deep_sleep() {
+  wake();
+  wake();
+  dutyInit(&state, true);                  // Despertar de deep sleep
+  TEST_ASSERT_EQUAL(2, state.count);
+  TEST_ASSERT_EQUAL(2, state.wakes);
+  dutyInit(&state, false);                 // Arranque en frío
+  TEST_ASSERT_EQUAL(0, state.count);
+  wake();
+  state.magic ^= 1;                        // Memoria RTC con otro formato
+  dutyInit(&state, true);
+  TEST_ASSERT_EQUAL(0, state.count);
+  TEST_ASSERT_EQUAL(0, state.wakes);
+}
+
+void test_flushes_every_n_wakes_and_frees_published_samples() {
+  TEST_ASSERT_EQUAL_UINT32(FLUSH_EVERY, wakesUntilFlush());
+  TEST_ASSERT_EQUAL(FLUSH_EVERY, state.count);
+  dutyFlushDone(&state, 3, true);          // Solo se alcanzaron a publicar 3
+  TEST_ASSERT_EQUAL(2, state.count);
+  TEST_ASSERT_EQUAL_UINT32(4, dutyPeek(&state, 0)->timestamp);
+  TEST_ASSERT_NULL(dutyPeek(&state, 2));
+  TEST_ASSERT_EQUAL_UINT32(FLUSH_EVERY, wakesUntilFlush());
+  TEST_ASSERT_EQUAL_UINT32(1, state.flushes);
+}
+
+void test_without_valid_time_connects_every_wake() {
+  TEST_ASSERT_TRUE(wake(false));           // Hace falta SNTP para marcar las muestras
+  dutyFlushDone(&state, 0, true);
+  TEST_ASSERT_TRUE(wake(false));
+  dutyFlushDone(&state, 0, true);
+  TEST_ASSERT_FALSE(wake(true));           // Con hora válida vuelve al ritmo normal
+}
+
+void test_failed_flushes_back_off_exponentially_and_reset_on_success() {
+  TEST_ASSERT_EQUAL_UINT32(FLUSH_EVERY, wakesUntilFlush());
+  uint32_t expected = FLUSH_EVERY;
+  for (int failures = 1; failures <= DUTY_BACKOFF_MAX_SHIFT + 2; failures++) {
+    dutyFlushDone(&state, 0, false);
+    int shift = failures < DUTY_BACKOFF_MAX_SHIFT ? failures : DUTY_BACKOFF_MAX_SHIFT;
+    expected = FLUSH_EVERY << shift;
+    TEST_ASSERT_EQUAL_UINT32(expected, wakesUntilFlush());
+  }
+  TEST_ASSERT_EQUAL_UINT32(FLUSH_EVERY << DUTY_BACKOFF_MAX_SHIFT, expected);
+  dutyFlushDone(&state, 0, false);
+  TEST_ASSERT_FALSE(wake(false));          // En backoff ni la falta de hora fuerza la conexión
+  dutyFlushDone(&state, state.count, true);
+  TEST_ASSERT_EQUAL(0, state.failures);
+  TEST_ASSERT_EQUAL_UINT32(FLUSH_EVERY, wakesUntilFlush());
+}
+
+void test_full_buffer_drops_oldest_and_forces_flush() {
+  for (int i = 0; i < DUTY_BUFFER_CAPACITY; i++) {
+    TEST_ASSERT_FALSE(dutyOnWake(&state, 1000, true));
+    TimedSample sample = {};
+    sample.timestamp = ++clockS;
+    TEST_ASSERT_TRUE(dutyAdd(&state, &sample));
+  }
+  TEST_ASSERT_TRUE(dutyOnWake(&state, 1000, true));   // Lleno: se adelanta el envío
+  dutyFlushDone(&state, 0, false);
+  TEST_ASSERT_FALSE(dutyOnWake(&state, 1000, true));  // Tras un fallo ya no se adelanta
+
+  TimedSample sample = {};
+  sample.timestamp = ++clockS;
+  TEST_ASSERT_FALSE(dutyAdd(&state, &sample));        // Se descarta la más antigua
+  TEST_ASSERT_EQUAL(DUTY_BUFFER_CAPACITY, state.count);
+  TEST_ASSERT_EQUAL_UINT32(1, state.dropped);
+  TEST_ASSERT_EQUAL_UINT32(2, dutyPeek(&state, 0)->timestamp);
+  TEST_ASSERT_EQUAL_UINT32(clockS, dutyPeek(&state, DUTY_BUFFER_CAPACITY - 1)->timestamp);
+}
+
+void test_sleep_compensates_for_time_awake() {
+  TEST_ASSERT_EQUAL_UINT32(57000, dutySleepMs(60000, 3000));
+  TEST_ASSERT_EQUAL_UINT32(DUTY_MIN_SLEEP_MS, dutySleepMs(60000, 59500));
+  TEST_ASSERT_EQUAL_UINT32(DUTY_MIN_SLEEP_MS, dutySleepMs(60000, 25000 + 60000));
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_resume_keeps_state_only_after_deep_sleep);
+  RUN_TEST(test_flushes_every_n_wakes_and_frees_published_samples);
+  RUN_TEST(test_without_valid_time_connects_every_wake);
+  RUN_TEST(test_failed_flushes_back_off_exponentially_and_reset_on_success);
+  RUN_TEST(test_full_buffer_drops_oldest_and_forces_flush);
+  RUN_TEST(test_sleep_compensates_for_time_awake);
+  return UNITY_END();
+}
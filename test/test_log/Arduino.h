@@ -0,0 +1,74 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Sustituto mínimo de Arduino.h para probar liblog en el host: Serial guarda
+// lo escrito en un std::string, millis() devuelve un reloj que fija la prueba
+// y los primitivos de FreeRTOS son no-ops (sin tarea de log, logFlush() drena
+// desde quien llama).
+
+#ifndef TEST_LOG_ARDUINO_H
+#define TEST_LOG_ARDUINO_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+inline unsigned long fakeMillis = 0;
+inline unsigned long millis() { return fakeMillis; }
+
+class FakeSerial {
+public:
+  std::string output;
+  size_t write(const uint8_t * data, size_t length) {
+    output.append((const char *)data, length);
+    return length;
+  }
+  int printf(const char * format, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (n > 0) output.append(buf, n < (int)sizeof(buf) ? n : sizeof(buf) - 1);
+    return n;
+  }
+  void flush() {}
+};
+inline FakeSerial Serial;
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+typedef void * TaskHandle_t;
+#define pdTRUE 1
+#define pdMS_TO_TICKS(ms) (ms)
+inline void xTaskNotifyGive(TaskHandle_t) {}
+inline uint32_t ulTaskNotifyTake(int, uint32_t) { return 0; }
+inline void vTaskDelay(uint32_t) {}
+inline int xTaskCreatePinnedToCore(void (*)(void *), const char *, uint32_t, void *, int, TaskHandle_t *, int) { return 0; }
+
+#endif /* TEST_LOG_ARDUINO_H */
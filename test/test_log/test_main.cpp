@@ -0,0 +1,174 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Pruebas del registro por niveles (pio test -e native) con el Serial y los
+// primitivos de FreeRTOS de Arduino.h en esta carpeta: tope de línea, ring
+// lleno con descarte y aviso, volteo del ring, niveles por módulo y logHex.
+// liblog depende de Arduino, así que se compila aquí y no en build_src_filter.
+
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include "../../src/liblog.cpp"
+
+static std::string take() {
+  logFlush(1);
+  std::string out = Serial.output;
+  Serial.output.clear();
+  return out;
+}
+
+static int countLines(const std::string & s) {
+  int n = 0;
+  for (char c : s) n += c == '\n';
+  return n;
+}
+
+void setUp() {
+  fakeMillis = 1234;
+  take();
+  for (int m = 0; m < LOG_MODULE_COUNT; m++) logLevels[m] = LOG_DEFAULT_LEVEL;
+}
+
+void tearDown() {}
+
+void test_line_format() {
+  LOG_I(LOG_MQTT, "conectado a %s:%d", "broker", 8883);
+  LOG_E(LOG_SENSORS, "CCS811 sin respuesta");
+  TEST_ASSERT_EQUAL_STRING("[1234][I][mqtt] conectado a broker:8883\n"
+                           "[1234][E][sensors] CCS811 sin respuesta\n", take().c_str());
+}
+
+void test_long_line_is_capped() {
+  char text[400];
+  memset(text, 'x', sizeof(text) - 1);
+  text[sizeof(text) - 1] = '\0';
+  logPrintf(LOG_PUBLISH, LOG_LEVEL_INFO, "%s", text);
+  std::string out = take();
+  TEST_ASSERT_EQUAL_size_t(LOG_LINE_MAX - 1, out.size());
+  TEST_ASSERT_EQUAL_UINT8('\n', (uint8_t)out.back());
+  TEST_ASSERT_EQUAL_INT(1, countLines(out));
+}
+
+void test_full_ring_drops_and_reports() {
+  // Líneas de 60 bytes: caben 68 en los 4096 del ring y se descartan 32
+  LogStats before = logGetStats();
+  for (int i = 0; i < 100; i++) LOG_I(LOG_MQTT, "linea %03d %033d", i, 0);     // 16 + 43 + '\n'
+  LogStats after = logGetStats();
+  TEST_ASSERT_EQUAL_UINT32(68, after.lines - before.lines);
+  TEST_ASSERT_EQUAL_UINT32(32, after.dropped - before.dropped);
+  TEST_ASSERT_EQUAL_UINT32(68 * 60, after.highWater);
+  std::string out = take();
+  TEST_ASSERT_EQUAL_INT(0, out.find("[log] 32 líneas descartadas (ring lleno)\n"));
+  TEST_ASSERT_EQUAL_INT(69, countLines(out));
+  TEST_ASSERT_NOT_EQUAL(std::string::npos, out.find("linea 067"));
+  TEST_ASSERT_EQUAL(std::string::npos, out.find("linea 068"));
+  // El aviso sale una sola vez
+  LOG_I(LOG_MQTT, "siguiente");
+  TEST_ASSERT_EQUAL_STRING("[1234][I][mqtt] siguiente\n", take().c_str());
+}
+
+void test_ring_wraps_without_corruption() {
+  // Líneas de largo variable para cruzar el final del ring en distintas posiciones
+  for (int round = 0; round < 200; round++) {
+    std::string expected;
+    for (int i = 0; i < 1 + round % 7; i++) {
+      char text[64];
+      snprintf(text, sizeof(text), "r%d-%d-%.*s", round, i, (round * 7 + i) % 40, "0123456789012345678901234567890123456789");
+      LOG_W(LOG_HEALTH, "%s", text);
+      expected += std::string("[1234][W][health] ") + text + "\n";
+    }
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), take().c_str());
+  }
+  TEST_ASSERT_TRUE(head > LOG_BUFFER_SIZE);
+}
+
+void test_levels_per_module() {
+  LOG_D(LOG_SENSORS, "oculta");
+  TEST_ASSERT_TRUE(take().empty());
+  TEST_ASSERT_TRUE(logSetLevel("sensors", "debug"));
+  LOG_D(LOG_SENSORS, "visible");
+  LOG_D(LOG_MQTT, "oculta");
+  TEST_ASSERT_EQUAL_STRING("[1234][D][sensors] visible\n", take().c_str());
+
+  TEST_ASSERT_TRUE(logSetLevel("*", "warn"));
+  for (int m = 0; m < LOG_MODULE_COUNT; m++) TEST_ASSERT_EQUAL_UINT8(LOG_LEVEL_WARN, logLevels[m]);
+  LOG_I(LOG_PUBLISH, "oculta");
+  LOG_W(LOG_PUBLISH, "visible");
+  TEST_ASSERT_EQUAL_INT(1, countLines(take()));
+
+  TEST_ASSERT_TRUE(logSetLevel("*", "none"));
+  LOG_E(LOG_MQTT, "oculta");
+  TEST_ASSERT_TRUE(take().empty());
+
+  TEST_ASSERT_FALSE(logSetLevel("wifi", "info"));
+  TEST_ASSERT_FALSE(logSetLevel("mqtt", "loud"));
+  TEST_ASSERT_EQUAL_UINT8(LOG_LEVEL_NONE, logLevels[LOG_MQTT]);
+}
+
+void test_compiled_ceiling() {
+  // Por encima de LOG_MIN_LEVEL la condición es constante: ni el nivel en ejecución la habilita
+  TEST_ASSERT_TRUE(logSetLevel("*", "verbose"));
+  TEST_ASSERT_TRUE(LOG_ENABLED(LOG_MQTT, LOG_MIN_LEVEL));
+#if LOG_MIN_LEVEL < LOG_LEVEL_VERBOSE
+  TEST_ASSERT_FALSE(LOG_ENABLED(LOG_MQTT, LOG_MIN_LEVEL + 1));
+#endif
+}
+
+void test_hex_dump() {
+  const uint8_t data[] = { 0x00, 0x7F, 0xA5, 0xFF };
+  logHex(LOG_PUBLISH, LOG_LEVEL_INFO, "cbor ", data, sizeof(data));
+  TEST_ASSERT_EQUAL_STRING("[1234][I][publish] cbor 007fa5ff\n", take().c_str());
+}
+
+void test_hex_dump_is_truncated() {
+  uint8_t data[200];
+  memset(data, 0xAB, sizeof(data));
+  logHex(LOG_PUBLISH, LOG_LEVEL_INFO, "cbor ", data, sizeof(data));
+  std::string out = take();
+  TEST_ASSERT_TRUE(out.size() <= LOG_LINE_MAX);
+  TEST_ASSERT_EQUAL_INT(out.size() - 4, out.rfind("...\n"));
+  TEST_ASSERT_EQUAL_INT(1, countLines(out));
+}
+
+void test_names() {
+  TEST_ASSERT_EQUAL_STRING("health", logModuleName(LOG_HEALTH));
+  TEST_ASSERT_EQUAL_STRING("?", logModuleName(LOG_MODULE_COUNT));
+  TEST_ASSERT_EQUAL_STRING("verbose", logLevelName(LOG_LEVEL_VERBOSE));
+  TEST_ASSERT_EQUAL_STRING("?", logLevelName(LOG_LEVEL_VERBOSE + 1));
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_line_format);
+  RUN_TEST(test_long_line_is_capped);
+  RUN_TEST(test_full_ring_drops_and_reports);
+  RUN_TEST(test_ring_wraps_without_corruption);
+  RUN_TEST(test_levels_per_module);
+  RUN_TEST(test_compiled_ceiling);
+  RUN_TEST(test_hex_dump);
+  RUN_TEST(test_hex_dump_is_truncated);
+  RUN_TEST(test_names);
+  return UNITY_END();
+}
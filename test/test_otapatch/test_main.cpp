@@ -0,0 +1,233 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Aplicación de parches OTA sobre una partición simulada con archivos (pio test
+// -e native): la imagen base se lee de un archivo, como de la partición en
+// ejecución, y la nueva se escribe en otro, como en la partición OTA.
+
+#include <unity.h>
+#include <libotapatch.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// Parche generado con scripts/make_ota_patch.py --raw a partir de las imágenes
+// de makeBase() y makeNew(): verifica que el generador y el aplicador coinciden
+static const uint8_t pythonPatch[] = {
+  0x4f, 0x54, 0x41, 0x50, 0x01, 0x02, 0x00, 0x00, 0xf4, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00,
+  0x79, 0x9a, 0x23, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x64, 0x00, 0x00, 0x00, 0x26, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x4e, 0x45, 0x57, 0x43, 0x4f, 0x44, 0x45, 0x2d, 0x49, 0x4e, 0x53, 0x45, 0x52, 0x54, 0x45, 0x44,
+  0x2d, 0x4e, 0x45, 0x57, 0x43, 0x4f, 0x44, 0x45, 0x2d, 0x49, 0x4e, 0x53, 0x45, 0x52, 0x54, 0x45,
+  0x44, 0x2d, 0x53, 0xd3, 0x52, 0x9d, 0x28, 0x01, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x34, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd4, 0xda, 0x3c, 0x00, 0x00, 0x00,
+  0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x74, 0x61, 0x69, 0x6c,
+};
+
+struct Partitions {
+  FILE * base;                      // Partición en ejecución
+  FILE * next;                      // Partición OTA que recibe la imagen nueva
+  bool failRead;                    // Simula un error de lectura de la flash
+};
+
+static Partitions parts;
+
+static std::vector<uint8_t> makeBase() {
+  std::vector<uint8_t> out;
+  uint32_t x = 1;
+  for (int i = 0; i < 512; i++) {
+    x = x * 1103515245 + 12345;
+    out.push_back((uint8_t)(x >> 16));
+  }
+  return out;
+}
+
+/**
+ * Imagen nueva: código insertado, un tramo desplazado con punteros reubicados
+ * (un byte de cada 32 cambia), un tramo eliminado y bytes nuevos al final.
+ */
+static std::vector<uint8_t> makeNew(const std::vector<uint8_t> & base) {
+  std::vector<uint8_t> out(base.begin(), base.begin() + 100);
+  const char * inserted = "NEWCODE-INSERTED-NEWCODE-INSERTED-";
+  out.insert(out.end(), inserted, inserted + strlen(inserted));
+  for (int i = 100; i < 400; i++) out.push_back((uint8_t)(base[i] + ((i - 100) % 32 == 0 ? 1 : 0)));
+  out.insert(out.end(), base.begin() + 450, base.end());
+  out.insert(out.end(), { 't', 'a', 'i', 'l' });
+  return out;
+}
+
+static bool readBase(void * context, uint32_t offset, uint8_t * out, size_t length) {
+  Partitions * p = (Partitions *)context;
+  if (p->failRead || fseek(p->base, offset, SEEK_SET) != 0) return false;
+  return fread(out, 1, length, p->base) == length;
+}
+
+static bool writeImage(void * context, const uint8_t * data, size_t length) {
+  Partitions * p = (Partitions *)context;
+  return fwrite(data, 1, length, p->next) == length;
+}
+
+static std::vector<uint8_t> readNext() {
+  fflush(parts.next);
+  long size = ftell(parts.next);
+  std::vector<uint8_t> out(size);
+  rewind(parts.next);
+  if (size > 0) TEST_ASSERT_EQUAL(size, (long)fread(out.data(), 1, size, parts.next));
+  return out;
+}
+
+/**
+ * CRC-32 de la partición base en bloques, como lo verifica libota antes de aplicar.
+ */
+static uint32_t baseCrc(uint32_t size) {
+  uint8_t chunk[OTA_PATCH_CHUNK];
+  uint32_t crc = 0;
+  for (uint32_t pos = 0; pos < size; pos += sizeof(chunk)) {
+    size_t n = size - pos < sizeof(chunk) ? size - pos : sizeof(chunk);
+    TEST_ASSERT_TRUE(readBase(&parts, pos, chunk, n));
+    crc = otaCrc32(crc, chunk, n);
+  }
+  return crc;
+}
+
+/**
+ * Aplica patch entregando el cuerpo en bloques de chunk bytes, como llegan
+ * del pipeline de descarga. Retorna el resultado de otaDeltaFeed.
+ */
+static bool applyPatch(const uint8_t * patch, size_t length, size_t chunk, OtaDelta * delta) {
+  OtaPatchHeader header;
+  TEST_ASSERT_TRUE(otaPatchParseHeader(patch, &header));
+  TEST_ASSERT_TRUE(header.flags & OTA_PATCH_FLAG_DELTA);
+  otaDeltaInit(delta, &header, readBase, writeImage, &parts);
+  for (size_t pos = OTA_PATCH_HEADER_SIZE; pos < length; pos += chunk) {
+    size_t n = length - pos < chunk ? length - pos : chunk;
+    if (!otaDeltaFeed(delta, patch + pos, n)) return false;
+  }
+  return true;
+}
+
+void setUp() {
+  std::vector<uint8_t> base = makeBase();
+  parts.base = tmpfile();
+  parts.next = tmpfile();
+  parts.failRead = false;
+  TEST_ASSERT_NOT_NULL(parts.base);
+  TEST_ASSERT_NOT_NULL(parts.next);
+  fwrite(base.data(), 1, base.size(), parts.base);
+  fflush(parts.base);
+}
+
+void tearDown() {
+  fclose(parts.base);
+  fclose(parts.next);
+}
+
+void test_python_patch_rebuilds_new_image_in_any_chunk_size() {
+  std::vector<uint8_t> expected = makeNew(makeBase());
+  OtaPatchHeader header;
+  TEST_ASSERT_TRUE(otaPatchParseHeader(pythonPatch, &header));
+  TEST_ASSERT_EQUAL_UINT32(expected.size(), header.newSize);
+  TEST_ASSERT_EQUAL_HEX32(header.oldCrc, baseCrc(header.oldSize));
+
+  const size_t chunks[] = { 1, 7, 12, 256, 4096 };
+  for (size_t chunk : chunks) {
+    tearDown();
+    setUp();
+    OtaDelta delta;
+    TEST_ASSERT_TRUE(applyPatch(pythonPatch, sizeof(pythonPatch), chunk, &delta));
+    TEST_ASSERT_TRUE(otaDeltaDone(&delta));
+    std::vector<uint8_t> image = readNext();
+    TEST_ASSERT_EQUAL_size_t(expected.size(), image.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected.data(), image.data(), expected.size());
+  }
+}
+
+void test_different_base_fails_crc_check() {
+  OtaPatchHeader header;
+  otaPatchParseHeader(pythonPatch, &header);
+  fseek(parts.base, 200, SEEK_SET);
+  fputc(0x5A, parts.base);                  // Otra versión instalada
+  fflush(parts.base);
+  TEST_ASSERT_NOT_EQUAL(header.oldCrc, baseCrc(header.oldSize));
+}
+
+void test_truncated_patch_is_not_done() {
+  OtaDelta delta;
+  TEST_ASSERT_TRUE(applyPatch(pythonPatch, sizeof(pythonPatch) - 5, 64, &delta));
+  TEST_ASSERT_FALSE(otaDeltaDone(&delta));
+}
+
+void test_record_past_image_end_is_rejected() {
+  std::vector<uint8_t> patch(pythonPatch, pythonPatch + sizeof(pythonPatch));
+  patch[8] -= 1;                            // newSize un byte menor: el último registro no cabe
+  OtaDelta delta;
+  TEST_ASSERT_FALSE(applyPatch(patch.data(), patch.size(), 64, &delta));
+  TEST_ASSERT_EQUAL(OTA_DELTA_ERROR, delta.stage);
+  TEST_ASSERT_FALSE(otaDeltaFeed(&delta, pythonPatch, 1));  // Tras un error no acepta más datos
+}
+
+void test_flash_read_error_stops_the_patch() {
+  parts.failRead = true;
+  OtaDelta delta;
+  TEST_ASSERT_FALSE(applyPatch(pythonPatch, sizeof(pythonPatch), 64, &delta));
+  TEST_ASSERT_FALSE(otaDeltaDone(&delta));
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_python_patch_rebuilds_new_image_in_any_chunk_size);
+  RUN_TEST(test_different_base_fails_crc_check);
+  RUN_TEST(test_truncated_patch_is_not_done);
+  RUN_TEST(test_record_past_image_end_is_rejected);
+  RUN_TEST(test_flash_read_error_stops_the_patch);
+  return UNITY_END();
+}
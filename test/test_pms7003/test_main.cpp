@@ -0,0 +1,256 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Fuzz y benchmark del parser del PMS7003 (pio test -e native). Las tramas
+// válidas se mezclan con basura, cabeceras falsas, tramas cortadas y sumas
+// incorrectas, y se entregan en bloques de tamaño aleatorio como los de la UART.
+
+#include <unity.h>
+#include <libpms7003.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static uint32_t seed = 1;
+
+/**
+ * Generador congruencial: el fuzz debe ser repetible para poder depurar un fallo.
+ */
+static uint32_t nextRandom() {
+  seed = seed * 1664525 + 1013904223;
+  return seed >> 8;
+}
+
+/**
+ * Valor del campo i en la trama id: los dos primeros llevan la id y el resto
+ * un patrón derivado de ella.
+ */
+static uint16_t fieldValue(uint32_t id, int i) {
+  if (i == 0) return (uint16_t)id;
+  if (i == 1) return (uint16_t)(id >> 16);
+  return (uint16_t)(id * 13 + i);
+}
+
+/**
+ * Arma una trama válida cuyos 12 campos dependen de id.
+ */
+static void makeFrame(uint8_t * f, uint32_t id) {
+  f[0] = 0x42;
+  f[1] = 0x4D;
+  f[2] = 0;
+  f[3] = PMS7003_FRAME_LENGTH;
+  for (int i = 0; i < 13; i++) {
+    uint16_t v = fieldValue(id, i);
+    f[4 + 2 * i] = (uint8_t)(v >> 8);
+    f[5 + 2 * i] = (uint8_t)v;
+  }
+  uint16_t sum = 0;
+  for (int i = 0; i < PMS7003_FRAME_SIZE - 2; i++) sum += f[i];
+  f[30] = (uint8_t)(sum >> 8);
+  f[31] = (uint8_t)sum;
+}
+
+static uint32_t frameId(const PMS7003Data & d) {
+  return (uint32_t)d.pm1_0_cf1 | ((uint32_t)d.pm2_5_cf1 << 16);
+}
+
+static bool matches(const PMS7003Data & d, uint32_t id) {
+  const uint16_t * v = &d.pm1_0_cf1;
+  for (int i = 0; i < 12; i++) {
+    if (v[i] != fieldValue(id, i)) return false;
+  }
+  return true;
+}
+
+/**
+ * Agrega ruido entre tramas: bytes al azar, cabeceras falsas, tramas cortadas
+ * o con la suma alterada. Ninguno de estos puede formar una trama válida.
+ */
+static void appendNoise(std::vector<uint8_t> & stream) {
+  uint8_t f[PMS7003_FRAME_SIZE];
+  switch (nextRandom() % 5) {
+    case 0: {
+      size_t n = nextRandom() % 40;
+      for (size_t i = 0; i < n; i++) stream.push_back((uint8_t)nextRandom());
+      break;
+    }
+    case 1:                                   // Cabecera con longitud incorrecta
+      stream.push_back(0x42);
+      stream.push_back(0x4D);
+      stream.push_back(0x00);
+      stream.push_back((uint8_t)(PMS7003_FRAME_LENGTH + 1 + nextRandom() % 100));
+      break;
+    case 2:                                   // Trama cortada por un byte perdido en la UART
+      makeFrame(f, 0xFFFF);
+      stream.insert(stream.end(), f, f + 1 + nextRandom() % (PMS7003_FRAME_SIZE - 1));
+      break;
+    case 3:                                   // Suma de verificación incorrecta
+      makeFrame(f, 0xFFFF);
+      f[4 + nextRandom() % 26] ^= (uint8_t)(1 + nextRandom() % 255);
+      stream.insert(stream.end(), f, f + PMS7003_FRAME_SIZE);
+      break;
+    default:                                  // Solo la primera mitad de la cabecera
+      stream.push_back(0x42);
+      break;
+  }
+}
+
+/**
+ * Entrega stream al parser en bloques de 1 a maxChunk bytes y retorna las ids
+ * de las tramas válidas en el orden en que se completaron.
+ */
+static std::vector<uint32_t> feedInChunks(Pms7003Parser * p, const std::vector<uint8_t> & stream, size_t maxChunk) {
+  std::vector<uint32_t> ids;
+  size_t i = 0;
+  while (i < stream.size()) {
+    size_t n = 1 + nextRandom() % maxChunk;
+    if (n > stream.size() - i) n = stream.size() - i;
+    size_t frames = pmsParserFeed(p, &stream[i], n);
+    TEST_ASSERT_LESS_OR_EQUAL(PMS7003_FRAME_SIZE - 1, p->pos);
+    PMS7003Data d;
+    if (frames > 0) {
+      TEST_ASSERT_TRUE(pmsParserTake(p, &d));
+      ids.push_back(frameId(d));               // Solo se conserva la última del bloque
+      TEST_ASSERT_TRUE(matches(d, frameId(d)));
+    }
+    i += n;
+  }
+  return ids;
+}
+
+void setUp() {
+  seed = 1;
+}
+
+void tearDown() {}
+
+void test_frames_split_across_reads() {
+  Pms7003Parser p;
+  pmsParserInit(&p);
+  uint8_t f[PMS7003_FRAME_SIZE];
+  makeFrame(f, 7);
+  TEST_ASSERT_EQUAL(0, pmsParserFeed(&p, f, 5));
+  TEST_ASSERT_EQUAL(0, pmsParserFeed(&p, f + 5, 26));
+  TEST_ASSERT_EQUAL(1, pmsParserFeed(&p, f + 31, 1));
+  PMS7003Data d;
+  TEST_ASSERT_TRUE(pmsParserTake(&p, &d));
+  TEST_ASSERT_TRUE(matches(d, 7));
+  TEST_ASSERT_FALSE(pmsParserTake(&p, &d));  // Ya se leyó
+}
+
+void test_truncated_frame_followed_by_valid_frame() {
+  // La cabecera real aparece dentro de la trama cortada: debe reexaminarse
+  for (size_t cut = 1; cut < PMS7003_FRAME_SIZE; cut++) {
+    Pms7003Parser p;
+    pmsParserInit(&p);
+    uint8_t bad[PMS7003_FRAME_SIZE], good[PMS7003_FRAME_SIZE];
+    makeFrame(bad, 1);
+    makeFrame(good, 2);
+    std::vector<uint8_t> stream(bad, bad + cut);
+    stream.insert(stream.end(), good, good + PMS7003_FRAME_SIZE);
+    TEST_ASSERT_EQUAL(1, pmsParserFeed(&p, stream.data(), stream.size()));
+    PMS7003Data d;
+    TEST_ASSERT_TRUE(pmsParserTake(&p, &d));
+    TEST_ASSERT_TRUE(matches(d, 2));
+  }
+}
+
+void test_fuzz_recovers_every_valid_frame() {
+  const uint32_t frames = 20000;
+  std::vector<uint8_t> stream;
+  uint8_t f[PMS7003_FRAME_SIZE];
+  for (uint32_t id = 0; id < frames; id++) {
+    appendNoise(stream);
+    makeFrame(f, id);
+    stream.insert(stream.end(), f, f + PMS7003_FRAME_SIZE);
+  }
+  Pms7003Parser p;
+  pmsParserInit(&p);
+  // Bloques de 1 byte: se ve cada trama y su orden
+  std::vector<uint32_t> ids = feedInChunks(&p, stream, 1);
+  TEST_ASSERT_EQUAL_UINT32(frames, p.stats.frames);
+  TEST_ASSERT_EQUAL_UINT32(frames, ids.size());
+  for (uint32_t id = 0; id < frames; id++) TEST_ASSERT_EQUAL_UINT32(id, ids[id]);
+  TEST_ASSERT_EQUAL_UINT32(stream.size(), p.stats.bytes);
+  TEST_ASSERT_GREATER_THAN(0, p.stats.checksumErrors);
+  TEST_ASSERT_GREATER_THAN(0, p.stats.lengthErrors);
+
+  // Bloques grandes, como los que entrega la UART: mismas tramas en total
+  pmsParserInit(&p);
+  ids = feedInChunks(&p, stream, 256);
+  TEST_ASSERT_EQUAL_UINT32(frames, p.stats.frames);
+  for (size_t i = 1; i < ids.size(); i++) TEST_ASSERT_GREATER_THAN(ids[i - 1], ids[i]);
+}
+
+void test_fuzz_random_bytes_never_overrun() {
+  Pms7003Parser p;
+  pmsParserInit(&p);
+  std::vector<uint8_t> stream;
+  for (int i = 0; i < 1000000; i++) {
+    // Sesgado hacia los bytes de cabecera para llegar más adentro de la trama
+    uint32_t r = nextRandom();
+    stream.push_back(r % 4 == 0 ? 0x42 : r % 4 == 1 ? 0x4D : (uint8_t)(r >> 8));
+  }
+  feedInChunks(&p, stream, 64);
+  TEST_ASSERT_EQUAL_UINT32(stream.size(), p.stats.bytes);
+  // Tras la basura, una trama válida se reconoce en cuanto termina
+  uint8_t f[PMS7003_FRAME_SIZE];
+  makeFrame(f, 9);
+  TEST_ASSERT_EQUAL(1, pmsParserFeed(&p, f, sizeof(f)));
+}
+
+void test_benchmark_throughput() {
+  const uint32_t frames = 100000;
+  std::vector<uint8_t> stream;
+  uint8_t f[PMS7003_FRAME_SIZE];
+  for (uint32_t id = 0; id < frames; id++) {
+    makeFrame(f, id);
+    stream.insert(stream.end(), f, f + PMS7003_FRAME_SIZE);
+    if (id % 10 == 0) appendNoise(stream);    // Un 10 % de tramas con ruido
+  }
+  Pms7003Parser p;
+  pmsParserInit(&p);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < stream.size(); i += 64) {
+    size_t n = stream.size() - i < 64 ? stream.size() - i : 64;
+    pmsParserFeed(&p, &stream[i], n);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_EQUAL_UINT32(frames, p.stats.frames);
+  char msg[128];
+  snprintf(msg, sizeof(msg), "PMS7003: %lu bytes, %.2f ns por byte, %.1f ns por trama",
+           (unsigned long)stream.size(), ns / stream.size(), ns / frames);
+  TEST_MESSAGE(msg);
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_frames_split_across_reads);
+  RUN_TEST(test_truncated_frame_followed_by_valid_frame);
+  RUN_TEST(test_fuzz_recovers_every_valid_frame);
+  RUN_TEST(test_fuzz_random_bytes_never_overrun);
+  RUN_TEST(test_benchmark_throughput);
+  return UNITY_END();
+}
@@ -0,0 +1,239 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Simulación de la reconexión MQTT con un reloj y un PubSubClient falsos
+// (pio test -e native). Cada pasada de loop() avanza el reloj; connect() contra
+// un bróker caído consume el timeout del handshake, igual que en el equipo. Se
+// reporta la peor latencia de una pasada mientras no hay conexión.
+
+#include <unity.h>
+#include <libreconnect.h>
+#include <stdio.h>
+
+#define BACKOFF_BASE_MS 1000                // Igual que MQTT_BACKOFF_BASE_MS en libiot.h
+#define BACKOFF_MAX_MS 60000                // Igual que MQTT_BACKOFF_MAX_MS
+#define CONNECT_TIMEOUT_MS 10000            // Igual que MQTT_CONNECT_TIMEOUT_S
+#define HANDSHAKE_MS 800                    // Handshake TLS exitoso
+#define LOOP_MS 10                          // Resto del trabajo de cada pasada de loop()
+
+static uint32_t clockMs = 0;
+
+// Cliente MQTT falso: solo modela lo que la máquina de reconexión observa
+struct MockPubSubClient {
+  uint32_t brokerUpAt;                      // Instante en que el bróker vuelve a aceptar conexiones
+  bool session;
+  uint32_t connects;
+  uint32_t subscribes;
+
+  bool connect() {
+    connects++;
+    if ((int32_t)(clockMs - brokerUpAt) < 0) {
+      clockMs += CONNECT_TIMEOUT_MS;        // El handshake se agota
+      return false;
+    }
+    clockMs += HANDSHAKE_MS;
+    session = true;
+    return true;
+  }
+  bool subscribe() {
+    subscribes++;
+    return session;
+  }
+};
+
+static MockPubSubClient client;
+static bool wifiLink = true;
+static bool clockSynced = true;
+static uint32_t readyCount = 0;
+static uint32_t seed = 1;
+
+static uint32_t fakeNow() { return clockMs; }
+static bool fakeConnected() { return client.session; }
+static bool fakeLinkUp() { return wifiLink; }
+static bool fakeClockReady() { return clockSynced; }
+static bool fakeConnect() { return client.connect(); }
+static void fakeSubscribe() { client.subscribe(); }
+static void fakeReady() { readyCount++; }
+
+static const ReconnectOps ops = {
+  fakeNow, fakeConnected, fakeLinkUp, fakeClockReady, fakeConnect, fakeSubscribe, fakeReady, NULL
+};
+
+/**
+ * Generador congruencial en lugar de esp_random(), para que la simulación sea repetible.
+ */
+static uint32_t nextRandom() {
+  seed = seed * 1664525 + 1013904223;
+  return seed;
+}
+
+struct LoopStats {
+  uint32_t worstStepMs;                     // Peor tiempo de reconnectStep() en una pasada
+  uint32_t loops;
+};
+
+/**
+ * Corre pasadas de loop() hasta que la conexión esté lista o se llegue a untilMs.
+ * Retorna true si quedó conectado.
+ */
+static bool runLoop(Reconnect * r, uint32_t untilMs, LoopStats * stats) {
+  while ((int32_t)(clockMs - untilMs) < 0) {
+    if (reconnectReady(r)) return true;
+    uint32_t start = clockMs;
+    reconnectStep(r, nextRandom());
+    uint32_t step = clockMs - start;
+    if (step > stats->worstStepMs) stats->worstStepMs = step;
+    stats->loops++;
+    clockMs += LOOP_MS;
+  }
+  return reconnectReady(r);
+}
+
+void setUp() {
+  clockMs = 0;
+  client = MockPubSubClient();
+  wifiLink = true;
+  clockSynced = true;
+  readyCount = 0;
+  seed = 1;
+}
+
+void tearDown() {}
+
+void test_outage_worst_case_loop_latency_is_one_handshake() {
+  const uint32_t outageMs = 10 * 60 * 1000;
+  client.brokerUpAt = outageMs;
+  Reconnect r;
+  reconnectInit(&r, &ops, BACKOFF_BASE_MS, BACKOFF_MAX_MS);
+  LoopStats stats = {};
+
+  TEST_ASSERT_FALSE(runLoop(&r, outageMs, &stats));
+  char message[96];
+  snprintf(message, sizeof(message), "Bróker caído 10 min: %lu intentos, %lu pasadas, peor pasada %lu ms",
+           (unsigned long)client.connects, (unsigned long)stats.loops, (unsigned long)stats.worstStepMs);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL_UINT32(CONNECT_TIMEOUT_MS, stats.worstStepMs);
+  // Con el tope de 60 s (espera mínima de 30 s) no se martilla al bróker
+  TEST_ASSERT_LESS_OR_EQUAL(outageMs / (BACKOFF_MAX_MS / 2 + CONNECT_TIMEOUT_MS) + 8, client.connects);
+  TEST_ASSERT_GREATER_THAN(outageMs / (BACKOFF_MAX_MS + CONNECT_TIMEOUT_MS), client.connects);
+
+  // Al volver el bróker se conecta a más tardar tras la espera máxima
+  TEST_ASSERT_TRUE(runLoop(&r, outageMs + BACKOFF_MAX_MS + CONNECT_TIMEOUT_MS + HANDSHAKE_MS + 3 * LOOP_MS, &stats));
+  TEST_ASSERT_EQUAL_UINT32(1, readyCount);
+  TEST_ASSERT_EQUAL_UINT32(1, client.subscribes);
+  TEST_ASSERT_EQUAL_UINT32(0, r.backoff.attempt);
+}
+
+void test_only_connect_step_blocks() {
+  client.brokerUpAt = 0;
+  Reconnect r;
+  reconnectInit(&r, &ops, BACKOFF_BASE_MS, BACKOFF_MAX_MS);
+  uint32_t durations[4];
+  for (int i = 0; i < 4; i++) {
+    uint32_t start = clockMs;
+    reconnectStep(&r, nextRandom());
+    durations[i] = clockMs - start;
+  }
+  TEST_ASSERT_EQUAL_UINT32(HANDSHAKE_MS, durations[0]);  // connect
+  TEST_ASSERT_EQUAL_UINT32(0, durations[1]);             // subscribe
+  TEST_ASSERT_EQUAL_UINT32(0, durations[2]);             // subscribe OTA
+  TEST_ASSERT_EQUAL_UINT32(0, durations[3]);             // listo: nada que hacer
+  TEST_ASSERT_TRUE(reconnectReady(&r));
+}
+
+void test_no_connect_without_link_or_clock() {
+  client.brokerUpAt = 0;
+  wifiLink = false;
+  Reconnect r;
+  reconnectInit(&r, &ops, BACKOFF_BASE_MS, BACKOFF_MAX_MS);
+  LoopStats stats = {};
+  TEST_ASSERT_FALSE(runLoop(&r, 120000, &stats));
+  TEST_ASSERT_EQUAL_UINT32(0, client.connects);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.worstStepMs);
+
+  wifiLink = true;
+  clockSynced = false;                      // Sin SNTP el certificado no se puede verificar
+  TEST_ASSERT_FALSE(runLoop(&r, 240000, &stats));
+  TEST_ASSERT_EQUAL_UINT32(0, client.connects);
+
+  clockSynced = true;
+  TEST_ASSERT_TRUE(runLoop(&r, 240000 + HANDSHAKE_MS + 3 * LOOP_MS, &stats));
+}
+
+void test_lost_session_retries_from_base_backoff() {
+  client.brokerUpAt = 0;
+  Reconnect r;
+  reconnectInit(&r, &ops, BACKOFF_BASE_MS, BACKOFF_MAX_MS);
+  LoopStats stats = {};
+  TEST_ASSERT_TRUE(runLoop(&r, 10000, &stats));
+
+  client.session = false;                   // El bróker cierra la sesión
+  uint32_t lostAt = clockMs;
+  reconnectStep(&r, nextRandom());
+  TEST_ASSERT_EQUAL(RECONNECT_WAIT_RETRY, r.state);
+  uint32_t wait = r.retryAt - lostAt;
+  TEST_ASSERT_GREATER_OR_EQUAL(BACKOFF_BASE_MS / 2, wait);
+  TEST_ASSERT_LESS_OR_EQUAL(BACKOFF_BASE_MS, wait);
+  TEST_ASSERT_TRUE(runLoop(&r, lostAt + BACKOFF_BASE_MS + HANDSHAKE_MS + 4 * LOOP_MS, &stats));
+  TEST_ASSERT_EQUAL_UINT32(2, readyCount);
+}
+
+void test_fleet_reconnects_are_spread_by_jitter() {
+  // 100 equipos pierden el bróker a la vez; al volver no deben llegar todos juntos
+  const int devices = 100;
+  const uint32_t outageMs = 5 * 60 * 1000;
+  uint32_t first = 0xFFFFFFFF, last = 0;
+  uint32_t perSecond[BACKOFF_MAX_MS / 1000 + 20] = {};
+  uint32_t busiest = 0;
+  for (int d = 0; d < devices; d++) {
+    setUp();
+    seed = 7919 * (d + 1);
+    client.brokerUpAt = outageMs;
+    Reconnect r;
+    reconnectInit(&r, &ops, BACKOFF_BASE_MS, BACKOFF_MAX_MS);
+    LoopStats stats = {};
+    TEST_ASSERT_TRUE(runLoop(&r, outageMs + 2 * BACKOFF_MAX_MS, &stats));
+    uint32_t at = clockMs - outageMs;
+    if (at < first) first = at;
+    if (at > last) last = at;
+    uint32_t slot = at / 1000;
+    if (slot < sizeof(perSecond) / sizeof(perSecond[0]) && ++perSecond[slot] > busiest) busiest = perSecond[slot];
+  }
+  char message[96];
+  snprintf(message, sizeof(message), "Reconexiones entre +%lu ms y +%lu ms, máximo %lu por segundo",
+           (unsigned long)first, (unsigned long)last, (unsigned long)busiest);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_GREATER_THAN(BACKOFF_MAX_MS / 4, last - first);
+  TEST_ASSERT_LESS_OR_EQUAL(devices / 10, busiest);
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_outage_worst_case_loop_latency_is_one_handshake);
+  RUN_TEST(test_only_connect_step_blocks);
+  RUN_TEST(test_no_connect_without_link_or_clock);
+  RUN_TEST(test_lost_session_retries_from_base_backoff);
+  RUN_TEST(test_fleet_reconnects_are_spread_by_jitter);
+  return UNITY_END();
+}
@@ -0,0 +1,140 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Pruebas del despliegue escalonado (pio test -e native): vectores de hash,
+// cohorte y retardo compartidos con scripts/simulate_rollout.py (VECTORS), el
+// recorte de la ventana y el token bucket, incluido el desborde de millis().
+
+#include <unity.h>
+#include <librollout.h>
+
+typedef struct {
+  const char * deviceId;
+  const char * seed;
+  uint32_t windowS;
+  uint32_t hash;
+  uint8_t cohort;
+  uint32_t delayMs;
+} RolloutVector;
+
+// Los mismos valores que VECTORS en scripts/simulate_rollout.py
+static const RolloutVector vectors[] = {
+  { "ESP32-AABBCCDDEEFF", "v1.2.0", 900, 0xCCDB8A5Cu, 68, 787831 },
+  { "ESP32-000000000000", "v1.2.0", 900, 0xA44C520Au, 62, 522407 },
+  { "ESP32-246F28A1B2C3", "lote-7", 3600, 0x97DE562Bu, 67, 3585029 },
+  { "ESP32-AABBCCDDEEFF", "v1.3.0", 604800, 0x33B7EF43u, 55, 571960704 },
+  { "ESP32-AABBCCDDEEFF", "v1.3.0", 10000000, 0x33B7EF43u, 55, 571960704 },
+};
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_vectors_match_simulator() {
+  for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+    const RolloutVector & v = vectors[i];
+    uint32_t hash = rolloutHash(v.deviceId, v.seed);
+    TEST_ASSERT_EQUAL_HEX32(v.hash, hash);
+    TEST_ASSERT_EQUAL_UINT8(v.cohort, rolloutCohort(hash));
+    TEST_ASSERT_EQUAL_UINT32(v.delayMs, rolloutDelayMs(hash, v.windowS));
+  }
+}
+
+void test_delay_stays_inside_window() {
+  TEST_ASSERT_EQUAL_UINT32(0, rolloutDelayMs(0xFFFFFFFFu, 0));
+  for (uint32_t h = 0; h < 100000; h++) {
+    uint32_t hash = h * 2654435761u;
+    TEST_ASSERT_TRUE(rolloutDelayMs(hash, 900) < 900000u);
+    TEST_ASSERT_TRUE(rolloutDelayMs(hash, 0xFFFFFFFFu) < (uint32_t)ROLLOUT_MAX_WINDOW_S * 1000u);
+  }
+  // Una ventana mayor al máximo da el mismo retardo que el máximo
+  TEST_ASSERT_EQUAL_UINT32(rolloutDelayMs(0x12345678u, ROLLOUT_MAX_WINDOW_S),
+                           rolloutDelayMs(0x12345678u, ROLLOUT_MAX_WINDOW_S + 1));
+}
+
+void test_zero_rate_means_no_limit() {
+  RateLimiter limiter;
+  rateLimitInit(&limiter, 0, ROLLOUT_BURST_BYTES, 1000);
+  for (uint32_t i = 0; i < 1000; i++) TEST_ASSERT_EQUAL_UINT32(0, rateLimitWaitMs(&limiter, 1 << 20, 1000));
+}
+
+void test_burst_then_steady_rate() {
+  RateLimiter limiter;
+  rateLimitInit(&limiter, 32000, ROLLOUT_BURST_BYTES, 0);
+  // La ráfaga pasa sin esperar; el buffer siguiente espera lo que tarda a 32 kB/s
+  for (int i = 0; i < ROLLOUT_BURST_BYTES / 4096; i++) TEST_ASSERT_EQUAL_UINT32(0, rateLimitWaitMs(&limiter, 4096, 0));
+  TEST_ASSERT_EQUAL_UINT32(128, rateLimitWaitMs(&limiter, 4096, 0));
+  // Esperando lo pedido se sostiene la velocidad: 1 MB en ~32 s
+  uint32_t now = 128;
+  uint32_t bytes = 0;
+  while (bytes < 1000000) {
+    now += rateLimitWaitMs(&limiter, 4096, now);
+    bytes += 4096;
+  }
+  TEST_ASSERT_UINT32_WITHIN(1, bytes / 32, now - 128);
+}
+
+void test_fraction_of_byte_is_not_lost() {
+  // A 1 byte/s, 1000 llamadas separadas 1 ms acumulan un byte entero
+  RateLimiter limiter;
+  rateLimitInit(&limiter, 1, 0, 0);
+  TEST_ASSERT_EQUAL_UINT32(1000, rateLimitWaitMs(&limiter, 1, 0));
+  for (uint32_t t = 1; t <= 1000; t++) rateLimitWaitMs(&limiter, 0, t);
+  TEST_ASSERT_EQUAL_UINT32(0, rateLimitWaitMs(&limiter, 0, 1000));
+  TEST_ASSERT_EQUAL_UINT32(1000, rateLimitWaitMs(&limiter, 1, 1000));
+}
+
+void test_refill_across_millis_wraparound() {
+  RateLimiter limiter;
+  uint32_t start = 0xFFFFFF00u;             // 256 ms antes de que millis() vuelva a 0
+  rateLimitInit(&limiter, 1000, 4096, start);
+  TEST_ASSERT_EQUAL_UINT32(0, rateLimitWaitMs(&limiter, 4096, start));
+  TEST_ASSERT_EQUAL_UINT32(1000, rateLimitWaitMs(&limiter, 1000, start));
+  // 1256 ms después, ya pasado el desborde, la deuda está pagada y sobran 256 bytes
+  uint32_t later = start + 1256;
+  TEST_ASSERT_TRUE(later < start);
+  TEST_ASSERT_EQUAL_UINT32(0, rateLimitWaitMs(&limiter, 256, later));
+  TEST_ASSERT_EQUAL_UINT32(1, rateLimitWaitMs(&limiter, 1, later));
+}
+
+void test_idle_refill_is_capped_at_burst() {
+  RateLimiter limiter;
+  rateLimitInit(&limiter, 1000, 4096, 0);
+  TEST_ASSERT_EQUAL_UINT32(0, rateLimitWaitMs(&limiter, 4096, 0));
+  // Una hora sin descargar no acumula más que la ráfaga
+  TEST_ASSERT_EQUAL_UINT32(0, rateLimitWaitMs(&limiter, 4096, 3600000));
+  TEST_ASSERT_EQUAL_UINT32(1000, rateLimitWaitMs(&limiter, 1000, 3600000));
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_vectors_match_simulator);
+  RUN_TEST(test_delay_stays_inside_window);
+  RUN_TEST(test_zero_rate_means_no_limit);
+  RUN_TEST(test_burst_then_steady_rate);
+  RUN_TEST(test_fraction_of_byte_is_not_lost);
+  RUN_TEST(test_refill_across_millis_wraparound);
+  RUN_TEST(test_idle_refill_is_capped_at_burst);
+  return UNITY_END();
+}
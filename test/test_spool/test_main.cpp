@@ -0,0 +1,248 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Pruebas de recuperación de la cola persistente (pio test -e native). Un
+// directorio temporal hace de flash; los reinicios se simulan cortando o
+// renombrando archivos y volviendo a llamar a spoolBegin.
+
+#include <unity.h>
+#include <libspool.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RECORD_SIZE 32                      // Contenido de cada registro de prueba
+#define RECORD_HEADER 8                     // Igual que en libspool.cpp
+#define PER_SEGMENT (SPOOL_SEGMENT_SIZE / (RECORD_HEADER + SPOOL_RECORD_MAX))
+
+static char dir[SPOOL_PATH_MAX];
+
+static void makeRecord(uint8_t * out, size_t length, uint32_t id) {
+  for (size_t i = 0; i < length; i++) out[i] = (uint8_t)(id * 31 + i);
+  memcpy(out, &id, sizeof(id));
+}
+
+static bool append(uint32_t id, size_t length = RECORD_SIZE) {
+  uint8_t record[SPOOL_RECORD_MAX];
+  makeRecord(record, length, id);
+  return spoolAppend(record, length);
+}
+
+/**
+ * Lee el siguiente registro, verifica su contenido y retorna su id (-1 si no hay).
+ */
+static long readId() {
+  uint8_t buf[SPOOL_RECORD_MAX];
+  uint8_t expected[SPOOL_RECORD_MAX];
+  size_t length = spoolRead(buf, sizeof(buf));
+  if (length == 0) return -1;
+  uint32_t id;
+  memcpy(&id, buf, sizeof(id));
+  makeRecord(expected, length, id);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, length);
+  return (long)id;
+}
+
+static void filePath(char * out, size_t size, const char * name) {
+  snprintf(out, size, "%s/%s", dir, name);
+}
+
+static long fileSize(const char * name) {
+  char path[SPOOL_PATH_MAX + 20];
+  filePath(path, sizeof(path), name);
+  FILE * f = fopen(path, "rb");
+  if (!f) return -1;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fclose(f);
+  return size;
+}
+
+/**
+ * Simula un append interrumpido dejando el segmento con length bytes.
+ */
+static void cutFile(const char * name, long length) {
+  char path[SPOOL_PATH_MAX + 20];
+  filePath(path, sizeof(path), name);
+  TEST_ASSERT_EQUAL(0, truncate(path, length));
+}
+
+static void removeDir() {
+  DIR * d = opendir(dir);
+  if (!d) return;
+  struct dirent * entry;
+  char path[SPOOL_PATH_MAX + 280];
+  while ((entry = readdir(d)) != NULL) {
+    if (entry->d_name[0] == '.') continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+    remove(path);
+  }
+  closedir(d);
+  rmdir(dir);
+}
+
+void setUp() {
+  strcpy(dir, "/tmp/spoolXXXXXX");
+  TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+  TEST_ASSERT_TRUE(spoolBegin(dir));
+}
+
+void tearDown() {
+  spoolRewind();                            // Cierra el segmento abierto por spoolRead
+  removeDir();
+}
+
+void test_round_trip_rewind_and_commit() {
+  TEST_ASSERT_TRUE(spoolEmpty());
+  for (uint32_t id = 0; id < 3; id++) TEST_ASSERT_TRUE(append(id, RECORD_SIZE + id));
+  TEST_ASSERT_EQUAL(0, readId());
+  TEST_ASSERT_EQUAL(1, readId());
+  spoolRewind();                            // Publicación fallida: se reintenta todo
+  TEST_ASSERT_EQUAL(0, readId());
+  TEST_ASSERT_EQUAL(1, readId());
+  TEST_ASSERT_EQUAL(2, readId());
+  TEST_ASSERT_EQUAL(-1, readId());
+  TEST_ASSERT_FALSE(spoolEmpty());
+  TEST_ASSERT_TRUE(spoolCommit());
+  TEST_ASSERT_TRUE(spoolEmpty());
+  TEST_ASSERT_EQUAL(0, spoolSegments());
+}
+
+void test_reboot_resumes_from_committed_position() {
+  for (uint32_t id = 0; id < 4; id++) append(id);
+  TEST_ASSERT_EQUAL(0, readId());
+  TEST_ASSERT_TRUE(spoolCommit());
+  TEST_ASSERT_EQUAL(1, readId());           // Leído pero no confirmado antes del reinicio
+
+  TEST_ASSERT_TRUE(spoolBegin(dir));
+  TEST_ASSERT_EQUAL(1, readId());           // Se entrega de nuevo: al menos una vez
+  TEST_ASSERT_EQUAL(2, readId());
+  TEST_ASSERT_EQUAL(3, readId());
+  TEST_ASSERT_EQUAL(-1, readId());
+  TEST_ASSERT_TRUE(append(4));              // Se sigue escribiendo tras el último registro
+  TEST_ASSERT_EQUAL(4, readId());
+}
+
+void test_torn_append_drops_only_the_partial_record() {
+  uint32_t recordBytes = RECORD_HEADER + RECORD_SIZE;
+  // Cortar en cada byte posible del último registro, cabecera incluida
+  for (uint32_t cut = 1; cut < recordBytes; cut++) {
+    tearDown();
+    setUp();
+    for (uint32_t id = 0; id < 3; id++) append(id);
+    cutFile("seg00000.log", 2 * recordBytes + cut);
+    uint32_t corrupt = getSpoolStats().corrupt;
+
+    TEST_ASSERT_TRUE(spoolBegin(dir));
+    TEST_ASSERT_EQUAL(0, readId());
+    TEST_ASSERT_EQUAL(1, readId());
+    TEST_ASSERT_EQUAL(-1, readId());
+    TEST_ASSERT_EQUAL_UINT32(corrupt + 1, getSpoolStats().corrupt);
+
+    // El segmento dañado queda sellado: lo nuevo va a otro y se lee completo
+    TEST_ASSERT_TRUE(append(10));
+    TEST_ASSERT_EQUAL((long)recordBytes, fileSize("seg00001.log"));
+    TEST_ASSERT_EQUAL(10, readId());
+    TEST_ASSERT_EQUAL(-1, readId());
+    TEST_ASSERT_TRUE(spoolCommit());
+    TEST_ASSERT_TRUE(spoolEmpty());
+  }
+}
+
+void test_interrupted_head_rename_recovers_from_temp_file() {
+  for (uint32_t id = 0; id < 4; id++) append(id);
+  TEST_ASSERT_EQUAL(0, readId());
+  TEST_ASSERT_TRUE(spoolCommit());
+  TEST_ASSERT_EQUAL(1, readId());
+  TEST_ASSERT_EQUAL(2, readId());
+  TEST_ASSERT_TRUE(spoolCommit());
+
+  // Reinicio entre remove("head") y rename("head.tmp", "head")
+  char head[SPOOL_PATH_MAX + 20];
+  char tmp[SPOOL_PATH_MAX + 20];
+  filePath(head, sizeof(head), "head");
+  filePath(tmp, sizeof(tmp), "head.tmp");
+  TEST_ASSERT_EQUAL(0, rename(head, tmp));
+
+  TEST_ASSERT_TRUE(spoolBegin(dir));
+  TEST_ASSERT_EQUAL(3, readId());           // No se reenvía lo ya confirmado
+  TEST_ASSERT_EQUAL(-1, readId());
+}
+
+void test_torn_head_temp_file_keeps_previous_head() {
+  for (uint32_t id = 0; id < 4; id++) append(id);
+  TEST_ASSERT_EQUAL(0, readId());
+  TEST_ASSERT_EQUAL(1, readId());
+  TEST_ASSERT_TRUE(spoolCommit());
+
+  // Reinicio mientras se escribía head.tmp: queda a medias junto al head anterior
+  char tmp[SPOOL_PATH_MAX + 20];
+  filePath(tmp, sizeof(tmp), "head.tmp");
+  FILE * f = fopen(tmp, "wb");
+  TEST_ASSERT_NOT_NULL(f);
+  fwrite("\x07\x00\x00", 1, 3, f);
+  fclose(f);
+
+  TEST_ASSERT_TRUE(spoolBegin(dir));
+  TEST_ASSERT_EQUAL(2, readId());
+  TEST_ASSERT_EQUAL(3, readId());
+  TEST_ASSERT_EQUAL(-1, readId());
+}
+
+void test_full_spool_drops_oldest_segment() {
+  uint32_t total = PER_SEGMENT * (SPOOL_MAX_SEGMENTS + 1);
+  uint32_t dropped = getSpoolStats().droppedSegments;
+  for (uint32_t id = 0; id < total; id++) {
+    TEST_ASSERT_TRUE(append(id, SPOOL_RECORD_MAX));
+  }
+  TEST_ASSERT_EQUAL_UINT32(dropped + 1, getSpoolStats().droppedSegments);
+  TEST_ASSERT_EQUAL(SPOOL_MAX_SEGMENTS, spoolSegments());
+  TEST_ASSERT_EQUAL(-1, fileSize("seg00000.log"));
+  TEST_ASSERT_EQUAL(PER_SEGMENT, readId()); // El primero que sobrevive
+
+  // El descarte también se persiste: tras un reinicio no reaparece el segmento perdido
+  TEST_ASSERT_TRUE(spoolBegin(dir));
+  uint32_t expected = PER_SEGMENT;
+  long id;
+  while ((id = readId()) >= 0) {
+    TEST_ASSERT_EQUAL((long)expected, id);
+    expected++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(total, expected);
+  TEST_ASSERT_TRUE(spoolCommit());
+  TEST_ASSERT_TRUE(spoolEmpty());
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip_rewind_and_commit);
+  RUN_TEST(test_reboot_resumes_from_committed_position);
+  RUN_TEST(test_torn_append_drops_only_the_partial_record);
+  RUN_TEST(test_interrupted_head_rename_recovers_from_temp_file);
+  RUN_TEST(test_torn_head_temp_file_keeps_previous_head);
+  RUN_TEST(test_full_spool_drops_oldest_segment);
+  return UNITY_END();
+}
@@ -0,0 +1,136 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Prueba de estrés de la cola SPSC (pio test -e native): un hilo productor y
+// uno consumidor corren a la vez y se verifica que los elementos lleguen
+// completos, en orden y sin pérdidas más allá de los desbordes contados.
+
+#include <unity.h>
+#include <libspsc.h>
+#include <thread>
+
+#define ITEMS 2000000               // Muchas vueltas completas al ring
+#define WORDS 6
+
+// Elemento de varias palabras, para detectar lecturas a medio escribir
+struct Item {
+  uint32_t seq;
+  uint32_t words[WORDS];
+};
+
+static Item makeItem(uint32_t seq) {
+  Item item;
+  item.seq = seq;
+  for (int i = 0; i < WORDS; i++) item.words[i] = seq * 2654435761u + i;
+  return item;
+}
+
+static bool intact(const Item & item) {
+  for (int i = 0; i < WORDS; i++) {
+    if (item.words[i] != item.seq * 2654435761u + i) return false;
+  }
+  return true;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+/**
+ * El productor reintenta cuando la cola está llena: el consumidor debe ver
+ * todos los elementos, exactamente una vez y en orden.
+ */
+void test_retrying_producer_loses_nothing() {
+  static SpscRing<Item, 64> q;
+  uint32_t fullRetries = 0;
+  std::thread producer([&] {
+    for (uint32_t seq = 0; seq < ITEMS; seq++) {
+      Item item = makeItem(seq);
+      while (!q.push(item)) {
+        fullRetries++;
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint32_t expected = 0, torn = 0, outOfOrder = 0;
+  Item item;
+  while (expected < ITEMS) {
+    if (!q.pop(&item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (!intact(item)) torn++;
+    if (item.seq != expected) outOfOrder++;
+    expected = item.seq + 1;
+  }
+  producer.join();
+
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+  TEST_ASSERT_FALSE(q.pop(&item));
+  TEST_ASSERT_EQUAL_UINT32(ITEMS, q.pushed());
+  TEST_ASSERT_EQUAL_UINT32(fullRetries, q.overruns());
+  TEST_ASSERT_LESS_OR_EQUAL(64, q.highWater());
+}
+
+/**
+ * El productor descarta cuando la cola está llena (como la tarea de sensores):
+ * lo que llega es creciente y lo recibido más lo descartado cubre todo.
+ */
+void test_dropping_producer_accounts_for_every_item() {
+  static SpscRing<Item, 64> ring;
+  std::thread producer([] {
+    for (uint32_t seq = 0; seq < ITEMS; seq++) ring.push(makeItem(seq));
+  });
+
+  uint32_t received = 0, torn = 0, outOfOrder = 0;
+  long last = -1;
+  Item item;
+  bool producing = true;
+  while (producing || ring.size() > 0) {
+    if (!ring.pop(&item)) {
+      producing = ring.pushed() + ring.overruns() < ITEMS;
+      continue;
+    }
+    if (!intact(item)) torn++;
+    if ((long)item.seq <= last) outOfOrder++;
+    last = item.seq;
+    received++;
+  }
+  producer.join();
+  while (ring.pop(&item)) received++;
+
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+  TEST_ASSERT_EQUAL_UINT32(ITEMS, received + ring.overruns());
+  TEST_ASSERT_EQUAL_UINT32(received, ring.pushed());
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_retrying_producer_loses_nothing);
+  RUN_TEST(test_dropping_producer_accounts_for_every_item);
+  return UNITY_END();
+}
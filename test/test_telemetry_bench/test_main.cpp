@@ -0,0 +1,178 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Benchmark del codificador de telemetría en el host (pio test -e native):
+// verifica que codificar una muestra no reserva memoria y reporta los ciclos
+// y microsegundos por codificación que registra getTelemetryStats().
+
+#include <unity.h>
+#include <libtelemetry.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+// Contador de reservas: operator new siempre y, con glibc, también malloc.
+// Los operator delete liberan con free() lo que este operator new reservó con malloc()
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+static volatile bool counting = false;
+static volatile unsigned allocations = 0;
+
+void * operator new(size_t size) {
+  if (counting) allocations++;
+  void * p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void * operator new[](size_t size) { return operator new(size); }
+void operator delete(void * p) noexcept { free(p); }
+void operator delete[](void * p) noexcept { free(p); }
+void operator delete(void * p, size_t) noexcept { free(p); }
+void operator delete[](void * p, size_t) noexcept { free(p); }
+
+#if defined(__GLIBC__)
+extern "C" void * __libc_malloc(size_t size);
+extern "C" void * __libc_calloc(size_t count, size_t size);
+extern "C" void * __libc_realloc(void * p, size_t size);
+extern "C" void * malloc(size_t size) {
+  if (counting) allocations++;
+  return __libc_malloc(size);
+}
+extern "C" void * calloc(size_t count, size_t size) {
+  if (counting) allocations++;
+  return __libc_calloc(count, size);
+}
+extern "C" void * realloc(void * p, size_t size) {
+  if (counting) allocations++;
+  return __libc_realloc(p, size);
+}
+#endif
+
+#define BENCH_ITERATIONS 100000
+
+static SensorData sample(uint32_t i) {
+  SensorData d = {};
+  d.co2 = (uint16_t)(400 + i % 5000);
+  d.tvoc = (uint16_t)(i % 1200);
+  d.ccs811_valido = true;
+  uint16_t * pms = (uint16_t *)&d.pms7003;
+  for (int f = 0; f < 12; f++) pms[f] = (uint16_t)((i * 37 + f * 1013) & 0xFFFF);
+  d.pms7003_valido = true;
+  return d;
+}
+
+void setUp() {
+  resetTelemetryStats();
+}
+
+void tearDown() {}
+
+/**
+ * Codifica BENCH_ITERATIONS muestras distintas en un mismo buffer y reporta
+ * el promedio y el peor caso de ciclos.
+ */
+static void bench(bool cbor) {
+  static uint8_t buf[TELEMETRY_JSON_MAX];
+  SensorData data[64];
+  for (uint32_t i = 0; i < 64; i++) data[i] = sample(i);
+  uint64_t cycles = 0, micros = 0, bytes = 0;
+  allocations = 0;
+  counting = true;
+  for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+    size_t n = cbor ? encodeSensorDataCbor(&data[i & 63], buf, TELEMETRY_CBOR_MAX)
+                    : encodeSensorDataJson(&data[i & 63], (char *)buf, TELEMETRY_JSON_MAX);
+    if (n == 0) break;
+    const TelemetryStats & s = getTelemetryStats();
+    cycles += s.lastCycles;
+    micros += s.lastMicros;
+    bytes += n;
+  }
+  counting = false;
+  const TelemetryStats & s = getTelemetryStats();
+  TEST_ASSERT_EQUAL_UINT32(BENCH_ITERATIONS, s.encodes);
+  TEST_ASSERT_EQUAL_UINT32(0, s.overflows);
+  TEST_ASSERT_EQUAL_UINT_MESSAGE(0, allocations, "el codificador no debe reservar memoria");
+  char msg[160];
+  snprintf(msg, sizeof(msg), "%s: %.1f bytes, %.0f ciclos promedio (peor %lu), %.3f us por muestra, 0 reservas",
+           cbor ? "CBOR" : "JSON", (double)bytes / BENCH_ITERATIONS, (double)cycles / BENCH_ITERATIONS,
+           (unsigned long)s.maxCycles, (double)micros / BENCH_ITERATIONS);
+  TEST_MESSAGE(msg);
+}
+
+void test_allocation_counter_detects_heap_use() {
+  allocations = 0;
+  counting = true;
+  char * p = new char[16];
+  void * q = malloc(16);
+  counting = false;
+  delete[] p;
+  free(q);
+  TEST_ASSERT_GREATER_THAN(0, allocations);
+}
+
+void test_json_encode_is_allocation_free() {
+  bench(false);
+}
+
+void test_cbor_encode_is_allocation_free() {
+  bench(true);
+}
+
+void test_batch_encode_is_allocation_free() {
+  static char buf[TELEMETRY_BATCH_MAX(8)];
+  TimedSample samples[8];
+  const TimedSample * ptrs[8];
+  for (uint32_t i = 0; i < 8; i++) {
+    samples[i].timestamp = 1700000000 + i * 2;
+    samples[i].data = sample(i);
+    ptrs[i] = &samples[i];
+  }
+  allocations = 0;
+  counting = true;
+  size_t json = encodeBatchJson(ptrs, 8, buf, sizeof(buf));
+  size_t cbor = encodeBatchCbor(ptrs, 8, (uint8_t *)buf, sizeof(buf));
+  counting = false;
+  TEST_ASSERT_GREATER_THAN(0, json);
+  TEST_ASSERT_GREATER_THAN(0, cbor);
+  TEST_ASSERT_EQUAL_UINT(0, allocations);
+}
+
+void test_overflow_reports_zero_without_writing_past_buffer() {
+  SensorData d = sample(7);
+  char buf[40];
+  memset(buf, 0x5A, sizeof(buf));
+  TEST_ASSERT_EQUAL_size_t(0, encodeSensorDataJson(&d, buf, 32));
+  for (size_t i = 32; i < sizeof(buf); i++) TEST_ASSERT_EQUAL_UINT8(0x5A, (uint8_t)buf[i]);
+  TEST_ASSERT_EQUAL_UINT32(1, getTelemetryStats().overflows);
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_allocation_counter_detects_heap_use);
+  RUN_TEST(test_json_encode_is_allocation_free);
+  RUN_TEST(test_cbor_encode_is_allocation_free);
+  RUN_TEST(test_batch_encode_is_allocation_free);
+  RUN_TEST(test_overflow_reports_zero_without_writing_past_buffer);
+  return UNITY_END();
+}
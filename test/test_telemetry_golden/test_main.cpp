@@ -0,0 +1,175 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2024 Alvaro Salazar <alvaro@denkitronik.com>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Vectores de referencia de la codificación de telemetría (pio test -e native).
+// Los bytes esperados se generaron aparte, a partir del layout documentado en
+// src/libtelemetry.cpp, no con este codificador. Si un vector cambia, cambió el
+// formato que consume el backend: hay que subir TELEMETRY_CBOR_VERSION o
+// actualizar scripts/decode_telemetry.py.
+
+#include <unity.h>
+#include <libtelemetry.h>
+#include <stdio.h>
+#include <string.h>
+
+struct GoldenVector {
+  const char * name;
+  SensorData data;
+  const char * cbor;                // Hexadecimal
+  const char * json;
+};
+
+static SensorData makeSample(uint16_t co2, uint16_t tvoc, bool ccs811, const uint16_t pms[12], bool pmsValid) {
+  SensorData d = {};
+  d.co2 = co2;
+  d.tvoc = tvoc;
+  d.ccs811_valido = ccs811;
+  memcpy(&d.pms7003, pms, sizeof(d.pms7003));
+  d.pms7003_valido = pmsValid;
+  return d;
+}
+
+static const uint16_t pmsRamp[12] = { 0, 40, 80, 120, 160, 200, 240, 280, 320, 360, 400, 440 };
+static const uint16_t pmsEdges[12] = { 1, 2, 3, 4, 25, 300, 1234, 567, 89, 10, 0, 65535 };
+static const uint16_t pmsOnly[12] = { 0, 0, 0, 3, 5, 7, 100, 24, 23, 255, 256, 0 };
+static const uint16_t pmsStale[12] = { 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9 };
+
+static GoldenVector vectors[4];
+
+static size_t fromHex(const char * hex, uint8_t * out, size_t size) {
+  size_t n = 0;
+  for (; hex[0] && hex[1] && n < size; hex += 2) {
+    unsigned byte;
+    sscanf(hex, "%2x", &byte);
+    out[n++] = (uint8_t)byte;
+  }
+  return n;
+}
+
+void setUp() {
+  // Referencia de scripts/decode_telemetry.py
+  vectors[0] = { "ramp", makeSample(415, 12, true, pmsRamp, true),
+    "90010319019f0c0018281850187818a018c818f01901181901401901681901901901b8",
+    "{\"co2\":415,\"tvoc\":12,\"pm1_0\":120,\"pm2_5\":160,\"pm10\":200,\"pm1_0_cf1\":0,\"pm2_5_cf1\":40,"
+    "\"pm10_cf1\":80,\"n0_3\":240,\"n0_5\":280,\"n1_0\":320,\"n2_5\":360,\"n5_0\":400,\"n10\":440}" };
+  // Bordes de la codificación CBOR: 1, 2 y 3 bytes por valor
+  vectors[1] = { "edges", makeSample(65535, 23, true, pmsEdges, true),
+    "90010319ffff1701020304181919012c1904d219023718590a0019ffff",
+    "{\"co2\":65535,\"tvoc\":23,\"pm1_0\":4,\"pm2_5\":25,\"pm10\":300,\"pm1_0_cf1\":1,\"pm2_5_cf1\":2,"
+    "\"pm10_cf1\":3,\"n0_3\":1234,\"n0_5\":567,\"n1_0\":89,\"n2_5\":10,\"n5_0\":0,\"n10\":65535}" };
+  // CCS811 sin lectura: sus canales salen en 0 aunque la estructura traiga basura
+  vectors[2] = { "pms_only", makeSample(999, 77, false, pmsOnly, true),
+    "9001020000000000030507186418181718ff19010000",
+    "{\"co2\":0,\"tvoc\":0,\"pm1_0\":3,\"pm2_5\":5,\"pm10\":7,\"pm1_0_cf1\":0,\"pm2_5_cf1\":0,"
+    "\"pm10_cf1\":0,\"n0_3\":100,\"n0_5\":24,\"n1_0\":23,\"n2_5\":255,\"n5_0\":256,\"n10\":0}" };
+  // PMS7003 sin trama nueva
+  vectors[3] = { "ccs811_only", makeSample(415, 12, true, pmsStale, false),
+    "90010119019f0c000000000000000000000000",
+    "{\"co2\":415,\"tvoc\":12,\"pm1_0\":0,\"pm2_5\":0,\"pm10\":0,\"pm1_0_cf1\":0,\"pm2_5_cf1\":0,"
+    "\"pm10_cf1\":0,\"n0_3\":0,\"n0_5\":0,\"n1_0\":0,\"n2_5\":0,\"n5_0\":0,\"n10\":0}" };
+}
+
+void tearDown() {}
+
+void test_cbor_matches_golden_vectors() {
+  for (const GoldenVector & v : vectors) {
+    uint8_t expected[TELEMETRY_CBOR_MAX];
+    uint8_t actual[TELEMETRY_CBOR_MAX];
+    size_t n = fromHex(v.cbor, expected, sizeof(expected));
+    size_t len = encodeSensorDataCbor(&v.data, actual, sizeof(actual));
+    TEST_ASSERT_EQUAL_size_t_MESSAGE(n, len, v.name);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(expected, actual, n, v.name);
+  }
+}
+
+void test_json_matches_golden_vectors() {
+  for (const GoldenVector & v : vectors) {
+    char actual[TELEMETRY_JSON_MAX];
+    size_t len = encodeSensorDataJson(&v.data, actual, sizeof(actual));
+    TEST_ASSERT_EQUAL_size_t_MESSAGE(strlen(v.json), len, v.name);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(v.json, actual, v.name);
+  }
+}
+
+void test_cbor_golden_vectors_decode() {
+  for (const GoldenVector & v : vectors) {
+    uint8_t buf[TELEMETRY_CBOR_MAX];
+    size_t n = fromHex(v.cbor, buf, sizeof(buf));
+    SensorData decoded;
+    memset(&decoded, 0xA5, sizeof(decoded));
+    TEST_ASSERT_TRUE_MESSAGE(decodeSensorDataCbor(buf, n, &decoded), v.name);
+    TEST_ASSERT_EQUAL_MESSAGE(v.data.ccs811_valido, decoded.ccs811_valido, v.name);
+    TEST_ASSERT_EQUAL_MESSAGE(v.data.pms7003_valido, decoded.pms7003_valido, v.name);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(v.data.ccs811_valido ? v.data.co2 : 0, decoded.co2, v.name);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(v.data.ccs811_valido ? v.data.tvoc : 0, decoded.tvoc, v.name);
+    const uint16_t * want = (const uint16_t *)&v.data.pms7003;
+    const uint16_t * got = (const uint16_t *)&decoded.pms7003;
+    for (int f = 0; f < 12; f++) {
+      TEST_ASSERT_EQUAL_UINT16_MESSAGE(v.data.pms7003_valido ? want[f] : 0, got[f], v.name);
+    }
+  }
+}
+
+void test_batch_matches_golden_vectors() {
+  TimedSample a = { 1700000000, vectors[0].data };
+  TimedSample b = { 1700000002, vectors[1].data };
+  const TimedSample * samples[2] = { &a, &b };
+  uint8_t expected[128];
+  uint8_t cbor[TELEMETRY_BATCH_MAX(2)];
+  size_t n = fromHex("831a6553f100820090010319019f0c0018281850187818a018c818f01901181901401901681901901901b8"
+                     "820290010319ffff1701020304181919012c1904d219023718590a0019ffff", expected, sizeof(expected));
+  TEST_ASSERT_EQUAL_size_t(n, encodeBatchCbor(samples, 2, cbor, sizeof(cbor)));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, cbor, n);
+
+  char json[TELEMETRY_BATCH_MAX(2)];
+  char want[600];
+  snprintf(want, sizeof(want), "{\"ts\":1700000000,\"dt\":[0,2],\"samples\":[%s,%s]}", vectors[0].json, vectors[1].json);
+  TEST_ASSERT_EQUAL_size_t(strlen(want), encodeBatchJson(samples, 2, json, sizeof(json)));
+  TEST_ASSERT_EQUAL_STRING(want, json);
+}
+
+void test_decode_rejects_malformed_input() {
+  uint8_t buf[TELEMETRY_CBOR_MAX + 1];
+  size_t n = fromHex(vectors[1].cbor, buf, sizeof(buf));
+  SensorData d;
+  for (size_t cut = 0; cut < n; cut++) {
+    TEST_ASSERT_FALSE(decodeSensorDataCbor(buf, cut, &d));   // Truncado en cualquier byte
+  }
+  buf[n] = 0x00;
+  TEST_ASSERT_FALSE(decodeSensorDataCbor(buf, n + 1, &d));   // Bytes de más
+  buf[1] = 0x02;
+  TEST_ASSERT_FALSE(decodeSensorDataCbor(buf, n, &d));       // Otra versión del layout
+  static const uint8_t wide[] = { 0x90, 0x01, 0x03, 0x1a, 0x00, 0x01, 0x00, 0x00 };
+  TEST_ASSERT_FALSE(decodeSensorDataCbor(wide, sizeof(wide), &d)); // Valor de 32 bits
+}
+
+int main(int argc, char ** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_cbor_matches_golden_vectors);
+  RUN_TEST(test_json_matches_golden_vectors);
+  RUN_TEST(test_cbor_golden_vectors_decode);
+  RUN_TEST(test_batch_matches_golden_vectors);
+  RUN_TEST(test_decode_rejects_malformed_input);
+  return UNITY_END();
+}